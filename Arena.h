@@ -0,0 +1,49 @@
+#pragma once
+#include <memory_resource>
+#include <mutex>
+#include <cstddef>
+
+// Monotonic arena for records loaded in bulk: their strings and vectors are
+// carved out of a few large blocks instead of one heap allocation each.
+// Nothing is freed piecemeal; every block goes back to the heap at once when
+// the arena is destroyed, so the arena must outlive the records placed in it.
+// Space given up by a string or vector that outgrows its buffer is only
+// reclaimed then, which suits data that is mostly read after loading.
+// Allocation takes a lock, so those records may still grow on any thread.
+class Arena : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t FIRST_BLOCK = 64 * 1024;
+
+private:
+    std::mutex mutex;
+    std::pmr::monotonic_buffer_resource blocks;
+    size_t used = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        used += bytes;
+        return blocks.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+public:
+    explicit Arena(size_t firstBlock = FIRST_BLOCK) : blocks(firstBlock) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Bytes handed out so far, including any given back since
+    size_t bytesUsed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used;
+    }
+};
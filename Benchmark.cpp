@@ -0,0 +1,1523 @@
+// Throughput benchmarks for the store.
+// Usage: ecommerce_bench <scenario> [--key=value ...]
+// Each run works in a fresh temporary data directory, so the real data/ is never touched.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <functional>
+#include "ECommerceSystem.h"
+#include "CheckoutPipeline.h"
+#include "StoreApi.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// Every operator new in the process, so scenarios can report allocator calls
+std::atomic<uint64_t> heapAllocations{0};
+
+// GCC takes the frees below, once inlined, for a mismatch with operator new
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+struct BenchOptions
+{
+    std::map<std::string, std::string> values;
+
+    long get(const std::string& key, long fallback) const
+    {
+        auto it = values.find(key);
+        return it != values.end() ? std::atol(it->second.c_str()) : fallback;
+    }
+
+    std::string text(const std::string& key, const std::string& fallback) const
+    {
+        auto it = values.find(key);
+        return it != values.end() ? it->second : fallback;
+    }
+};
+
+// Runs the benchmark inside a scratch directory and steps back out afterwards
+class ScratchDirectory
+{
+private:
+    std::filesystem::path previous;
+    std::filesystem::path path;
+
+public:
+    explicit ScratchDirectory(const std::string& name) : previous(std::filesystem::current_path()), path(std::filesystem::temp_directory_path() / name)
+    {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+        std::filesystem::current_path(path);
+    }
+
+    ~ScratchDirectory()
+    {
+        std::filesystem::current_path(previous);
+        std::error_code ignored;
+        std::filesystem::remove_all(path, ignored);
+    }
+};
+
+// The store reports to the console on every call; that would drown the numbers
+void silenceConsole()
+{
+    std::cout.rdbuf(nullptr);
+    if (!std::freopen(NULL_DEVICE, "w", stdout))
+    {
+        std::cerr << "Warning: could not redirect stdout.\n";
+    }
+}
+
+// Seeds one seller with `productCount` products and `customers` customer accounts
+void seedStore(ECommerceSystem& system, int productCount, int customers, int stock)
+{
+    system.registerUser("seller", "pw", UserType::SELLER);
+    Session seller(Session::alwaysConfirm);
+    system.login(seller, "seller", "pw");
+    static const char* categories[] = { "Kitchen", "Garden", "Books", "Toys", "Office", "Sports" };
+    for (int i = 0; i < productCount; ++i)
+    {
+        system.addProduct(seller, "Item " + std::to_string(i), 1.0 + (i % 50), categories[i % 6], stock);
+    }
+    system.logout(seller);
+
+    for (int c = 0; c < customers; ++c)
+    {
+        system.registerUser("customer" + std::to_string(c), "pw", UserType::CUSTOMER);
+    }
+}
+
+std::vector<int> threadCountsUpTo(int maxThreads)
+{
+    std::vector<int> counts;
+    for (int t = 1; t < maxThreads; t *= 2) counts.push_back(t);
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+long defaultThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Nearest-rank percentile, p in [0, 100]; sorts `samples`
+double percentile(std::vector<double>& samples, double p)
+{
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t rank = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[std::min(rank, samples.size() - 1)];
+}
+
+// Independent customers browsing and checking out, one session per thread
+void benchSessions(const BenchOptions& options)
+{
+    const int productCount = static_cast<int>(options.get("products", 1000));
+    const long opsPerThread = options.get("ops", 20000);
+    const int maxThreads = static_cast<int>(options.get("threads", defaultThreads()));
+
+    std::cerr << "scenario=sessions products=" << productCount << " ops/thread=" << opsPerThread << "\n";
+    std::cerr << "threads | ops/sec     | speedup\n";
+
+    double baseline = 0.0;
+    for (int threads : threadCountsUpTo(maxThreads))
+    {
+        ScratchDirectory scratch("ecommerce_bench_sessions");
+        ECommerceSystem system(false);
+        seedStore(system, productCount, threads, 1000000000);
+
+        std::vector<std::thread> workers;
+        auto start = Clock::now();
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&system, t, productCount, opsPerThread]()
+            {
+                std::mt19937 rng(static_cast<unsigned>(t) * 7919u + 1u);
+                std::uniform_int_distribution<int> pick(1, productCount);
+                Session session(Session::alwaysConfirm);
+                system.login(session, "customer" + std::to_string(t), "pw");
+
+                for (long op = 0; op < opsPerThread; op += 4)
+                {
+                    if (op % 32 == 0) system.searchProducts("Item 1" + std::to_string(pick(rng) % 10));
+                    else system.viewCart(session);
+                    system.addToCart(session, pick(rng), 1);
+                    system.addToCart(session, pick(rng), 1);
+                    system.placeOrder(session);
+                }
+                system.logout(session);
+            });
+        }
+        for (auto& w : workers) w.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        double throughput = static_cast<double>(opsPerThread) * threads / seconds;
+        if (threads == 1) baseline = throughput;
+        std::fprintf(stderr, "%-7d | %-11.0f | %.2fx\n", threads, throughput, throughput / baseline);
+    }
+}
+
+// All threads check out the same few hot SKUs, then race for a limited stock
+void benchContention(const BenchOptions& options)
+{
+    const int hot = static_cast<int>(options.get("hot", 4));
+    const long checkouts = options.get("checkouts", 20000);
+    const int limit = static_cast<int>(options.get("limit", 1000));
+    const int maxThreads = static_cast<int>(options.get("threads", defaultThreads()));
+
+    std::cerr << "scenario=contention hot=" << hot << " checkouts/thread=" << checkouts << "\n";
+    std::cerr << "threads | checkouts/sec | speedup\n";
+
+    double baseline = 0.0;
+    for (int threads : threadCountsUpTo(maxThreads))
+    {
+        ScratchDirectory scratch("ecommerce_bench_contention");
+        ECommerceSystem system(false);
+        seedStore(system, hot, threads, 1000000000);
+
+        std::vector<std::thread> workers;
+        auto start = Clock::now();
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&system, t, hot, checkouts]()
+            {
+                Session session(Session::alwaysConfirm);
+                system.login(session, "customer" + std::to_string(t), "pw");
+                for (long i = 0; i < checkouts; ++i)
+                {
+                    system.addToCart(session, 1 + static_cast<int>((t + i) % hot), 1);
+                    system.addToCart(session, 1 + static_cast<int>((t + i + 1) % hot), 2);
+                    system.placeOrder(session);
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        double throughput = static_cast<double>(checkouts) * threads / seconds;
+        if (threads == 1) baseline = throughput;
+        std::fprintf(stderr, "%-7d | %-13.0f | %.2fx\n", threads, throughput, throughput / baseline);
+    }
+
+    // Sell-out: product 1 has `limit` units, product 2 plenty. Every order takes one
+    // of each, product 2 first, so a short product 1 forces product 2 to be rolled back.
+    ScratchDirectory scratch("ecommerce_bench_sellout");
+    ECommerceSystem system(false);
+    const int plenty = limit * 10;
+    system.registerUser("seller", "pw", UserType::SELLER);
+    Session seller(Session::alwaysConfirm);
+    system.login(seller, "seller", "pw");
+    system.addProduct(seller, "Scarce", 1.0, "Hot", limit);
+    system.addProduct(seller, "Plenty", 1.0, "Hot", plenty);
+    for (int c = 0; c < maxThreads; ++c) system.registerUser("customer" + std::to_string(c), "pw", UserType::CUSTOMER);
+
+    std::atomic<long> placed(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < maxThreads; ++t)
+    {
+        workers.emplace_back([&system, &placed, t, limit]()
+        {
+            Session session(Session::alwaysConfirm);
+            system.login(session, "customer" + std::to_string(t), "pw");
+            for (int attempt = 0; attempt < limit; ++attempt)
+            {
+                if (system.addToCart(session, 2, 1) && system.addToCart(session, 1, 1) && system.placeOrder(session))
+                {
+                    ++placed;
+                }
+                else
+                {
+                    system.clearCart(session);
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    int scarceLeft = system.getAvailableStock(1);
+    int plentyLeft = system.getAvailableStock(2);
+    bool exact = placed == limit - scarceLeft && plentyLeft == plenty - placed && scarceLeft >= 0;
+    std::fprintf(stderr, "sell-out: %ld orders, scarce left %d, plenty left %d -> %s\n", placed.load(), scarceLeft, plentyLeft, exact ? "consistent" : "INCONSISTENT");
+}
+
+// Customers check out hot SKUs while the seller keeps repricing them. A
+// conflict is a checkout whose product was repriced between the quote and
+// the reservation; placeOrder then quotes again, or gives up after a few.
+void benchPricing(const BenchOptions& options)
+{
+    const int hot = static_cast<int>(options.get("hot", 4));
+    const long checkouts = options.get("checkouts", 20000);
+    const long repriceEveryUs = options.get("reprice_us", 50);
+    const int threads = static_cast<int>(options.get("threads", defaultThreads()));
+
+    ScratchDirectory scratch("ecommerce_bench_pricing");
+    ECommerceSystem system(false);
+    seedStore(system, hot, threads, 1000000000);
+    Session seller(Session::alwaysConfirm);
+    system.login(seller, "seller", "pw");
+
+    std::atomic<bool> done(false);
+    std::thread repricer([&]()
+    {
+        for (long i = 0; !done; ++i)
+        {
+            system.updatePrice(seller, 1 + static_cast<int>(i % hot), 1.0 + static_cast<double>(i % 100));
+            if (repriceEveryUs > 0) std::this_thread::sleep_for(std::chrono::microseconds(repriceEveryUs));
+        }
+    });
+
+    std::vector<std::thread> workers;
+    auto start = Clock::now();
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&system, t, hot, checkouts]()
+        {
+            Session session(Session::alwaysConfirm);
+            system.login(session, "customer" + std::to_string(t), "pw");
+            for (long i = 0; i < checkouts; ++i)
+            {
+                system.addToCart(session, 1 + static_cast<int>((t + i) % hot), 1);
+                system.addToCart(session, 1 + static_cast<int>((t + i + 1) % hot), 1);
+                if (!system.placeOrder(session)) system.clearCart(session);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    done = true;
+    repricer.join();
+
+    ECommerceSystem::CheckoutStats stats = system.getCheckoutStats();
+    std::cerr << "scenario=pricing hot=" << hot << " threads=" << threads << " reprice_us=" << repriceEveryUs << "\n";
+    std::fprintf(stderr, "checkouts/sec %.0f | attempts %llu | committed %llu | conflict rate %.3f%% | retries %llu | abandoned %llu\n",
+                 static_cast<double>(stats.committed) / seconds, static_cast<unsigned long long>(stats.attempts),
+                 static_cast<unsigned long long>(stats.committed), stats.conflictRate() * 100.0, static_cast<unsigned long long>(stats.retries),
+                 static_cast<unsigned long long>(stats.abandoned));
+}
+
+// Catalog lookups and searches while sellers keep adding products
+void benchCatalog(const BenchOptions& options)
+{
+    const int productCount = static_cast<int>(options.get("products", 10000));
+    const long lookups = options.get("lookups", 200000);
+    const int readers = static_cast<int>(options.get("readers", defaultThreads()));
+    const int writers = static_cast<int>(options.get("writers", 2));
+    const long writePauseUs = options.get("write_us", 10);
+
+    std::cerr << "scenario=catalog products=" << productCount << " readers=" << readers << " lookups/reader=" << lookups << "\n";
+    std::cerr << "writers | products added | lookup p50 ns | p99 ns  | p999 ns | searches/sec\n";
+
+    for (int writerCount : { 0, writers })
+    {
+        ScratchDirectory scratch("ecommerce_bench_catalog");
+        ECommerceSystem system(false);
+        seedStore(system, productCount, 0, 100);
+
+        std::atomic<bool> done(false);
+        std::atomic<long> added(0);
+        std::vector<std::thread> writerThreads;
+        for (int w = 0; w < writerCount; ++w)
+        {
+            writerThreads.emplace_back([&system, &done, &added, writePauseUs]()
+            {
+                Session seller(Session::alwaysConfirm);
+                system.login(seller, "seller", "pw");
+                while (!done)
+                {
+                    system.addProduct(seller, "New arrival", 9.99, "Fresh", 10);
+                    ++added;
+                    if (writePauseUs > 0) std::this_thread::sleep_for(std::chrono::microseconds(writePauseUs));
+                }
+            });
+        }
+
+        std::vector<std::vector<double>> latencies(readers);
+        std::atomic<long> searches(0);
+        std::vector<std::thread> readerThreads;
+        auto start = Clock::now();
+        for (int r = 0; r < readers; ++r)
+        {
+            readerThreads.emplace_back([&, r]()
+            {
+                std::mt19937 rng(static_cast<unsigned>(r) + 17u);
+                std::uniform_int_distribution<int> pick(1, productCount);
+                latencies[r].reserve(lookups);
+                for (long i = 0; i < lookups; ++i)
+                {
+                    auto t0 = Clock::now();
+                    system.getAvailableStock(pick(rng));
+                    latencies[r].push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count()));
+                    if (i % 1000 == 0)
+                    {
+                        system.searchProducts("Item 99");
+                        ++searches;
+                    }
+                }
+            });
+        }
+        for (auto& t : readerThreads) t.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        done = true;
+        for (auto& t : writerThreads) t.join();
+
+        std::vector<double> all;
+        for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+        double p50 = percentile(all, 50), p99 = percentile(all, 99), p999 = percentile(all, 99.9);
+        std::fprintf(stderr, "%-7d | %-14ld | %-13.0f | %-7.0f | %-7.0f | %.0f\n", writerCount, added.load(), p50, p99, p999, searches / seconds);
+    }
+}
+
+// Millions of cart holds with spread-out TTLs, expired by sweeping simulated
+// time forward one second at a time, then checked against the stock they took
+void benchHolds(const BenchOptions& options)
+{
+    const long holdCount = options.get("holds", 1000000);
+    const int productCount = static_cast<int>(options.get("products", 1000));
+    const int customers = static_cast<int>(options.get("customers", 100000));
+    const long ttlSpread = std::max(1L, options.get("ttl_s", 900));
+    const int stock = static_cast<int>(2 * holdCount / productCount + 10); // enough that no hold is refused
+
+    std::cerr << "scenario=holds holds=" << holdCount << " products=" << productCount << " customers=" << customers << " ttl<=" << ttlSpread << "s\n";
+
+    ProductCatalog catalog;
+    std::vector<Product> seeded;
+    for (int i = 1; i <= productCount; ++i) seeded.emplace_back(i, "Item " + std::to_string(i), 1.0, "Misc", stock);
+    catalog.insertBatch(seeded);
+    CartHolds holds(catalog);
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> product(1, productCount);
+    std::uniform_int_distribution<int> customer(0, customers - 1);
+    std::uniform_int_distribution<long> ttl(1, ttlSpread);
+
+    const Clock::time_point start = Clock::now();
+    long placed = 0;
+    auto begin = Clock::now();
+    for (long i = 0; i < holdCount; ++i)
+    {
+        if (holds.hold(customer(rng), product(rng), 1, std::chrono::seconds(ttl(rng)), start)) ++placed;
+    }
+    double holdSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    long heldUnits = 0;
+    catalog.forEach([&heldUnits](ProductId, const ProductRef& p) { heldUnits += p.getHeld(); });
+
+    size_t expired = 0;
+    size_t largestBatch = 0;
+    begin = Clock::now();
+    for (long second = 1; second <= ttlSpread + 1; ++second)
+    {
+        size_t batch = holds.expire(start + std::chrono::seconds(second));
+        expired += batch;
+        largestBatch = std::max(largestBatch, batch);
+    }
+    double expireSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    bool restored = true;
+    catalog.forEach([&restored, stock](ProductId, const ProductRef& p) { restored = restored && p.getHeld() == 0 && p.getStock() == stock; });
+
+    std::fprintf(stderr, "hold:   %ld placed, %.0f ns/hold, %ld units held\n", placed, holdSeconds * 1e9 / std::max(1L, placed), heldUnits);
+    std::fprintf(stderr, "expire: %zu holds released (%llu units) in %ld sweeps, %.0f ns/hold, largest batch %zu\n", expired,
+                 static_cast<unsigned long long>(holds.getExpiredUnits()), ttlSpread + 1, expireSeconds * 1e9 / std::max<size_t>(1, expired), largestBatch);
+    std::fprintf(stderr, "stock after expiry: %s\n", restored && holds.size() == 0 ? "fully restored" : "NOT RESTORED");
+}
+
+// Bulk order import through placeOrders, in batches of `batch` orders
+void benchBatch(const BenchOptions& options)
+{
+    const long orderCount = options.get("orders", 1000000);
+    const long batchSize = std::max(1L, options.get("batch", 10000));
+    const int productCount = static_cast<int>(options.get("products", 1000));
+    const int customers = static_cast<int>(options.get("customers", 10000));
+    const int stock = static_cast<int>(options.get("stock", 1000000));
+
+    std::cerr << "scenario=batch orders=" << orderCount << " batch=" << batchSize << " products=" << productCount << " customers=" << customers << "\n";
+
+    ScratchDirectory scratch("ecommerce_bench_batch");
+    ECommerceSystem system(false);
+    seedStore(system, productCount, customers, stock); // after the default admin (1) and the seller (2), customers are 3..customers+2
+    Session admin(Session::alwaysConfirm);
+    system.login(admin, "admin", "admin123");
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> customer(3, customers + 2);
+    std::uniform_int_distribution<int> product(1, productCount);
+    std::uniform_int_distribution<int> lines(1, 4);
+    std::uniform_int_distribution<int> quantity(1, 3);
+
+    long placed = 0;
+    long outOfStock = 0;
+    long unitsOrdered = 0;
+    double seconds = 0.0;
+    for (long done = 0; done < orderCount; done += batchSize)
+    {
+        std::vector<ECommerceSystem::OrderRequest> requests(static_cast<size_t>(std::min(batchSize, orderCount - done)));
+        for (auto& request : requests)
+        {
+            request.customerId = customer(rng);
+            for (int l = lines(rng); l > 0; --l) request.items.push_back({ product(rng), quantity(rng) });
+        }
+
+        auto start = Clock::now();
+        std::vector<ECommerceSystem::OrderResult> results = system.placeOrders(admin, requests);
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            if (results[i].outcome == ECommerceSystem::OrderOutcome::PLACED)
+            {
+                ++placed;
+                for (const CartItem& item : requests[i].items) unitsOrdered += item.quantity;
+            }
+            else if (results[i].outcome == ECommerceSystem::OrderOutcome::OUT_OF_STOCK)
+            {
+                ++outOfStock;
+            }
+        }
+    }
+
+    long unitsLeft = 0;
+    for (int id = 1; id <= productCount; ++id) unitsLeft += system.getAvailableStock(id);
+    bool exact = unitsLeft + unitsOrdered == static_cast<long>(stock) * productCount;
+
+    std::fprintf(stderr, "%.0f orders/sec | %ld placed | %ld out of stock | stock %s\n", orderCount / seconds, placed, outOfStock, exact ? "consistent" : "INCONSISTENT");
+}
+
+// Cost of a checkout per cart line as the catalog grows. Each line is looked
+// up once, so the cost per line should stay flat from the smallest catalog to
+// the largest. Carts draw from `working_set` products spread evenly over the
+// catalog, so every size touches as much memory and the numbers show the
+// checkout rather than cache misses. Per-order costs are taken out by
+// comparing carts of `lines` lines with single-line carts; pairs of products
+// bought together are counted per order, so compare at one `lines`.
+void benchCheckout(const BenchOptions& options)
+{
+    const long maxProducts = std::max(1000L, options.get("products", 1000000));
+    const int lineCount = static_cast<int>(std::max(2L, std::min<long>(MAX_CART_ITEMS, options.get("lines", 16))));
+    const long orderCount = std::max(1L, options.get("orders", 2000));
+    const int workingSet = static_cast<int>(std::max<long>(lineCount, std::min(1000L, options.get("working_set", 1000))));
+
+    std::cerr << "scenario=checkout products<=" << maxProducts << " lines=" << lineCount << " orders=" << orderCount << " working_set=" << workingSet << "\n";
+    std::fprintf(stderr, "%-10s | %-18s | %-18s | %s\n", "products", "1-line order us", "n-line order us", "ns per extra line");
+    for (long productCount = 1000; productCount <= maxProducts; productCount *= 10)
+    {
+        ScratchDirectory scratch("ecommerce_bench_checkout");
+        ECommerceSystem system(false);
+        seedStore(system, static_cast<int>(productCount), 1, 1000000000);
+        Session buyer(Session::alwaysConfirm);
+        system.login(buyer, "customer0", "pw");
+
+        std::mt19937 rng(13);
+        std::uniform_int_distribution<long> pick(0, workingSet - 1);
+        const long stride = productCount / workingSet;
+        auto median = [&](int lines)
+        {
+            std::vector<double> samples;
+            for (long i = 0; i < orderCount; ++i)
+            {
+                for (int l = 0; l < lines; ++l) system.addToCart(buyer, static_cast<ProductId>(1 + pick(rng) * stride), 1);
+                auto start = Clock::now();
+                system.placeOrder(buyer);
+                samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+            }
+            return percentile(samples, 50);
+        };
+        const double single = median(1);
+        const double full = median(lineCount);
+        std::fprintf(stderr, "%-10ld | %-18.2f | %-18.2f | %.0f\n", productCount, single / 1000, full / 1000, (full - single) / (lineCount - 1));
+    }
+}
+
+// Pages through the whole catalog in every sort order. The first and the last
+// page should cost about the same; a walk must visit each product once.
+void benchBrowse(const BenchOptions& options)
+{
+    const int productCount = static_cast<int>(options.get("products", 1000000));
+    const size_t pageSize = static_cast<size_t>(std::max(1L, options.get("page", 20)));
+    const int repriced = static_cast<int>(options.get("repriced", 10000));
+
+    std::cerr << "scenario=browse products=" << productCount << " page=" << pageSize << " repriced=" << repriced << "\n";
+
+    ScratchDirectory scratch("ecommerce_bench_browse");
+    ECommerceSystem system(false);
+    seedStore(system, productCount, 0, 100);
+
+    auto timePage = [&system, pageSize](ProductSort sort, const std::string& cursor, ProductPage& page)
+    {
+        auto start = Clock::now();
+        system.getProductPage(sort, false, cursor, pageSize, page);
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    };
+
+    // The first page of a sort also builds the index from everything added so far
+    std::cerr << "sort   | first page us | pages   | avg page us | last page us | visited\n";
+    for (ProductSort sort : { ProductSort::NEWEST, ProductSort::PRICE, ProductSort::NAME, ProductSort::STOCK })
+    {
+        ProductPage page;
+        double first = timePage(sort, "", page);
+        size_t visited = page.products.size();
+        long pages = 1;
+        double total = 0.0, last = 0.0;
+        std::vector<bool> seen(static_cast<size_t>(productCount) + 1, false);
+        bool once = true;
+        for (;;)
+        {
+            for (const Product& p : page.products)
+            {
+                if (seen[p.getId()]) once = false;
+                seen[p.getId()] = true;
+            }
+            if (page.nextCursor.empty()) break;
+            std::string cursor = page.nextCursor;
+            last = timePage(sort, cursor, page);
+            total += last;
+            visited += page.products.size();
+            ++pages;
+        }
+        std::fprintf(stderr, "%-6s | %-13.1f | %-7ld | %-11.2f | %-12.2f | %zu%s\n", ProductIndex::sortName(sort), first, pages,
+                     total / std::max(1L, pages - 1), last, visited, once && visited == static_cast<size_t>(productCount) ? "" : " (WRONG)");
+    }
+
+    // Incremental upkeep: only the repriced products move
+    Session seller(Session::alwaysConfirm);
+    system.login(seller, "seller", "pw");
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> product(1, productCount);
+    for (int i = 0; i < repriced; ++i) system.updatePrice(seller, product(rng), 1.0 + (i % 500));
+    ProductPage page;
+    double refresh = timePage(ProductSort::PRICE, "", page);
+    std::fprintf(stderr, "first price page after %d price changes: %.1f us\n", repriced, refresh);
+}
+
+// Heap allocations per call on the read-only paths, counted by the operator
+// new above once each path is warm: paging the catalog into a reused page,
+// searching it, and checking a password. Each should be 0.
+void benchAllocations(const BenchOptions& options)
+{
+    const int productCount = static_cast<int>(options.get("products", 100000));
+    const long calls = std::max(1L, options.get("calls", 1000));
+    std::cerr << "scenario=allocations products=" << productCount << " calls=" << calls << "\n";
+
+    ScratchDirectory scratch("ecommerce_bench_allocations");
+    ECommerceSystem system(false);
+    seedStore(system, productCount, 100, 100);
+
+    // Arguments are built before counting starts; only the call itself is measured
+    auto measure = [](const std::string& name, long count, auto&& call)
+    {
+        call(0); // warm-up: first pages build the index, buffers reach their size
+        const uint64_t before = heapAllocations.load();
+        auto start = Clock::now();
+        for (long i = 0; i < count; ++i) call(i);
+        const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / count;
+        std::fprintf(stderr, "%-28s | %-14.2f | %.2f\n", name.c_str(), static_cast<double>(heapAllocations.load() - before) / count, us);
+    };
+
+    std::fprintf(stderr, "%-28s | %-14s | %s\n", "path", "allocs/call", "us/call");
+    for (ProductSort sort : { ProductSort::NEWEST, ProductSort::PRICE, ProductSort::STOCK })
+    {
+        ProductPage page;
+        std::string cursor;
+        measure(std::string("browse by ") + ProductIndex::sortName(sort), calls, [&](long)
+        {
+            // Walks forward page by page, starting over after the last
+            cursor = page.nextCursor;
+            system.getProductPage(sort, false, cursor, BROWSE_PAGE_SIZE, page);
+        });
+    }
+
+    // Each search scans the whole catalog, so it gets fewer calls
+    for (const char* query : { "Item 4242", "kitchen", "no such product" })
+    {
+        measure(std::string("search \"") + query + "\"", std::max(1L, calls / 100), [&system, query](long)
+        {
+            size_t matches = 0;
+            system.findProducts(query, [&matches](const ProductRef&) { matches++; });
+        });
+    }
+
+    std::vector<std::string> usernames;
+    for (int c = 0; c < 100; ++c) usernames.push_back("customer" + std::to_string(c));
+    const std::string password = "pw", wrongPassword = "not the password";
+    UserType type = UserType::CUSTOMER;
+    measure("login check", calls, [&](long i) { system.authenticate(usernames[static_cast<size_t>(i) % usernames.size()], password, type); });
+    measure("login check, wrong password", calls, [&](long i) { system.authenticate(usernames[static_cast<size_t>(i) % usernames.size()], wrongPassword, type); });
+}
+
+// Stock and price scans over a catalog much larger than the caches: the hot
+// records the catalog scans, against the same products as whole records in
+// one array, the layout the catalog had before the hot/cold split
+void benchScan(const BenchOptions& options)
+{
+    const long productCount = std::max(1L, options.get("products", 2000000));
+    const long reps = std::max(1L, options.get("reps", 5));
+
+    std::cerr << "scenario=scan products=" << productCount << " reps=" << reps << "\n";
+
+    static const char* categories[] = { "Kitchen", "Garden", "Books", "Toys", "Office", "Sports" };
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> cents(99, 49999);
+    std::uniform_int_distribution<int> stock(0, 200);
+    std::vector<Product> records;
+    records.reserve(static_cast<size_t>(productCount));
+    for (long i = 0; i < productCount; ++i)
+    {
+        records.emplace_back(static_cast<ProductId>(i + 1), "Item " + std::to_string(i), cents(rng) / 100.0, categories[i % 6], stock(rng), 2);
+    }
+    ProductCatalog catalog;
+    catalog.insertBatch(records);
+
+    struct Totals
+    {
+        long long units = 0;
+        double value = 0.0;
+        long outOfStock = 0;
+        long inPriceRange = 0;
+    };
+    auto addHot = [](Totals& totals, const ProductHot& p)
+    {
+        int units = p.stock.load(std::memory_order_relaxed);
+        double price = p.price.load(std::memory_order_relaxed);
+        totals.units += units;
+        totals.value += price * units;
+        totals.outOfStock += units == 0;
+        totals.inPriceRange += price >= 100.0 && price < 200.0;
+    };
+    auto add = [](Totals& totals, const ProductRef& p)
+    {
+        int units = p.getStock();
+        double price = p.getPrice();
+        totals.units += units;
+        totals.value += price * units;
+        totals.outOfStock += units == 0;
+        totals.inPriceRange += price >= 100.0 && price < 200.0;
+    };
+
+    // Best of `reps` passes; the totals of the last pass are kept to compare layouts
+    auto timeScan = [reps](Totals& totals, const std::function<void(Totals&)>& scan)
+    {
+        double best = 0.0;
+        for (long r = 0; r < reps; ++r)
+        {
+            totals = Totals();
+            auto start = Clock::now();
+            scan(totals);
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if (r == 0 || ns < best) best = ns;
+        }
+        return best;
+    };
+
+    Totals whole, hot;
+    double wholeNs = timeScan(whole, [&records, &add](Totals& totals) { for (const Product& p : records) add(totals, p); });
+    double hotNs = timeScan(hot, [&catalog, &addHot](Totals& totals) { catalog.forEachHot([&totals, &addHot](const ProductHot& p) { addHot(totals, p); }); });
+
+    const bool same = whole.units == hot.units && whole.outOfStock == hot.outOfStock && whole.inPriceRange == hot.inPriceRange;
+    const double count = static_cast<double>(productCount);
+    std::cerr << "layout          | bytes/product | scan ms  | ns/product | products/sec\n";
+    std::fprintf(stderr, "whole records   | %-13zu | %-8.2f | %-10.2f | %.0f\n", sizeof(Product), wholeNs / 1e6, wholeNs / count, count / (wholeNs / 1e9));
+    std::fprintf(stderr, "hot records     | %-13zu | %-8.2f | %-10.2f | %.0f\n", sizeof(ProductHot), hotNs / 1e6, hotNs / count, count / (hotNs / 1e9));
+    std::fprintf(stderr, "%.1fx faster | %lld units, $%.0f, %ld out of stock, %ld priced 100-200 | totals %s\n", wholeNs / hotNs, hot.units, hot.value,
+                 hot.outOfStock, hot.inPriceRange, same ? "match" : "DIFFER");
+}
+
+// Bulk import of a generated catalog, one bad row in every `bad_every`
+void benchImport(const BenchOptions& options)
+{
+    const long rowCount = options.get("rows", 1000000);
+    const long badEvery = std::max(1L, options.get("bad_every", 1000));
+    const int maxThreads = static_cast<int>(options.get("threads", defaultThreads()));
+
+    std::cerr << "scenario=import rows=" << rowCount << " bad_every=" << badEvery << "\n";
+
+    ScratchDirectory scratch("ecommerce_bench_import");
+    {
+        std::ofstream csv("catalog.csv", std::ios::binary);
+        csv << "name,price,category,stock\n";
+        static const char* categories[] = { "Kitchen", "Garden", "Books", "Toys", "Office", "Sports" };
+        for (long i = 0; i < rowCount; ++i)
+        {
+            if (i % badEvery == badEvery - 1) csv << "Broken " << i << ",not-a-price,Misc,1\n";
+            else if (i % 97 == 0) csv << "\"Widget, size " << i << "\"," << (i % 500) << ".99," << categories[i % 6] << "," << 1 + i % 40 << "\n";
+            else csv << "Item " << i << "," << (i % 500) << ".25," << categories[i % 6] << "," << 1 + i % 40 << "\n";
+        }
+    }
+    const double megabytes = static_cast<double>(std::filesystem::file_size("catalog.csv")) / (1 << 20);
+
+    std::cerr << "threads | rows/sec    | MB/s   | imported | rejected\n";
+    for (int threads : threadCountsUpTo(maxThreads))
+    {
+        std::filesystem::remove_all("data"); // the previous round saved its store on the way out
+        ECommerceSystem system(false);
+        seedStore(system, 0, 0, 0);
+        Session seller(Session::alwaysConfirm);
+        system.login(seller, "seller", "pw");
+
+        ImportReport report;
+        auto start = Clock::now();
+        system.importProducts(seller, "catalog.csv", report, static_cast<unsigned>(threads));
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        bool complete = system.getStoreCounts().products == report.imported && report.imported + report.rejected == static_cast<size_t>(rowCount);
+        std::fprintf(stderr, "%-7d | %-11.0f | %-6.0f | %-8zu | %zu%s\n", threads, rowCount / seconds, megabytes / seconds, report.imported,
+                     report.rejected, complete ? "" : " (INCOMPLETE)");
+    }
+}
+
+// Columnar export of a store filled through placeOrders, read back to check
+// that every row and every cent arrived
+void benchExport(const BenchOptions& options)
+{
+    const long orderCount = options.get("orders", 1000000);
+    const int productCount = static_cast<int>(options.get("products", 1000));
+    const int customers = static_cast<int>(options.get("customers", 10000));
+
+    std::cerr << "scenario=export orders=" << orderCount << " products=" << productCount << " customers=" << customers << "\n";
+
+    ScratchDirectory scratch("ecommerce_bench_export");
+    ECommerceSystem system(false);
+    seedStore(system, productCount, customers, 1000000000);
+    Session admin(Session::alwaysConfirm);
+    system.login(admin, "admin", "admin123");
+
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> customer(3, customers + 2);
+    std::uniform_int_distribution<int> product(1, productCount);
+    std::uniform_int_distribution<int> lines(1, 4);
+    for (long done = 0; done < orderCount; done += 10000)
+    {
+        std::vector<ECommerceSystem::OrderRequest> requests(static_cast<size_t>(std::min(10000L, orderCount - done)));
+        for (auto& request : requests)
+        {
+            request.customerId = customer(rng);
+            for (int l = lines(rng); l > 0; --l) request.items.push_back({ product(rng), 1 + l % 3 });
+        }
+        system.placeOrders(admin, requests);
+    }
+
+    system.saveAllData();
+    const double rowFiles = static_cast<double>(std::filesystem::file_size(TRANSACTION_FILE) + std::filesystem::file_size(ORDER_FILE));
+
+    auto start = Clock::now();
+    bool exported = system.exportColumnar("export");
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double columnar = 0.0;
+    for (const char* name : { "transactions", "orders", "order_items" }) columnar += static_cast<double>(std::filesystem::file_size(std::string("export/") + name + ".ecol"));
+
+    // Read back: row counts and the sum of every amount must match the store
+    ColumnarReader reader;
+    uint64_t rows = 0;
+    double amount = 0.0;
+    bool readable = reader.open("export/transactions.ecol");
+    for (size_t g = 0; readable && g < reader.getRowGroupCount(); ++g)
+    {
+        ColumnData column;
+        readable = reader.readColumn(g, 3, column);
+        rows += column.doubles.size();
+        for (double value : column.doubles) amount += value;
+    }
+    double expected = 0.0; // every transaction here is a sale, so they add up to the order totals
+    for (OrderId id = 1; id < Order::getNextId(); ++id) system.readOrder(id, [&expected](const Order& o) { expected += o.getTotal(); });
+    bool matches = readable && rows == system.getStoreCounts().transactions && std::fabs(amount - expected) < 1e-6 * std::max(1.0, expected);
+
+    const double totalRows = static_cast<double>(system.getStoreCounts().transactions + system.getStoreCounts().orders);
+    std::fprintf(stderr, "export %s in %.2fs: %.0f rows/sec | %.1f MB columnar vs %.1f MB .dat (%.1fx smaller) | %zu row groups | read back %s\n",
+                 exported ? "ok" : "FAILED", seconds, totalRows / seconds, columnar / (1 << 20), rowFiles / (1 << 20), rowFiles / columnar,
+                 reader.getRowGroupCount(), matches ? "matches" : "DOES NOT MATCH");
+}
+
+// A store of `scale` users, products and orders, built in memory exactly as
+// the .dat files hold it. Everything comes from `seed`, timestamps included,
+// so the same scale and seed always write the same bytes.
+struct GeneratedStore
+{
+    std::vector<Product> products;
+    std::vector<User> users;
+    OrderItemPool orderItems; // before the orders, which point into it
+    std::vector<Order> orders;
+    std::vector<Transaction> transactions;
+    int sellers = 0;
+};
+
+// Spread evenly over 2024, as order timestamp text
+std::string generatedTimestamp(long index, long count)
+{
+    long second = static_cast<long>(static_cast<double>(index) / std::max(1L, count) * 336 * 86400);
+    char text[40];
+    std::snprintf(text, sizeof(text), "2024-%02ld-%02ld %02ld:%02ld:%02ld", 1 + second / 86400 / 28, 1 + second / 86400 % 28,
+                  second / 3600 % 24, second / 60 % 60, second % 60);
+    return text;
+}
+
+// Users 1 (admin) and 2.. (one seller per 100 users) come first, customers
+// after. Each order buys 1-4 lines, each line one sale; every 20th order is
+// refunded and sellers log an expense every 10th order.
+void generateStore(long scale, unsigned seed, GeneratedStore& store)
+{
+    static const char* categories[] = { "Kitchen", "Garden", "Books", "Toys", "Office", "Sports" };
+    static const char* words[] = { "Lamp", "Kettle", "Chair", "Puzzle", "Rake", "Atlas", "Stapler", "Racket" };
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> cents(99, 49999);
+    std::uniform_int_distribution<int> lineCount(1, 4);
+    std::uniform_int_distribution<int> quantity(1, 3);
+
+    store.sellers = static_cast<int>(std::max(1L, scale / 100));
+    const UserId firstCustomer = 2 + store.sellers;
+    const long customers = std::max(1L, scale - 1 - store.sellers);
+
+    store.users.reserve(static_cast<size_t>(1 + store.sellers + customers));
+    store.users.push_back(User(1, "admin", "admin123", UserType::ADMIN));
+    for (int s = 0; s < store.sellers; ++s) store.users.push_back(User(2 + s, "seller" + std::to_string(s), "pw", UserType::SELLER));
+    for (long c = 0; c < customers; ++c) store.users.push_back(User(firstCustomer + static_cast<UserId>(c), "customer" + std::to_string(c), "pw", UserType::CUSTOMER));
+
+    store.products.reserve(static_cast<size_t>(scale));
+    for (long i = 0; i < scale; ++i)
+    {
+        store.products.emplace_back(static_cast<ProductId>(i + 1), std::string(words[i % 8]) + " " + std::to_string(i), cents(rng) / 100.0,
+                                    categories[i % 6], 1000000000, static_cast<UserId>(2 + i % store.sellers));
+    }
+
+    std::uniform_int_distribution<long> customer(0, customers - 1);
+    std::uniform_int_distribution<long> product(0, scale - 1);
+    store.orders.reserve(static_cast<size_t>(scale));
+    store.transactions.reserve(static_cast<size_t>(scale) * 3);
+    TransactionId transactionId = 1;
+    for (long o = 0; o < scale; ++o)
+    {
+        const std::string timestamp = generatedTimestamp(o, scale);
+        // Transactions hold epoch time: the same text read as UTC, so the bytes do not depend on the time zone
+        int64_t seconds = 0;
+        wallClockSeconds(timestamp.c_str(), seconds);
+        const int64_t micros = seconds * 1000000;
+        const UserId customerId = firstCustomer + static_cast<UserId>(customer(rng));
+        std::vector<CartItem> items;
+        double total = 0.0;
+        for (int l = lineCount(rng); l > 0; --l)
+        {
+            const Product& p = store.products[static_cast<size_t>(product(rng))];
+            int count = quantity(rng);
+            double amount = p.getPrice() * count;
+            items.push_back({ p.getId(), count });
+            total += amount;
+            store.transactions.push_back(Transaction::purchase(transactionId++, customerId, p.getId(), amount, p.getNameId(), micros));
+        }
+        store.orders.emplace_back(store.orderItems, static_cast<OrderId>(o + 1), customerId, items, total, timestamp);
+
+        if (o % 20 == 19)
+        {
+            store.transactions.push_back(Transaction::refund(transactionId++, customerId, -total, static_cast<OrderId>(o + 1), micros));
+        }
+        if (o % 10 == 9)
+        {
+            store.transactions.emplace_back(transactionId++, static_cast<UserId>(2 + o / 10 % store.sellers), -1, -(5.0 + o % 50),
+                                            TransactionType::EXPENSE, "Shipping supplies", micros);
+        }
+    }
+}
+
+struct SuiteResult
+{
+    std::string name;
+    long batch = 1;                  // calls per sample
+    std::vector<double> nsPerCall;   // one entry per sample
+};
+
+// Times `samples` batches of `batch` calls to call(i), i counting across batches
+template <typename F>
+SuiteResult timeCalls(const std::string& name, long samples, long batch, F call)
+{
+    SuiteResult result{ name, batch, {} };
+    long i = 0;
+    for (long s = 0; s < samples; ++s)
+    {
+        auto start = Clock::now();
+        for (long b = 0; b < batch; ++b) call(i++);
+        result.nsPerCall.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / batch);
+    }
+    return result;
+}
+
+// The core operations at growing store sizes, written to --out as JSON so two
+// runs can be compared. --scales takes a comma list (10000000 needs several GB);
+// --reps is the sample count for the whole-store operations.
+void benchSuite(const BenchOptions& options)
+{
+    const std::string scales = options.text("scales", "1000,100000");
+    const unsigned seed = static_cast<unsigned>(options.get("seed", 42));
+    const long reps = std::max(1L, options.get("reps", 3));
+    const std::filesystem::path out = std::filesystem::absolute(options.text("out", "bench_results.json"));
+
+    std::cerr << "scenario=suite scales=" << scales << " seed=" << seed << " reps=" << reps << "\n";
+
+    JsonWriter json;
+    json.beginObject().field("scenario", "suite").field("seed", seed).field("reps", reps).key("scales").beginArray();
+
+    for (size_t from = 0; from < scales.size();)
+    {
+        size_t comma = std::min(scales.find(',', from), scales.size());
+        const long scale = std::atol(scales.substr(from, comma - from).c_str());
+        from = comma + 1;
+        if (scale <= 0) continue;
+
+        ScratchDirectory scratch("ecommerce_bench_suite");
+        std::vector<SuiteResult> results;
+
+        auto generationStart = Clock::now();
+        std::optional<GeneratedStore> generated(std::in_place);
+        GeneratedStore& store = *generated;
+        generateStore(scale, seed, store);
+        const double generationSeconds = std::chrono::duration<double>(Clock::now() - generationStart).count();
+        std::filesystem::create_directories("data");
+
+        results.push_back(timeCalls("save_system_state", reps, 1, [&store](long)
+        {
+            DataManager::saveSystemState(store.products, store.users, store.orders, store.transactions);
+        }));
+        uintmax_t dataBytes = 0;
+        for (const auto& entry : std::filesystem::directory_iterator("data")) dataBytes += entry.file_size();
+
+        results.push_back(timeCalls("load_system_state", reps, 1, [](long)
+        {
+            std::vector<Product> products;
+            std::vector<User> users;
+            OrderItemPool orderItems;
+            std::vector<Order> orders;
+            std::vector<Transaction> transactions;
+            DataManager::loadSystemState(products, users, orders, transactions, orderItems);
+        }));
+
+        // Reports over the whole history, as the trackers are given it
+        const long reportSamples = std::max(reps, std::min(100L, 10000000L / std::max<long>(1, static_cast<long>(store.transactions.size()))));
+        results.push_back(timeCalls("seller_report", reportSamples, 1, [&store](long i)
+        {
+            ExpenseTracker tracker(static_cast<UserId>(2 + i % store.sellers));
+            tracker.loadTransactions(store.transactions);
+            volatile double net = tracker.getNetProfit();
+            (void)net;
+            volatile size_t days = tracker.getDailySummary().size();
+            (void)days;
+        }));
+        results.push_back(timeCalls("customer_report", reportSamples, 1, [&store](long i)
+        {
+            CustomerExpenseTracker tracker(static_cast<UserId>(2 + store.sellers + i % 100));
+            tracker.loadSpendingHistory(store.transactions);
+            volatile double net = tracker.getNetSpent();
+            (void)net;
+            volatile size_t months = tracker.getMonthlySummary().size();
+            (void)months;
+        }));
+
+        {
+            ProductCatalog catalog;
+            catalog.insertBatch(store.products);
+            Cart cart(1);
+            for (int l = 0; l < 10; ++l) cart.addItem(static_cast<ProductId>(1 + (l * 7919L) % scale), 1, catalog);
+            volatile double total = 0.0;
+            results.push_back(timeCalls("cart_calculate_total_10_lines", 20, 10000, [&cart, &catalog, &total](long)
+            {
+                total = cart.calculateTotal(catalog);
+            }));
+        }
+
+        const size_t productCount = store.products.size(), userCount = store.users.size(), orderCount = store.orders.size(),
+                     transactionCount = store.transactions.size();
+        const int sellers = store.sellers;
+        const long customers = static_cast<long>(userCount) - 1 - sellers;
+        generated.reset(); // the store below loads its own copy
+
+        auto openStart = Clock::now();
+        ECommerceSystem system(false);
+        results.push_back({ "open_store", 1, { std::chrono::duration<double, std::nano>(Clock::now() - openStart).count() } });
+
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<long> pickCustomer(0, customers - 1);
+        std::uniform_int_distribution<long> pickProduct(0, scale - 1);
+        static const char* words[] = { "Lamp", "Kettle", "Chair", "Puzzle", "Rake", "Atlas", "Stapler", "Racket" };
+
+        const long loginCalls = std::min(20000L, std::max(100L, scale));
+        results.push_back(timeCalls("login", 20, loginCalls / 20, [&](long)
+        {
+            Session session(Session::alwaysConfirm);
+            system.login(session, "customer" + std::to_string(pickCustomer(rng)), "pw");
+        }));
+
+        // Full catalog scans, so the call count shrinks as the catalog grows
+        const long searchCalls = std::max(20L, std::min(2000L, 100000000L / scale));
+        results.push_back(timeCalls("search_products", 20, searchCalls / 20, [&](long)
+        {
+            long p = pickProduct(rng);
+            system.searchProducts(std::string(words[p % 8]) + " " + std::to_string(p));
+        }));
+
+        // One sample per order so adding to the cart stays out of the timing
+        Session buyer(Session::alwaysConfirm);
+        system.login(buyer, "customer0", "pw");
+        SuiteResult placed{ "place_order_3_lines", 1, {} };
+        for (long i = 0, count = std::min(20000L, std::max(100L, scale)); i < count; ++i)
+        {
+            for (int l = 0; l < 3; ++l) system.addToCart(buyer, static_cast<ProductId>(1 + pickProduct(rng)), 1);
+            auto start = Clock::now();
+            system.placeOrder(buyer);
+            placed.nsPerCall.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+        }
+        results.push_back(std::move(placed));
+
+        json.beginObject().field("scale", scale).field("products", productCount).field("users", userCount).field("sellers", sellers)
+            .field("orders", orderCount).field("transactions", transactionCount).field("data_bytes", static_cast<uint64_t>(dataBytes))
+            .field("generate_seconds", generationSeconds).key("results").beginArray();
+
+        std::fprintf(stderr, "\nscale=%ld: %zu products, %zu users, %zu orders, %zu transactions, %.1f MB of .dat (generated in %.2fs)\n",
+                     scale, productCount, userCount, orderCount, transactionCount, dataBytes / 1048576.0, generationSeconds);
+        std::fprintf(stderr, "%-30s | %-8s | %-12s | %-12s | %-12s | calls/sec\n", "operation", "samples", "min us", "p50 us", "p99 us");
+        for (SuiteResult& r : results)
+        {
+            const double fastest = *std::min_element(r.nsPerCall.begin(), r.nsPerCall.end());
+            const double p50 = percentile(r.nsPerCall, 50), p99 = percentile(r.nsPerCall, 99);
+            std::fprintf(stderr, "%-30s | %-8zu | %-12.3f | %-12.3f | %-12.3f | %.0f\n", r.name.c_str(), r.nsPerCall.size(), fastest / 1000,
+                         p50 / 1000, p99 / 1000, 1e9 / p50);
+            json.beginObject().field("name", r.name).field("samples", r.nsPerCall.size()).field("calls_per_sample", r.batch)
+                .field("min_ns", fastest).field("p50_ns", p50).field("p99_ns", p99).field("calls_per_sec", 1e9 / p50).endObject();
+        }
+        json.endArray().endObject();
+    }
+    json.endArray().endObject();
+
+    std::ofstream file(out, std::ios::binary);
+    file << json.str() << "\n";
+    std::cerr << (file ? "\nResults written to " : "\nCould not write ") << out.string() << "\n";
+}
+
+#ifdef __linux__
+// A "VmRSS:"-style field of /proc/self/status, in KB
+long procStatusKb(const char* field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const size_t length = std::strlen(field);
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, length, field) == 0) return std::atol(line.c_str() + length);
+    }
+    return 0;
+}
+#endif
+
+// Runs f() in a child process and waits for it. The child starts from this
+// process's memory, so it sees none of what an earlier child allocated.
+template <typename F>
+bool inChildProcess(F f)
+{
+    std::fflush(stderr);
+    pid_t child = fork();
+    if (child < 0)
+    {
+        std::perror("fork");
+        return false;
+    }
+    if (child == 0)
+    {
+        f();
+        std::fflush(stderr);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Loads a generated store of --scale orders with each user's and order's data
+// on the heap, then in an Arena. Generation and each load run in child
+// processes of their own, so no load starts with memory another one freed.
+void benchLoad(const BenchOptions& options)
+{
+#ifdef __linux__
+    const long scale = std::max(1L, options.get("scale", 1000000));
+    const unsigned seed = static_cast<unsigned>(options.get("seed", 42));
+    std::cerr << "scenario=load scale=" << scale << " seed=" << seed << "\n";
+
+    ScratchDirectory scratch("ecommerce_bench_load");
+    std::filesystem::create_directories("data");
+    inChildProcess([&]
+    {
+        GeneratedStore store;
+        generateStore(scale, seed, store);
+        DataManager::saveSystemState(store.products, store.users, store.orders, store.transactions);
+        std::fprintf(stderr, "%zu users, %zu orders, %zu transactions\n", store.users.size(), store.orders.size(), store.transactions.size());
+    });
+
+    // Transactions are fixed-size records; what they allocate is the string
+    // dictionary being interned, once per process
+    std::fprintf(stderr, "%-6s | %-8s | %-20s | %-20s | %-9s | %s\n", "mode", "seconds", "user+order allocs", "transaction allocs", "arena MB",
+                 "peak RSS growth MB");
+    for (bool useArena : { false, true }) inChildProcess([useArena]
+    {
+        // Start the high-water mark over from what the child inherited
+        std::ofstream("/proc/self/clear_refs") << "5";
+        const long baseKb = procStatusKb("VmRSS:");
+        Arena arena;
+        std::pmr::memory_resource* resource = useArena ? static_cast<std::pmr::memory_resource*>(&arena) : std::pmr::get_default_resource();
+        std::vector<User> users;
+        OrderItemPool orderItems;
+        std::vector<Order> orders;
+        std::vector<Transaction> transactions;
+        const uint64_t allocationsBefore = heapAllocations.load();
+        auto start = Clock::now();
+        DataManager::loadUsers(users, resource);
+        DataManager::loadOrders(orders, orderItems, resource);
+        const uint64_t recordAllocations = heapAllocations.load() - allocationsBefore;
+        DataManager::loadTransactions(transactions);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const uint64_t transactionAllocations = heapAllocations.load() - allocationsBefore - recordAllocations;
+        const long peakKb = procStatusKb("VmHWM:");
+        std::fprintf(stderr, "%-6s | %-8.3f | %-20llu | %-20llu | %-9.1f | %.1f\n", useArena ? "arena" : "heap", seconds,
+                     static_cast<unsigned long long>(recordAllocations), static_cast<unsigned long long>(transactionAllocations),
+                     arena.bytesUsed() / 1048576.0, (peakKb - baseKb) / 1024.0);
+    });
+#else
+    (void)options;
+    std::cerr << "scenario=load needs Linux (fork, /proc).\n";
+#endif
+}
+
+// Checkouts on one thread: placeOrder one after another, then the coroutine
+// pipeline with up to `inflight` checkouts under way. Use --autosave=1 to
+// include the disk writes the pipeline overlaps with CPU work.
+void benchPipeline(const BenchOptions& options)
+{
+    const long checkouts = options.get("checkouts", 20000);
+    const int window = static_cast<int>(std::max(1L, options.get("inflight", 4096)));
+    const int productCount = static_cast<int>(options.get("products", 1000));
+    const bool autoSave = options.get("autosave", 0) != 0;
+
+    std::cerr << "scenario=pipeline checkouts=" << checkouts << " inflight=" << window << " products=" << productCount << " autosave=" << autoSave << "\n";
+
+    auto fillCart = [productCount](ECommerceSystem& system, Session& session, std::mt19937& rng)
+    {
+        std::uniform_int_distribution<int> product(1, productCount);
+        std::uniform_int_distribution<int> lines(1, 3);
+        for (int l = lines(rng); l > 0; --l) system.addToCart(session, product(rng), 1);
+    };
+
+    double syncSeconds = 0.0;
+    {
+        ScratchDirectory scratch("ecommerce_bench_pipeline");
+        ECommerceSystem system(autoSave);
+        seedStore(system, productCount, 1, 1000000000);
+        Session session(Session::alwaysConfirm);
+        system.login(session, "customer0", "pw");
+        std::mt19937 rng(11);
+
+        auto start = Clock::now();
+        for (long i = 0; i < checkouts; ++i)
+        {
+            fillCart(system, session, rng);
+            system.placeOrder(session);
+        }
+        syncSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    ScratchDirectory scratch("ecommerce_bench_pipeline");
+    ECommerceSystem system(autoSave);
+    seedStore(system, productCount, window, 1000000000);
+    std::vector<std::unique_ptr<Session>> sessions;
+    for (int c = 0; c < window; ++c)
+    {
+        sessions.push_back(std::make_unique<Session>(Session::alwaysConfirm));
+        system.login(*sessions.back(), "customer" + std::to_string(c), "pw");
+    }
+
+    CheckoutPipeline pipeline(system);
+    std::mt19937 rng(11);
+    long submitted = 0;
+    long placed = 0;
+    std::function<void(Session&)> next = [&](Session& session)
+    {
+        if (submitted == checkouts) return;
+        ++submitted;
+        fillCart(system, session, rng);
+        pipeline.submit(session, [&next, &placed, &session](const CheckoutPipeline::Result& result)
+        {
+            if (result.outcome == CheckoutPipeline::Outcome::PLACED) ++placed;
+            next(session);
+        });
+    };
+
+    auto start = Clock::now();
+    for (auto& session : sessions) next(*session);
+    pipeline.run();
+    double pipelineSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::fprintf(stderr, "placeOrder: %.0f checkouts/sec\n", checkouts / syncSeconds);
+    std::fprintf(stderr, "pipeline:   %.0f checkouts/sec (%.2fx) | %ld placed | %zu in flight at most | %llu group commits\n",
+                 checkouts / pipelineSeconds, syncSeconds / pipelineSeconds, placed, pipeline.getMaxInFlight(),
+                 static_cast<unsigned long long>(pipeline.getGroupCommits()));
+    std::cerr << "stage    | entered  | max depth | avg wait us | avg run us\n";
+    for (CheckoutStage stage : { CheckoutStage::VALIDATE, CheckoutStage::PRICE, CheckoutStage::RESERVE, CheckoutStage::RECORD, CheckoutStage::PERSIST })
+    {
+        const CheckoutPipeline::StageStats& s = pipeline.getStageStats(stage);
+        std::fprintf(stderr, "%-8s | %-8llu | %-9zu | %-11.1f | %.1f\n", CheckoutPipeline::stageName(stage),
+                     static_cast<unsigned long long>(s.entered), s.maxDepth, s.averageWaitUs(), s.averageServiceUs());
+    }
+}
+
+#ifdef __linux__
+// One keep-alive connection of the load generator
+class HttpClient
+{
+private:
+    int fd = -1;
+    std::string in;
+
+public:
+    bool connectTo(int port)
+    {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+
+    ~HttpClient()
+    {
+        if (fd >= 0) close(fd);
+    }
+
+    bool sendAll(const std::string& data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Reads one response; returns its status code, or -1 if the connection failed
+    int readResponse()
+    {
+        char buffer[64 * 1024];
+        while (true)
+        {
+            size_t headerEnd = in.find("\r\n\r\n");
+            if (headerEnd != std::string::npos)
+            {
+                size_t lengthAt = in.find("Content-Length: ");
+                size_t length = lengthAt < headerEnd ? std::strtoul(in.c_str() + lengthAt + 16, nullptr, 10) : 0;
+                if (in.size() >= headerEnd + 4 + length)
+                {
+                    int status = std::atoi(in.c_str() + 9);
+                    in.erase(0, headerEnd + 4 + length);
+                    return status;
+                }
+            }
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return -1;
+            in.append(buffer, static_cast<size_t>(n));
+        }
+    }
+};
+#endif
+
+// Catalog reads over HTTP against an in-process server on loopback. Each
+// connection keeps `pipeline` requests in flight.
+void benchHttp(const BenchOptions& options)
+{
+#ifdef __linux__
+    const int productCount = static_cast<int>(options.get("products", 1000));
+    const int serverThreads = static_cast<int>(options.get("server_threads", defaultThreads()));
+    const int connections = static_cast<int>(options.get("connections", 8));
+    const int pipeline = static_cast<int>(std::max(1L, options.get("pipeline", 16)));
+    const double duration = static_cast<double>(options.get("seconds", 3));
+
+    std::cerr << "scenario=http products=" << productCount << " server_threads=" << serverThreads << " connections=" << connections << " pipeline=" << pipeline << "\n";
+
+    ScratchDirectory scratch("ecommerce_bench_http");
+    ECommerceSystem system(false);
+    seedStore(system, productCount, 0, 100);
+    StoreApi api(system);
+    HttpServer server([&api](const HttpRequest& request) { return api.handle(request); }, serverThreads);
+    server.start("127.0.0.1", 0);
+
+    std::atomic<bool> done(false);
+    std::atomic<long> completed(0), failed(0);
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < connections; ++c)
+    {
+        clients.emplace_back([&, c]()
+        {
+            HttpClient client;
+            if (!client.connectTo(server.port()))
+            {
+                failed++;
+                return;
+            }
+            std::mt19937 rng(c);
+            std::uniform_int_distribution<int> product(1, productCount);
+            while (!done)
+            {
+                std::string batch;
+                for (int i = 0; i < pipeline; ++i)
+                {
+                    batch += "GET /products/" + std::to_string(product(rng)) + " HTTP/1.1\r\nHost: bench\r\n\r\n";
+                }
+                auto sent = Clock::now();
+                if (!client.sendAll(batch))
+                {
+                    failed++;
+                    return;
+                }
+                for (int i = 0; i < pipeline; ++i)
+                {
+                    int status = client.readResponse();
+                    if (status < 0)
+                    {
+                        failed++;
+                        return;
+                    }
+                    if (status != 200) failed++;
+                    latencies[c].push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+                }
+                completed += pipeline;
+            }
+        });
+    }
+
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    done = true;
+    for (auto& t : clients) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    server.stop();
+
+    std::vector<double> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    double p50 = percentile(all, 50), p99 = percentile(all, 99), p999 = percentile(all, 99.9);
+    std::fprintf(stderr, "%.0f req/s | %ld requests | %ld errors | latency p50 %.0f us, p99 %.0f us, p999 %.0f us\n",
+                 completed / seconds, completed.load(), failed.load(), p50, p99, p999);
+#else
+    (void)options;
+    std::cerr << "scenario=http needs Linux (epoll).\n";
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    std::map<std::string, void (*)(const BenchOptions&)> scenarios = {
+        { "sessions", benchSessions },
+        { "contention", benchContention },
+        { "pricing", benchPricing },
+        { "catalog", benchCatalog },
+        { "holds", benchHolds },
+        { "batch", benchBatch },
+        { "checkout", benchCheckout },
+        { "pipeline", benchPipeline },
+        { "browse", benchBrowse },
+        { "scan", benchScan },
+        { "allocations", benchAllocations },
+        { "import", benchImport },
+        { "export", benchExport },
+        { "load", benchLoad },
+        { "suite", benchSuite },
+        { "http", benchHttp },
+    };
+
+    if (argc < 2 || scenarios.find(argv[1]) == scenarios.end())
+    {
+        std::cerr << "Usage: " << argv[0] << " <scenario> [--key=value ...]\nScenarios:";
+        for (const auto& s : scenarios) std::cerr << " " << s.first;
+        std::cerr << "\n";
+        return 1;
+    }
+
+    BenchOptions options;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) == 0 && eq != std::string::npos)
+        {
+            options.values[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+        }
+    }
+
+    silenceConsole();
+    scenarios[argv[1]](options);
+    return 0;
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include "TimingWheel.h"
+#include "ProductCatalog.h"
+#include "config.h"
+
+// Soft stock reservations for cart lines.
+//
+// A hold moves units of a product from its stock to its held count for a
+// limited time. Checkout takes the held units instead of competing for stock;
+// if the cart is abandoned, the hold expires and the units go back on sale
+// at the next expire(), which the store calls every tick and on cart
+// operations.
+// There is at most one hold per (customer, product): adding more to a cart
+// line grows the hold and restarts its clock.
+//
+// Holds are sharded by customer, each shard with its own timing wheel. Taking
+// or releasing a hold early leaves its wheel entry in place; the entry no
+// longer matches the hold's generation when it fires and is ignored.
+class CartHolds
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t SHARDS = 16;
+    static constexpr int64_t TICK_MS = 1000; // expiry resolution
+
+private:
+    struct Hold
+    {
+        ProductId productId;
+        int quantity;
+        uint64_t generation;
+    };
+
+    struct Timer
+    {
+        uint64_t key;
+        uint64_t generation;
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, Hold> holds;
+        TimingWheel<Timer> wheel;
+        uint64_t generations = 0; // never reused, so a stale timer cannot match a newer hold
+    };
+
+    ProductCatalog& products;
+    const Clock::time_point origin;
+    std::array<Shard, SHARDS> shards;
+    std::atomic<uint64_t> sweptTick{0};
+    std::atomic<uint64_t> expiredUnits{0};
+
+    static uint64_t keyFor(UserId userId, ProductId productId)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(userId)) << 32) | static_cast<uint32_t>(productId);
+    }
+
+    Shard& shardFor(UserId userId)
+    {
+        return shards[static_cast<uint32_t>(userId) % SHARDS];
+    }
+
+    const Shard& shardFor(UserId userId) const
+    {
+        return shards[static_cast<uint32_t>(userId) % SHARDS];
+    }
+
+    uint64_t tickAt(Clock::time_point t) const
+    {
+        if (t <= origin) return 0;
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(t - origin).count() / TICK_MS);
+    }
+
+    static uint64_t ticksFor(std::chrono::seconds ttl)
+    {
+        int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(ttl).count();
+        return ms <= 0 ? 1 : static_cast<uint64_t>((ms + TICK_MS - 1) / TICK_MS);
+    }
+
+    // Caller holds the shard lock
+    static void schedule(Shard& shard, uint64_t key, Hold& entry, uint64_t expiry)
+    {
+        entry.generation = ++shard.generations;
+        shard.wheel.schedule(expiry, { key, entry.generation });
+    }
+
+public:
+    explicit CartHolds(ProductCatalog& products) : products(products), origin(Clock::now()) {}
+
+    CartHolds(const CartHolds&) = delete;
+    CartHolds& operator=(const CartHolds&) = delete;
+
+    // Sets `quantity` more units aside for the customer; false if not enough are in stock
+    bool hold(UserId userId, ProductId productId, int quantity, std::chrono::seconds ttl, Clock::time_point now = Clock::now())
+    {
+        bool taken = false;
+        products.modifyConcurrent(productId, [&taken, quantity](ProductRef& p) { taken = p.hold(quantity); });
+        if (!taken) return false;
+
+        uint64_t key = keyFor(userId, productId);
+        Shard& shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Hold& entry = shard.holds.emplace(key, Hold{ productId, 0, 0 }).first->second;
+        entry.quantity += quantity;
+        schedule(shard, key, entry, tickAt(now) + ticksFor(ttl));
+        return true;
+    }
+
+    int heldQuantity(UserId userId, ProductId productId) const
+    {
+        const Shard& shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.holds.find(keyFor(userId, productId));
+        return it == shard.holds.end() ? 0 : it->second.quantity;
+    }
+
+    // Puts up to `quantity` held units back on sale; returns how many were released
+    int release(UserId userId, ProductId productId, int quantity = INT_MAX)
+    {
+        int released = 0;
+        {
+            Shard& shard = shardFor(userId);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.holds.find(keyFor(userId, productId));
+            if (it == shard.holds.end()) return 0;
+            released = std::min(quantity, it->second.quantity);
+            it->second.quantity -= released;
+            if (it->second.quantity == 0) shard.holds.erase(it);
+        }
+        products.modifyConcurrent(productId, [released](ProductRef& p) { p.releaseHold(released); });
+        return released;
+    }
+
+    // Ends the hold for a checkout: up to `quantity` held units count as sold and
+    // any surplus goes back on sale. Returns the units taken; the rest of the
+    // line has to come from stock. `product` is the one the checkout has
+    // already looked up.
+    int take(UserId userId, ProductRef& product, int quantity)
+    {
+        int held = 0;
+        {
+            Shard& shard = shardFor(userId);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.holds.find(keyFor(userId, product.getId()));
+            if (it == shard.holds.end()) return 0;
+            held = it->second.quantity;
+            shard.holds.erase(it);
+        }
+        int taken = std::min(quantity, held);
+        product.consumeHold(taken);
+        product.releaseHold(held - taken);
+        return taken;
+    }
+
+    // Gives back units obtained from take() when the checkout does not go through
+    void reinstate(UserId userId, ProductRef& product, int quantity, std::chrono::seconds ttl, Clock::time_point now = Clock::now())
+    {
+        if (quantity <= 0) return;
+        product.reinstateHold(quantity);
+
+        uint64_t key = keyFor(userId, product.getId());
+        Shard& shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Hold& entry = shard.holds.emplace(key, Hold{ product.getId(), 0, 0 }).first->second;
+        entry.quantity += quantity;
+        schedule(shard, key, entry, tickAt(now) + ticksFor(ttl));
+    }
+
+    // Releases every hold that is due. Units are summed per product first, so a
+    // batch costs one stock update per product however many holds expired.
+    // Cheap enough to call on every request: it returns at once unless a tick
+    // has passed since the last sweep.
+    size_t expire(Clock::time_point now = Clock::now())
+    {
+        uint64_t tick = tickAt(now);
+        uint64_t last = sweptTick.load();
+        if (tick <= last || !sweptTick.compare_exchange_strong(last, tick)) return 0;
+
+        std::unordered_map<ProductId, int> due;
+        size_t expired = 0;
+        for (Shard& shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.wheel.advance(tick, [&shard, &due, &expired](const Timer& timer)
+            {
+                auto it = shard.holds.find(timer.key);
+                if (it == shard.holds.end() || it->second.generation != timer.generation) return;
+                due[it->second.productId] += it->second.quantity;
+                shard.holds.erase(it);
+                ++expired;
+            });
+        }
+
+        uint64_t units = 0;
+        for (const auto& entry : due)
+        {
+            products.modifyConcurrent(entry.first, [&entry](ProductRef& p) { p.releaseHold(entry.second); });
+            units += static_cast<uint64_t>(entry.second);
+        }
+        expiredUnits.fetch_add(units);
+        return expired;
+    }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (const Shard& shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.holds.size();
+        }
+        return total;
+    }
+
+    // Units returned to stock by expiry since startup
+    uint64_t getExpiredUnits() const
+    {
+        return expiredUnits.load();
+    }
+};
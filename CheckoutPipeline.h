@@ -0,0 +1,375 @@
+#pragma once
+#include <coroutine>
+#include <array>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <exception>
+#include <utility>
+#include "ECommerceSystem.h"
+
+enum class CheckoutStage { VALIDATE, PRICE, RESERVE, RECORD, PERSIST };
+
+// Checkout as a pipeline of coroutine stages:
+// validate -> price -> reserve -> record -> persist.
+// Price quotes the cart, noting each product's price version, and turns the
+// checkout away if the total is not the one the customer expected; nothing
+// is reserved yet. Reserve then takes the stock in one pass over the cart
+// (see ECommerceSystem::reserveCart) and fails if a product was repriced
+// since the quote, so the order charges the quoted total.
+//
+// Every checkout is a coroutine that queues itself at the start of each
+// stage. One executor thread (whichever calls run()) drains the queues,
+// always taking from the stage furthest down the pipeline first so orders
+// already under way finish before new ones start. Persistence goes to a
+// writer thread that saves once for all the checkouts waiting on it (group
+// commit); meanwhile the executor carries on with the orders behind them.
+//
+// A Session submitted here belongs to the pipeline until its callback runs.
+class CheckoutPipeline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t STAGES = 5;
+
+    enum class Outcome { PLACED, NOT_LOGGED_IN, EMPTY_CART, TOO_MANY_ITEMS, OUT_OF_STOCK, PRICE_CHANGED };
+
+    struct Result
+    {
+        Outcome outcome;
+        OrderId orderId; // 0 unless placed
+        double total;
+    };
+
+    using Callback = std::function<void(const Result&)>;
+
+    // Time is split into waiting in the stage's queue and running it; the
+    // persist stage counts the wait for its save as running time
+    struct StageStats
+    {
+        uint64_t entered = 0;
+        size_t depth = 0;
+        size_t maxDepth = 0;
+        uint64_t waitNs = 0;
+        uint64_t serviceNs = 0;
+
+        double averageWaitUs() const
+        {
+            return entered ? waitNs / 1000.0 / entered : 0.0;
+        }
+
+        double averageServiceUs() const
+        {
+            return entered ? serviceNs / 1000.0 / entered : 0.0;
+        }
+    };
+
+private:
+    // Fire-and-forget coroutine: starts at once and frees itself when done
+    struct Task
+    {
+        struct promise_type
+        {
+            Task get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    struct Queued
+    {
+        std::coroutine_handle<> handle;
+        Clock::time_point since;
+    };
+
+    // co_await enter(stage) queues the checkout; resumes with the time it left the queue
+    struct StageAwaiter
+    {
+        CheckoutPipeline& pipeline;
+        CheckoutStage stage;
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            pipeline.enqueue(stage, handle);
+        }
+
+        Clock::time_point await_resume() const
+        {
+            return Clock::now();
+        }
+    };
+
+    // co_await save(session) resumes on the executor once the writer has saved the store and the cart
+    struct SaveAwaiter
+    {
+        CheckoutPipeline& pipeline;
+        Session& session;
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            {
+                std::lock_guard<std::mutex> lock(pipeline.writerMutex);
+                pipeline.unsaved.push_back({ handle, &session });
+            }
+            pipeline.writerWake.notify_one();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    struct PendingSave
+    {
+        std::coroutine_handle<> handle;
+        Session* session;
+    };
+
+    ECommerceSystem& system;
+
+    // Executor state, touched only by the thread in run()
+    std::array<std::deque<Queued>, STAGES> queues;
+    std::array<StageStats, STAGES> stats;
+    size_t inFlight = 0;
+    size_t maxInFlight = 0;
+
+    // Writer thread: saves for checkouts in `unsaved`, hands them back through `saved`
+    std::mutex writerMutex;
+    std::condition_variable writerWake;
+    std::vector<PendingSave> unsaved;
+    bool stopping = false;
+
+    std::mutex savedMutex;
+    std::condition_variable savedWake;
+    std::vector<std::coroutine_handle<>> saved;
+
+    uint64_t groupCommits = 0; // written by the writer thread, read under writerMutex
+    std::thread writer;
+
+    StageAwaiter enter(CheckoutStage stage)
+    {
+        return { *this, stage };
+    }
+
+    SaveAwaiter save(Session& session)
+    {
+        return { *this, session };
+    }
+
+    void enqueue(CheckoutStage stage, std::coroutine_handle<> handle)
+    {
+        size_t index = static_cast<size_t>(stage);
+        queues[index].push_back({ handle, Clock::now() });
+        StageStats& s = stats[index];
+        s.entered++;
+        s.depth = queues[index].size();
+        s.maxDepth = std::max(s.maxDepth, s.depth);
+    }
+
+    void leave(CheckoutStage stage, Clock::time_point started)
+    {
+        stats[static_cast<size_t>(stage)].serviceNs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count());
+    }
+
+    void writerLoop()
+    {
+        std::vector<PendingSave> batch;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(writerMutex);
+                writerWake.wait(lock, [this] { return stopping || !unsaved.empty(); });
+                if (unsaved.empty()) return;
+                batch.swap(unsaved);
+                groupCommits++;
+            }
+
+            // Every order in the batch was recorded before this snapshot is taken
+            system.persist();
+            for (const PendingSave& pending : batch)
+            {
+                system.saveCart(*pending.session);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(savedMutex);
+                for (const PendingSave& pending : batch) saved.push_back(pending.handle);
+            }
+            savedWake.notify_one();
+            batch.clear();
+        }
+    }
+
+    Task checkout(Session& session, double expectedTotal, Callback done)
+    {
+        Result result{ Outcome::PLACED, 0, 0.0 };
+        Cart& cart = session.getCart();
+        const std::vector<CartItem>& items = cart.getItems();
+        std::vector<uint64_t> versions;
+        std::vector<ECommerceSystem::ReservedLine> lines;
+        const UserId customerId = session.getUserId();
+        Metrics& metrics = Metrics::instance();
+
+        Clock::time_point started = co_await enter(CheckoutStage::VALIDATE);
+        if (!session.isLoggedIn()) result.outcome = Outcome::NOT_LOGGED_IN;
+        else if (cart.isEmpty()) result.outcome = Outcome::EMPTY_CART;
+        else if (cart.getItemCount() > MAX_CART_ITEMS) result.outcome = Outcome::TOO_MANY_ITEMS;
+        leave(CheckoutStage::VALIDATE, started);
+
+        if (result.outcome == Outcome::PLACED)
+        {
+            started = co_await enter(CheckoutStage::PRICE);
+            metrics.add(Counter::CHECKOUT_ATTEMPTS);
+            result.total = system.quoteCart(items, versions);
+            if (expectedTotal >= 0 && result.total != expectedTotal)
+            {
+                metrics.add(Counter::CHECKOUT_CONFLICTS);
+                result.outcome = Outcome::PRICE_CHANGED;
+            }
+            leave(CheckoutStage::PRICE, started);
+        }
+
+        if (result.outcome == Outcome::PLACED)
+        {
+            started = co_await enter(CheckoutStage::RESERVE);
+            double reservedTotal = 0.0;
+            switch (system.reserveCart(customerId, items, &versions, lines, reservedTotal))
+            {
+            case ECommerceSystem::ReserveResult::RESERVED:
+                break;
+            case ECommerceSystem::ReserveResult::OUT_OF_STOCK:
+                result.outcome = Outcome::OUT_OF_STOCK;
+                break;
+            case ECommerceSystem::ReserveResult::PRICE_CHANGED:
+                metrics.add(Counter::CHECKOUT_CONFLICTS);
+                result.outcome = Outcome::PRICE_CHANGED;
+                break;
+            }
+            leave(CheckoutStage::RESERVE, started);
+        }
+
+        if (result.outcome == Outcome::PLACED)
+        {
+            started = co_await enter(CheckoutStage::RECORD);
+            metrics.add(Counter::CHECKOUT_COMMITTED);
+            result.orderId = system.recordOrder(session, lines, result.total);
+            leave(CheckoutStage::RECORD, started);
+
+            // Without autosave there is nothing to write, so no trip to the writer
+            started = co_await enter(CheckoutStage::PERSIST);
+            if (system.autoSave) co_await save(session);
+            leave(CheckoutStage::PERSIST, started);
+        }
+
+        inFlight--;
+        if (done) done(result);
+    }
+
+    // Resumes one queued checkout, latest stage first; false if none is queued
+    bool resumeNext()
+    {
+        for (size_t index = STAGES; index-- > 0;)
+        {
+            std::deque<Queued>& queue = queues[index];
+            if (queue.empty()) continue;
+
+            Queued next = queue.front();
+            queue.pop_front();
+            StageStats& s = stats[index];
+            s.depth = queue.size();
+            s.waitNs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - next.since).count());
+            next.handle.resume();
+            return true;
+        }
+        return false;
+    }
+
+public:
+    explicit CheckoutPipeline(ECommerceSystem& system) : system(system)
+    {
+        writer = std::thread([this] { writerLoop(); });
+    }
+
+    CheckoutPipeline(const CheckoutPipeline&) = delete;
+    CheckoutPipeline& operator=(const CheckoutPipeline&) = delete;
+
+    ~CheckoutPipeline()
+    {
+        run();
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            stopping = true;
+        }
+        writerWake.notify_one();
+        writer.join();
+    }
+
+    // Starts a checkout of the session's cart; `done` runs on the executor
+    // when it finishes. A non-negative `expectedTotal` is the total the
+    // customer agreed to: the order is refused if prices moved since.
+    // Call from the executor thread (or before run()).
+    void submit(Session& session, Callback done = nullptr, double expectedTotal = -1.0)
+    {
+        inFlight++;
+        maxInFlight = std::max(maxInFlight, inFlight);
+        checkout(session, expectedTotal, std::move(done));
+    }
+
+    // Drives checkouts until none is in flight
+    void run()
+    {
+        std::vector<std::coroutine_handle<>> finishing;
+        while (inFlight > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(savedMutex);
+                if (saved.empty() && std::all_of(queues.begin(), queues.end(), [](const std::deque<Queued>& q) { return q.empty(); }))
+                {
+                    savedWake.wait(lock, [this] { return !saved.empty(); });
+                }
+                finishing.swap(saved);
+            }
+
+            for (std::coroutine_handle<> handle : finishing) handle.resume();
+            finishing.clear();
+
+            // Work through the queues, checking back for finished saves now and then
+            for (int i = 0; i < 64 && resumeNext(); ++i) {}
+        }
+    }
+
+    size_t getInFlight() const
+    {
+        return inFlight;
+    }
+
+    size_t getMaxInFlight() const
+    {
+        return maxInFlight;
+    }
+
+    const StageStats& getStageStats(CheckoutStage stage) const
+    {
+        return stats[static_cast<size_t>(stage)];
+    }
+
+    uint64_t getGroupCommits()
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        return groupCommits;
+    }
+
+    static const char* stageName(CheckoutStage stage)
+    {
+        static const char* const names[STAGES] = { "validate", "price", "reserve", "record", "persist" };
+        return names[static_cast<size_t>(stage)];
+    }
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include "config.h"
+
+// Wall-clock time in microseconds since the Unix epoch, read from a cached
+// value that a ticker thread refreshes every CLOCK_TICK_MS. Reading it is one
+// relaxed load and no system call, at the price of being up to a tick behind.
+class CoarseClock
+{
+private:
+    std::atomic<int64_t> micros{preciseMicros()};
+    std::atomic<bool> stopping{false};
+    std::thread ticker;
+
+    CoarseClock()
+    {
+        ticker = std::thread([this]
+        {
+            while (!stopping.load(std::memory_order_relaxed))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(CLOCK_TICK_MS));
+                micros.store(preciseMicros(), std::memory_order_relaxed);
+            }
+        });
+    }
+
+    ~CoarseClock()
+    {
+        stopping.store(true);
+        ticker.join();
+    }
+
+public:
+    CoarseClock(const CoarseClock&) = delete;
+    CoarseClock& operator=(const CoarseClock&) = delete;
+
+    static int64_t nowMicros()
+    {
+        static CoarseClock clock;
+        return clock.micros.load(std::memory_order_relaxed);
+    }
+
+    static int64_t preciseMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+};
@@ -0,0 +1,639 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "config.h"
+
+// Columnar file for analytics exports.
+//
+// Rows are cut into row groups; within a group every column is stored as
+// one contiguous, separately encoded chunk, so a reader can fetch just the
+// columns it needs. A footer at the end of the file holds the schema and,
+// per chunk, its offset, size, encoding and min/max statistics:
+//
+//   "ECOL" version | chunk bytes ... | footer | u32 footer size | "ECOL"
+//
+// Integers in the footer are LEB128 varints (signed ones zigzagged), doubles
+// are 8 bytes little-endian, strings are a varint length and the bytes.
+enum class ColumnType : uint8_t { INT64, DOUBLE, STRING, TIMESTAMP };
+
+enum class ColumnEncoding : uint8_t
+{
+    DELTA_VARINT,   // integers: first value, then zigzag deltas
+    CENTS_DELTA,    // doubles that are whole cents, as DELTA_VARINT of value * 100
+    XOR_DOUBLE,     // any double: bits XORed with the previous value, zero bytes trimmed
+    DICTIONARY,     // strings with few distinct values: the distinct values, then indexes
+    FRONT_CODED     // other strings: length of the prefix shared with the previous value, then the rest
+};
+
+struct ColumnSpec
+{
+    std::string name;
+    ColumnType type;
+};
+
+// Values of one column for one row group; which vector is used depends on the type
+struct ColumnData
+{
+    std::vector<int64_t> ints; // INT64 and TIMESTAMP
+    std::vector<double> doubles;
+    std::vector<std::string> strings;
+
+    void clear()
+    {
+        ints.clear();
+        doubles.clear();
+        strings.clear();
+    }
+};
+
+struct ColumnChunkInfo
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    ColumnEncoding encoding = ColumnEncoding::DELTA_VARINT;
+    int64_t minInt = 0, maxInt = 0;
+    double minDouble = 0.0, maxDouble = 0.0;
+    std::string minString, maxString;
+};
+
+class ColumnCodec
+{
+public:
+    static constexpr char MAGIC[4] = { 'E', 'C', 'O', 'L' };
+    static constexpr uint8_t VERSION = 1;
+
+    static void putVarint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static bool getVarint(const std::string& in, size_t& pos, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < in.size(); shift += 7)
+        {
+            uint8_t byte = static_cast<uint8_t>(in[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    static uint64_t zigzag(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    static int64_t unzigzag(uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    static void putString(std::string& out, std::string_view text)
+    {
+        putVarint(out, text.size());
+        out.append(text.data(), text.size());
+    }
+
+    static bool getString(const std::string& in, size_t& pos, std::string& text)
+    {
+        uint64_t length = 0;
+        if (!getVarint(in, pos, length) || length > in.size() - pos) return false;
+        text.assign(in, pos, static_cast<size_t>(length));
+        pos += static_cast<size_t>(length);
+        return true;
+    }
+
+    static void putDouble(std::string& out, double value)
+    {
+        char bytes[sizeof(double)];
+        std::memcpy(bytes, &value, sizeof(double));
+        out.append(bytes, sizeof(double));
+    }
+
+    static bool getDouble(const std::string& in, size_t& pos, double& value)
+    {
+        if (in.size() - pos < sizeof(double)) return false;
+        std::memcpy(&value, in.data() + pos, sizeof(double));
+        pos += sizeof(double);
+        return true;
+    }
+
+    // Encodes one chunk and fills in its encoding and statistics
+    static std::string encode(ColumnType type, const ColumnData& data, ColumnChunkInfo& info)
+    {
+        std::string out;
+        switch (type)
+        {
+        case ColumnType::INT64:
+        case ColumnType::TIMESTAMP:
+            info.encoding = ColumnEncoding::DELTA_VARINT;
+            encodeInts(data.ints, out);
+            if (!data.ints.empty())
+            {
+                auto range = std::minmax_element(data.ints.begin(), data.ints.end());
+                info.minInt = *range.first;
+                info.maxInt = *range.second;
+            }
+            break;
+        case ColumnType::DOUBLE:
+            encodeDoubles(data.doubles, out, info);
+            if (!data.doubles.empty())
+            {
+                auto range = std::minmax_element(data.doubles.begin(), data.doubles.end());
+                info.minDouble = *range.first;
+                info.maxDouble = *range.second;
+            }
+            break;
+        case ColumnType::STRING:
+            encodeStrings(data.strings, out, info);
+            if (!data.strings.empty())
+            {
+                auto range = std::minmax_element(data.strings.begin(), data.strings.end());
+                info.minString = *range.first;
+                info.maxString = *range.second;
+            }
+            break;
+        }
+        return out;
+    }
+
+    static bool decode(ColumnType type, ColumnEncoding encoding, const std::string& in, size_t rows, ColumnData& data)
+    {
+        data.clear();
+        size_t pos = 0;
+        switch (encoding)
+        {
+        case ColumnEncoding::DELTA_VARINT:
+            return (type == ColumnType::INT64 || type == ColumnType::TIMESTAMP) && decodeInts(in, pos, rows, data.ints);
+        case ColumnEncoding::CENTS_DELTA:
+        {
+            std::vector<int64_t> cents;
+            if (type != ColumnType::DOUBLE || !decodeInts(in, pos, rows, cents)) return false;
+            data.doubles.reserve(rows);
+            for (int64_t c : cents) data.doubles.push_back(static_cast<double>(c) / 100.0);
+            return true;
+        }
+        case ColumnEncoding::XOR_DOUBLE:
+            return type == ColumnType::DOUBLE && decodeXor(in, pos, rows, data.doubles);
+        case ColumnEncoding::DICTIONARY:
+        {
+            if (type != ColumnType::STRING) return false;
+            uint64_t entries = 0;
+            if (!getVarint(in, pos, entries) || entries > in.size()) return false;
+            std::vector<std::string> dictionary(static_cast<size_t>(entries));
+            for (std::string& entry : dictionary)
+            {
+                if (!getString(in, pos, entry)) return false;
+            }
+            data.strings.reserve(rows);
+            for (size_t i = 0; i < rows; ++i)
+            {
+                uint64_t index = 0;
+                if (!getVarint(in, pos, index) || index >= dictionary.size()) return false;
+                data.strings.push_back(dictionary[static_cast<size_t>(index)]);
+            }
+            return true;
+        }
+        case ColumnEncoding::FRONT_CODED:
+        {
+            if (type != ColumnType::STRING) return false;
+            std::string previous;
+            data.strings.reserve(rows);
+            for (size_t i = 0; i < rows; ++i)
+            {
+                uint64_t shared = 0;
+                std::string suffix;
+                if (!getVarint(in, pos, shared) || shared > previous.size() || !getString(in, pos, suffix)) return false;
+                previous.resize(static_cast<size_t>(shared));
+                previous += suffix;
+                data.strings.push_back(previous);
+            }
+            return true;
+        }
+        }
+        return false;
+    }
+
+private:
+    static void encodeInts(const std::vector<int64_t>& values, std::string& out)
+    {
+        out.reserve(values.size() * 2);
+        int64_t previous = 0;
+        for (int64_t value : values)
+        {
+            putVarint(out, zigzag(static_cast<int64_t>(static_cast<uint64_t>(value) - static_cast<uint64_t>(previous))));
+            previous = value;
+        }
+    }
+
+    static bool decodeInts(const std::string& in, size_t& pos, size_t rows, std::vector<int64_t>& values)
+    {
+        values.reserve(rows);
+        int64_t previous = 0;
+        for (size_t i = 0; i < rows; ++i)
+        {
+            uint64_t delta = 0;
+            if (!getVarint(in, pos, delta)) return false;
+            previous = static_cast<int64_t>(static_cast<uint64_t>(previous) + static_cast<uint64_t>(unzigzag(delta)));
+            values.push_back(previous);
+        }
+        return true;
+    }
+
+    static void encodeDoubles(const std::vector<double>& values, std::string& out, ColumnChunkInfo& info)
+    {
+        // Money is usually whole cents; anything else goes through the lossless XOR path
+        std::vector<int64_t> cents;
+        cents.reserve(values.size());
+        for (double value : values)
+        {
+            if (!(std::fabs(value) < 1e15) || (value == 0.0 && std::signbit(value))) break;
+            double scaled = std::round(value * 100.0);
+            if (scaled / 100.0 != value) break;
+            cents.push_back(static_cast<int64_t>(scaled));
+        }
+        if (cents.size() == values.size())
+        {
+            info.encoding = ColumnEncoding::CENTS_DELTA;
+            encodeInts(cents, out);
+            return;
+        }
+
+        info.encoding = ColumnEncoding::XOR_DOUBLE;
+        uint64_t previous = 0;
+        for (double value : values)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            uint64_t x = bits ^ previous;
+            previous = bits;
+
+            // High nibble: zero bytes dropped from the top, low nibble: from the bottom
+            int leading = 0, trailing = 0;
+            while (leading < 8 && ((x >> (56 - 8 * leading)) & 0xff) == 0) ++leading;
+            while (leading + trailing < 8 && ((x >> (8 * trailing)) & 0xff) == 0) ++trailing;
+            out += static_cast<char>(leading << 4 | trailing);
+            for (int b = 7 - leading; b >= trailing; --b) out += static_cast<char>((x >> (8 * b)) & 0xff);
+        }
+    }
+
+    static bool decodeXor(const std::string& in, size_t& pos, size_t rows, std::vector<double>& values)
+    {
+        values.reserve(rows);
+        uint64_t previous = 0;
+        for (size_t i = 0; i < rows; ++i)
+        {
+            if (pos >= in.size()) return false;
+            uint8_t header = static_cast<uint8_t>(in[pos++]);
+            int leading = header >> 4, trailing = header & 15;
+            if (leading + trailing > 8 || in.size() - pos < static_cast<size_t>(8 - leading - trailing)) return false;
+            uint64_t x = 0;
+            for (int b = 7 - leading; b >= trailing; --b) x |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++])) << (8 * b);
+            previous ^= x;
+            double value;
+            std::memcpy(&value, &previous, sizeof(value));
+            values.push_back(value);
+        }
+        return true;
+    }
+
+    static void encodeStrings(const std::vector<std::string>& values, std::string& out, ColumnChunkInfo& info)
+    {
+        std::unordered_map<std::string_view, uint32_t> distinct;
+        const size_t limit = values.size() / 4 + 1;
+        for (const std::string& value : values)
+        {
+            distinct.emplace(value, static_cast<uint32_t>(distinct.size()));
+            if (distinct.size() > limit) break;
+        }
+
+        if (distinct.size() <= limit)
+        {
+            info.encoding = ColumnEncoding::DICTIONARY;
+            std::vector<std::string_view> dictionary(distinct.size());
+            for (const auto& entry : distinct) dictionary[entry.second] = entry.first;
+            putVarint(out, dictionary.size());
+            for (std::string_view entry : dictionary) putString(out, entry);
+            for (const std::string& value : values) putVarint(out, distinct[value]);
+            return;
+        }
+
+        info.encoding = ColumnEncoding::FRONT_CODED;
+        std::string_view previous;
+        for (const std::string& value : values)
+        {
+            size_t shared = 0;
+            size_t most = std::min(previous.size(), value.size());
+            while (shared < most && previous[shared] == value[shared]) ++shared;
+            putVarint(out, shared);
+            putString(out, std::string_view(value).substr(shared));
+            previous = value;
+        }
+    }
+};
+
+// Streams rows into a columnar file. Only the current row group is held in
+// memory; when it is full its columns are encoded in parallel and written out.
+//
+//   ColumnarWriter writer(path, {{"id", ColumnType::INT64}, {"name", ColumnType::STRING}});
+//   writer.addInt(0, 42); writer.addString(1, "Lamp"); writer.endRow();
+//   writer.finish();
+class ColumnarWriter
+{
+private:
+    std::ofstream out;
+    std::vector<ColumnSpec> schema;
+    std::vector<ColumnData> columns;
+    std::vector<std::vector<ColumnChunkInfo>> groups; // per row group, per column
+    std::vector<uint64_t> groupRows;
+    size_t rowGroupRows;
+    size_t pendingRows = 0;
+    uint64_t rows = 0;
+    uint64_t written = 0;
+    bool finished = false;
+
+    void write(const std::string& bytes)
+    {
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        written += bytes.size();
+    }
+
+    void flushGroup()
+    {
+        if (pendingRows == 0) return;
+
+        std::vector<std::string> encoded(columns.size());
+        std::vector<ColumnChunkInfo> infos(columns.size());
+        std::atomic<size_t> nextColumn{0};
+        auto encodeColumns = [&]()
+        {
+            for (size_t c = nextColumn++; c < columns.size(); c = nextColumn++)
+            {
+                encoded[c] = ColumnCodec::encode(schema[c].type, columns[c], infos[c]);
+            }
+        };
+
+        size_t helpers = std::min<size_t>(columns.size(), std::max(1u, std::thread::hardware_concurrency())) - 1;
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < helpers; ++i) workers.emplace_back(encodeColumns);
+        encodeColumns();
+        for (auto& w : workers) w.join();
+
+        for (size_t c = 0; c < columns.size(); ++c)
+        {
+            infos[c].offset = written;
+            infos[c].size = encoded[c].size();
+            write(encoded[c]);
+            columns[c].clear();
+        }
+        groups.push_back(std::move(infos));
+        groupRows.push_back(pendingRows);
+        pendingRows = 0;
+    }
+
+    std::string footer() const
+    {
+        std::string bytes;
+        ColumnCodec::putVarint(bytes, schema.size());
+        for (const ColumnSpec& column : schema)
+        {
+            ColumnCodec::putString(bytes, column.name);
+            bytes += static_cast<char>(column.type);
+        }
+
+        ColumnCodec::putVarint(bytes, groups.size());
+        for (size_t g = 0; g < groups.size(); ++g)
+        {
+            ColumnCodec::putVarint(bytes, groupRows[g]);
+            for (size_t c = 0; c < schema.size(); ++c)
+            {
+                const ColumnChunkInfo& info = groups[g][c];
+                ColumnCodec::putVarint(bytes, info.offset);
+                ColumnCodec::putVarint(bytes, info.size);
+                bytes += static_cast<char>(info.encoding);
+                switch (schema[c].type)
+                {
+                case ColumnType::INT64:
+                case ColumnType::TIMESTAMP:
+                    ColumnCodec::putVarint(bytes, ColumnCodec::zigzag(info.minInt));
+                    ColumnCodec::putVarint(bytes, ColumnCodec::zigzag(info.maxInt));
+                    break;
+                case ColumnType::DOUBLE:
+                    ColumnCodec::putDouble(bytes, info.minDouble);
+                    ColumnCodec::putDouble(bytes, info.maxDouble);
+                    break;
+                case ColumnType::STRING:
+                    ColumnCodec::putString(bytes, info.minString);
+                    ColumnCodec::putString(bytes, info.maxString);
+                    break;
+                }
+            }
+        }
+        return bytes;
+    }
+
+public:
+    ColumnarWriter(const std::string& path, std::vector<ColumnSpec> schema, size_t rowGroupRows = COLUMNAR_ROW_GROUP_ROWS)
+        : out(path, std::ios::binary | std::ios::trunc), schema(std::move(schema)), rowGroupRows(std::max<size_t>(1, rowGroupRows))
+    {
+        columns.resize(this->schema.size());
+        std::string header(ColumnCodec::MAGIC, sizeof(ColumnCodec::MAGIC));
+        header += static_cast<char>(ColumnCodec::VERSION);
+        write(header);
+    }
+
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+
+    bool isOpen() const
+    {
+        return out.is_open();
+    }
+
+    void addInt(size_t column, int64_t value)
+    {
+        columns[column].ints.push_back(value);
+    }
+
+    void addDouble(size_t column, double value)
+    {
+        columns[column].doubles.push_back(value);
+    }
+
+    void addString(size_t column, std::string value)
+    {
+        columns[column].strings.push_back(std::move(value));
+    }
+
+    // Every column must have had exactly one value added since the last endRow()
+    void endRow()
+    {
+        ++rows;
+        if (++pendingRows == rowGroupRows) flushGroup();
+    }
+
+    // Writes the last row group and the footer; false if anything failed to write
+    bool finish()
+    {
+        if (finished) return out.good();
+        finished = true;
+        flushGroup();
+
+        std::string tail = footer();
+        uint32_t footerSize = static_cast<uint32_t>(tail.size());
+        tail.append(reinterpret_cast<const char*>(&footerSize), sizeof(footerSize));
+        tail.append(ColumnCodec::MAGIC, sizeof(ColumnCodec::MAGIC));
+        write(tail);
+        out.flush();
+        return out.good();
+    }
+
+    uint64_t getRows() const
+    {
+        return rows;
+    }
+
+    uint64_t getBytesWritten() const
+    {
+        return written;
+    }
+};
+
+// Reads the footer of a columnar file and decodes chunks on request
+class ColumnarReader
+{
+private:
+    std::ifstream in;
+    std::vector<ColumnSpec> schema;
+    std::vector<std::vector<ColumnChunkInfo>> groups;
+    std::vector<uint64_t> groupRows;
+
+    bool parseFooter(const std::string& bytes)
+    {
+        size_t pos = 0;
+        uint64_t columnCount = 0;
+        if (!ColumnCodec::getVarint(bytes, pos, columnCount) || columnCount > bytes.size()) return false;
+        schema.resize(static_cast<size_t>(columnCount));
+        for (ColumnSpec& column : schema)
+        {
+            if (!ColumnCodec::getString(bytes, pos, column.name) || pos >= bytes.size()) return false;
+            uint8_t type = static_cast<uint8_t>(bytes[pos++]);
+            if (type > static_cast<uint8_t>(ColumnType::TIMESTAMP)) return false;
+            column.type = static_cast<ColumnType>(type);
+        }
+
+        uint64_t groupCount = 0;
+        if (!ColumnCodec::getVarint(bytes, pos, groupCount) || groupCount > bytes.size()) return false;
+        for (uint64_t g = 0; g < groupCount; ++g)
+        {
+            uint64_t rows = 0;
+            if (!ColumnCodec::getVarint(bytes, pos, rows)) return false;
+            std::vector<ColumnChunkInfo> infos(schema.size());
+            for (size_t c = 0; c < schema.size(); ++c)
+            {
+                ColumnChunkInfo& info = infos[c];
+                if (!ColumnCodec::getVarint(bytes, pos, info.offset) || !ColumnCodec::getVarint(bytes, pos, info.size) || pos >= bytes.size()) return false;
+                uint8_t encoding = static_cast<uint8_t>(bytes[pos++]);
+                if (encoding > static_cast<uint8_t>(ColumnEncoding::FRONT_CODED)) return false;
+                info.encoding = static_cast<ColumnEncoding>(encoding);
+
+                uint64_t low = 0, high = 0;
+                switch (schema[c].type)
+                {
+                case ColumnType::INT64:
+                case ColumnType::TIMESTAMP:
+                    if (!ColumnCodec::getVarint(bytes, pos, low) || !ColumnCodec::getVarint(bytes, pos, high)) return false;
+                    info.minInt = ColumnCodec::unzigzag(low);
+                    info.maxInt = ColumnCodec::unzigzag(high);
+                    break;
+                case ColumnType::DOUBLE:
+                    if (!ColumnCodec::getDouble(bytes, pos, info.minDouble) || !ColumnCodec::getDouble(bytes, pos, info.maxDouble)) return false;
+                    break;
+                case ColumnType::STRING:
+                    if (!ColumnCodec::getString(bytes, pos, info.minString) || !ColumnCodec::getString(bytes, pos, info.maxString)) return false;
+                    break;
+                }
+            }
+            groups.push_back(std::move(infos));
+            groupRows.push_back(rows);
+        }
+        return pos == bytes.size();
+    }
+
+public:
+    // False if the file is missing or not a valid columnar file
+    bool open(const std::string& path)
+    {
+        schema.clear();
+        groups.clear();
+        groupRows.clear();
+        in.open(path, std::ios::binary);
+        if (!in) return false;
+
+        char head[sizeof(ColumnCodec::MAGIC) + 1];
+        char tail[sizeof(uint32_t) + sizeof(ColumnCodec::MAGIC)];
+        in.seekg(0, std::ios::end);
+        std::streamoff fileSize = in.tellg();
+        if (fileSize < static_cast<std::streamoff>(sizeof(head) + sizeof(tail))) return false;
+        in.seekg(0);
+        in.read(head, sizeof(head));
+        in.seekg(fileSize - static_cast<std::streamoff>(sizeof(tail)));
+        in.read(tail, sizeof(tail));
+        if (!in || std::memcmp(head, ColumnCodec::MAGIC, sizeof(ColumnCodec::MAGIC)) != 0 || head[4] != ColumnCodec::VERSION
+            || std::memcmp(tail + sizeof(uint32_t), ColumnCodec::MAGIC, sizeof(ColumnCodec::MAGIC)) != 0) return false;
+
+        uint32_t footerSize;
+        std::memcpy(&footerSize, tail, sizeof(footerSize));
+        if (footerSize > fileSize - static_cast<std::streamoff>(sizeof(head) + sizeof(tail))) return false;
+        std::string footer(footerSize, '\0');
+        in.seekg(fileSize - static_cast<std::streamoff>(sizeof(tail) + footerSize));
+        in.read(&footer[0], footerSize);
+        return in && parseFooter(footer);
+    }
+
+    const std::vector<ColumnSpec>& getSchema() const
+    {
+        return schema;
+    }
+
+    size_t getRowGroupCount() const
+    {
+        return groups.size();
+    }
+
+    uint64_t getRowCount(size_t group) const
+    {
+        return groupRows[group];
+    }
+
+    const ColumnChunkInfo& getChunk(size_t group, size_t column) const
+    {
+        return groups[group][column];
+    }
+
+    bool readColumn(size_t group, size_t column, ColumnData& data)
+    {
+        const ColumnChunkInfo& info = groups[group][column];
+        std::string bytes(static_cast<size_t>(info.size), '\0');
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(info.offset));
+        in.read(&bytes[0], static_cast<std::streamsize>(bytes.size()));
+        return in && ColumnCodec::decode(schema[column].type, info.encoding, bytes, static_cast<size_t>(groupRows[group]), data);
+    }
+};
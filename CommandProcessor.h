@@ -0,0 +1,538 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include "ECommerceSystem.h"
+
+// Line-oriented command protocol for driving the store without the menus,
+// from a script file, a pipe or a recorded workload. One command per line:
+//
+//   login alice secret
+//   add_to_cart 12 2
+//   place_order --yes
+//
+// Arguments are separated by spaces; double quotes group words ("Desk Lamp").
+// Blank lines and lines starting with '#' are skipped. Commands that would
+// ask for confirmation take --yes or --no; without either they get the
+// processor's default answer. `session <name>` switches between named
+// sessions so one script can interleave several users.
+class CommandProcessor
+{
+public:
+    struct Command
+    {
+        std::string name;
+        std::vector<std::string> args;
+        int confirm = 0; // 1 for --yes, -1 for --no, 0 for the default
+    };
+
+    // Per command name: how often it ran, how often it failed, and its latencies
+    struct CommandStats
+    {
+        size_t count = 0;
+        size_t failed = 0;
+        std::vector<double> latenciesNs;
+    };
+
+    struct ReplayReport
+    {
+        size_t commands = 0;
+        size_t failed = 0;
+        double seconds = 0.0;
+        std::map<std::string, CommandStats> byCommand;
+
+        double throughput() const
+        {
+            return seconds > 0.0 ? commands / seconds : 0.0;
+        }
+
+        void print(std::ostream& os) const;
+    };
+
+private:
+    using Handler = bool (CommandProcessor::*)(Session&, const Command&);
+
+    struct Definition
+    {
+        Handler handler;
+        const char* usage;
+    };
+
+    ECommerceSystem& system;
+    bool defaultConfirm;
+    std::map<std::string, std::unique_ptr<Session>> sessions;
+    Session* current;
+    bool usageError = false; // set by the running handler when its arguments are wrong
+
+    bool badUsage()
+    {
+        usageError = true;
+        return false;
+    }
+
+    static const std::map<std::string, Definition>& definitions()
+    {
+        static const std::map<std::string, Definition> table = {
+            { "help", { &CommandProcessor::help, "help" } },
+            { "session", { &CommandProcessor::switchSession, "session <name>" } },
+            { "register", { &CommandProcessor::registerUser, "register <username> <password> [customer|seller]" } },
+            { "login", { &CommandProcessor::login, "login <username> <password>" } },
+            { "logout", { &CommandProcessor::logout, "logout" } },
+            { "browse", { &CommandProcessor::browse, "browse [newest|price|name|stock] [reverse] [cursor]" } },
+            { "search", { &CommandProcessor::search, "search <query>" } },
+            { "view_cart", { &CommandProcessor::viewCart, "view_cart" } },
+            { "add_to_cart", { &CommandProcessor::addToCart, "add_to_cart <product_id> <quantity>" } },
+            { "remove_from_cart", { &CommandProcessor::removeFromCart, "remove_from_cart <product_id>" } },
+            { "clear_cart", { &CommandProcessor::clearCart, "clear_cart [--yes|--no]" } },
+            { "place_order", { &CommandProcessor::placeOrder, "place_order [--yes|--no]" } },
+            { "order_history", { &CommandProcessor::orderHistory, "order_history" } },
+            { "spending_summary", { &CommandProcessor::spendingSummary, "spending_summary" } },
+            { "spending_history", { &CommandProcessor::spendingHistory, "spending_history" } },
+            { "add_product", { &CommandProcessor::addProduct, "add_product <name> <price> <category> <stock>" } },
+            { "import_products", { &CommandProcessor::importProducts, "import_products <csv_or_tsv_file>" } },
+            { "update_price", { &CommandProcessor::updatePrice, "update_price <product_id> <price>" } },
+            { "record_expense", { &CommandProcessor::recordExpense, "record_expense <amount> <description>" } },
+            { "seller_report", { &CommandProcessor::sellerReport, "seller_report" } },
+            { "seller_detailed_report", { &CommandProcessor::sellerDetailedReport, "seller_detailed_report" } },
+            { "refund", { &CommandProcessor::refund, "refund <order_id> [--yes|--no]" } },
+            { "orders", { &CommandProcessor::ordersByStatus, "orders <pending|paid|shipped|delivered|refunded|cancelled>" } },
+            { "order_status", { &CommandProcessor::orderStatus, "order_status <order_id> <paid|shipped|delivered|cancelled>" } },
+            { "stats", { &CommandProcessor::stats, "stats" } },
+            { "metrics", { &CommandProcessor::metrics, "metrics [prometheus_file]" } },
+            { "trace", { &CommandProcessor::trace, "trace start | trace stop <chrome_trace_file>" } },
+            { "expire_holds", { &CommandProcessor::expireHolds, "expire_holds" } },
+            { "save", { &CommandProcessor::save, "save" } },
+            { "export", { &CommandProcessor::exportColumnar, "export <directory>" } },
+        };
+        return table;
+    }
+
+    static bool parseInt(const std::string& text, int& value)
+    {
+        char* end = nullptr;
+        long parsed = std::strtol(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX) return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    static bool parseDouble(const std::string& text, double& value)
+    {
+        char* end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        return !text.empty() && *end == '\0';
+    }
+
+    // The remaining arguments joined back together, for free text such as a search query
+    static std::string joinFrom(const Command& command, size_t first)
+    {
+        std::string text;
+        for (size_t i = first; i < command.args.size(); ++i)
+        {
+            if (i > first) text += ' ';
+            text += command.args[i];
+        }
+        return text;
+    }
+
+    bool help(Session&, const Command&)
+    {
+        std::cout << "Commands:\n";
+        for (const auto& entry : definitions())
+        {
+            std::cout << "  " << entry.second.usage << "\n";
+        }
+        return true;
+    }
+
+    bool switchSession(Session&, const Command& command)
+    {
+        if (command.args.size() != 1) return badUsage();
+        current = &sessionNamed(command.args[0]);
+        return true;
+    }
+
+    bool registerUser(Session&, const Command& command)
+    {
+        if (command.args.size() < 2 || command.args.size() > 3) return badUsage();
+        UserType type = UserType::CUSTOMER;
+        if (command.args.size() == 3)
+        {
+            if (command.args[2] == "seller") type = UserType::SELLER;
+            else if (command.args[2] != "customer") return badUsage();
+        }
+        return system.registerUser(command.args[0], command.args[1], type);
+    }
+
+    bool login(Session& session, const Command& command)
+    {
+        if (command.args.size() != 2) return badUsage();
+        if (session.isLoggedIn()) system.logout(session);
+        return system.login(session, command.args[0], command.args[1]);
+    }
+
+    bool logout(Session& session, const Command&)
+    {
+        bool wasLoggedIn = session.isLoggedIn();
+        system.logout(session);
+        return wasLoggedIn;
+    }
+
+    // One page per command; pass the printed cursor to get the next
+    bool browse(Session&, const Command& command)
+    {
+        ProductSort sort = ProductSort::NEWEST;
+        size_t next = 0;
+        if (next < command.args.size() && !ProductIndex::parseSort(command.args[next++], sort)) return badUsage();
+        bool reverse = next < command.args.size() && command.args[next] == "reverse";
+        if (reverse) ++next;
+        std::string cursor = next < command.args.size() ? command.args[next++] : "";
+        if (next != command.args.size()) return badUsage();
+
+        std::string nextCursor;
+        return system.browseProducts(sort, reverse, cursor, nextCursor);
+    }
+
+    bool search(Session&, const Command& command)
+    {
+        if (command.args.empty()) return badUsage();
+        system.searchProducts(joinFrom(command, 0));
+        return true;
+    }
+
+    bool viewCart(Session& session, const Command&)
+    {
+        system.viewCart(session);
+        return session.isLoggedIn();
+    }
+
+    bool addToCart(Session& session, const Command& command)
+    {
+        int productId = 0, quantity = 0;
+        if (command.args.size() != 2 || !parseInt(command.args[0], productId) || !parseInt(command.args[1], quantity)) return badUsage();
+        return system.addToCart(session, productId, quantity);
+    }
+
+    bool removeFromCart(Session& session, const Command& command)
+    {
+        int productId = 0;
+        if (command.args.size() != 1 || !parseInt(command.args[0], productId)) return badUsage();
+        int before = session.getCart().getItemCount();
+        system.removeFromCart(session, productId);
+        return session.isLoggedIn() && session.getCart().getItemCount() < before;
+    }
+
+    bool clearCart(Session& session, const Command&)
+    {
+        system.clearCart(session);
+        return session.isLoggedIn() && session.getCart().isEmpty();
+    }
+
+    bool placeOrder(Session& session, const Command&)
+    {
+        return system.placeOrder(session);
+    }
+
+    bool orderHistory(Session& session, const Command&)
+    {
+        system.viewOrderHistory(session);
+        return session.isLoggedIn();
+    }
+
+    bool spendingSummary(Session& session, const Command&)
+    {
+        system.viewSpendingSummary(session);
+        return session.isCustomer();
+    }
+
+    bool spendingHistory(Session& session, const Command&)
+    {
+        system.viewSpendingHistory(session);
+        return session.isCustomer();
+    }
+
+    bool addProduct(Session& session, const Command& command)
+    {
+        double price = 0.0;
+        int stock = 0;
+        if (command.args.size() != 4 || !parseDouble(command.args[1], price) || !parseInt(command.args[3], stock)) return badUsage();
+        return system.addProduct(session, command.args[0], price, command.args[2], stock);
+    }
+
+    // Fails if any row was rejected, although the valid rows are still imported
+    bool importProducts(Session& session, const Command& command)
+    {
+        if (command.args.size() != 1) return badUsage();
+        ImportReport report;
+        return system.importProducts(session, command.args[0], report) && report.rejected == 0;
+    }
+
+    bool updatePrice(Session& session, const Command& command)
+    {
+        int productId = 0;
+        double price = 0.0;
+        if (command.args.size() != 2 || !parseInt(command.args[0], productId) || !parseDouble(command.args[1], price)) return badUsage();
+        return system.updatePrice(session, productId, price);
+    }
+
+    bool recordExpense(Session& session, const Command& command)
+    {
+        double amount = 0.0;
+        if (command.args.size() < 2 || !parseDouble(command.args[0], amount)) return badUsage();
+        return system.recordExpense(session, amount, joinFrom(command, 1));
+    }
+
+    bool sellerReport(Session& session, const Command&)
+    {
+        system.viewSellerReport(session);
+        return session.isSeller();
+    }
+
+    bool sellerDetailedReport(Session& session, const Command&)
+    {
+        system.viewSellerDetailedReport(session);
+        return session.isSeller();
+    }
+
+    bool refund(Session& session, const Command& command)
+    {
+        int orderId = 0;
+        if (command.args.size() != 1 || !parseInt(command.args[0], orderId)) return badUsage();
+        return system.processRefund(session, orderId);
+    }
+
+    bool ordersByStatus(Session& session, const Command& command)
+    {
+        OrderStatus status = OrderStatus::PENDING;
+        if (command.args.size() != 1 || !parseOrderStatus(command.args[0], status)) return badUsage();
+        system.viewOrdersByStatus(session, status);
+        return session.isAdmin();
+    }
+
+    bool orderStatus(Session& session, const Command& command)
+    {
+        int orderId = 0;
+        OrderStatus status = OrderStatus::PENDING;
+        if (command.args.size() != 2 || !parseInt(command.args[0], orderId) || !parseOrderStatus(command.args[1], status)) return badUsage();
+        return system.updateOrderStatus(session, orderId, status);
+    }
+
+    bool stats(Session& session, const Command&)
+    {
+        system.viewSystemStatistics(session);
+        return session.isAdmin();
+    }
+
+    bool metrics(Session& session, const Command& command)
+    {
+        if (command.args.size() > 1) return badUsage();
+        return system.viewMetrics(session, command.args.empty() ? "" : command.args[0]);
+    }
+
+    bool trace(Session&, const Command& command)
+    {
+        if (command.args.size() == 1 && command.args[0] == "start")
+        {
+            Tracer::instance().start();
+            std::cout << "Tracing started.\n";
+            return true;
+        }
+        if (command.args.size() != 2 || command.args[0] != "stop") return badUsage();
+        Tracer::instance().stop();
+        if (!Tracer::instance().writeChromeTrace(command.args[1]))
+        {
+            std::cout << "Could not write the trace to " << command.args[1] << "\n";
+            return false;
+        }
+        std::cout << "Trace written to " << command.args[1] << "\n";
+        return true;
+    }
+
+    bool expireHolds(Session&, const Command&)
+    {
+        std::cout << "Released " << system.expireCartHolds() << " expired cart holds.\n";
+        return true;
+    }
+
+    bool save(Session&, const Command&)
+    {
+        system.saveAllData();
+        return true;
+    }
+
+    bool exportColumnar(Session& session, const Command& command)
+    {
+        if (command.args.size() != 1) return badUsage();
+        if (!session.isAdmin())
+        {
+            std::cout << "Only administrators can export store data.\n";
+            return false;
+        }
+        return system.exportColumnar(command.args[0]);
+    }
+
+    Session& sessionNamed(const std::string& name)
+    {
+        std::unique_ptr<Session>& slot = sessions[name];
+        if (!slot) slot = std::make_unique<Session>();
+        return *slot;
+    }
+
+public:
+    // `confirmByDefault` answers prompts of commands given without --yes/--no
+    explicit CommandProcessor(ECommerceSystem& system, bool confirmByDefault = false) : system(system), defaultConfirm(confirmByDefault), current(nullptr)
+    {
+        current = &sessionNamed("main");
+    }
+
+    // Splits a line into a command; returns false for blank lines and comments
+    static bool parse(const std::string& line, Command& command)
+    {
+        command = Command();
+        std::vector<std::string> words;
+        std::string word;
+        bool quoted = false;
+        bool inWord = false;
+        for (char c : line)
+        {
+            if (c == '"')
+            {
+                quoted = !quoted;
+                inWord = true;
+            }
+            else if (!quoted && (c == ' ' || c == '\t' || c == '\r'))
+            {
+                if (inWord) words.push_back(word);
+                word.clear();
+                inWord = false;
+            }
+            else
+            {
+                word += c;
+                inWord = true;
+            }
+        }
+        if (inWord) words.push_back(word);
+
+        if (words.empty() || (!words[0].empty() && words[0][0] == '#')) return false;
+        command.name = words[0];
+        for (size_t i = 1; i < words.size(); ++i)
+        {
+            if (words[i] == "--yes" || words[i] == "-y") command.confirm = 1;
+            else if (words[i] == "--no" || words[i] == "-n") command.confirm = -1;
+            else command.args.push_back(words[i]);
+        }
+        return true;
+    }
+
+    // Runs one command against the current session; false if it is unknown,
+    // malformed or did not succeed
+    bool execute(const Command& command)
+    {
+        auto it = definitions().find(command.name);
+        if (it == definitions().end())
+        {
+            std::cout << "Unknown command '" << command.name << "'. Type 'help' for the list.\n";
+            return false;
+        }
+
+        bool answer = command.confirm == 0 ? defaultConfirm : command.confirm > 0;
+        current->setConfirm([answer](const std::string& prompt)
+        {
+            std::cout << prompt << (answer ? " yes\n" : " no\n");
+            return answer;
+        });
+
+        usageError = false;
+        bool ok = (this->*(it->second.handler))(*current, command);
+        if (usageError)
+        {
+            std::cout << "Usage: " << it->second.usage << "\n";
+        }
+        return ok;
+    }
+
+    bool execute(const std::string& line)
+    {
+        Command command;
+        return !parse(line, command) || execute(command);
+    }
+
+    // Executes every line of `input` as it is read; returns the number of failed commands
+    size_t run(std::istream& input)
+    {
+        size_t failed = 0;
+        std::string line;
+        while (std::getline(input, line))
+        {
+            if (!execute(line)) ++failed;
+        }
+        return failed;
+    }
+
+    // Reads the whole workload first, then executes it back to back, timing
+    // each command. Parsing and file reading are not part of the measurement.
+    ReplayReport replay(std::istream& input)
+    {
+        std::vector<Command> workload;
+        std::string line;
+        Command command;
+        while (std::getline(input, line))
+        {
+            if (parse(line, command)) workload.push_back(command);
+        }
+
+        using Clock = std::chrono::steady_clock;
+        ReplayReport report;
+        auto start = Clock::now();
+        for (const Command& next : workload)
+        {
+            auto before = Clock::now();
+            bool ok = execute(next);
+            double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - before).count();
+
+            CommandStats& stats = report.byCommand[next.name];
+            stats.count++;
+            stats.latenciesNs.push_back(elapsed);
+            if (!ok)
+            {
+                stats.failed++;
+                report.failed++;
+            }
+        }
+        report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        report.commands = workload.size();
+        return report;
+    }
+};
+
+inline void CommandProcessor::ReplayReport::print(std::ostream& os) const
+{
+    auto rank = [](std::vector<double>& sorted, double p)
+    {
+        size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)] / 1000.0;
+    };
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%zu commands in %.3f s: %.0f commands/sec, %zu failed\n", commands, seconds, throughput(), failed);
+    os << line;
+    std::snprintf(line, sizeof(line), "%-24s | %-8s | %-6s | %-9s | %-9s | %-9s | %s\n", "command", "count", "failed", "p50 us", "p99 us", "p999 us", "max us");
+    os << line;
+    for (const auto& entry : byCommand)
+    {
+        std::vector<double> sorted = entry.second.latenciesNs;
+        std::sort(sorted.begin(), sorted.end());
+        std::snprintf(line, sizeof(line), "%-24s | %-8zu | %-6zu | %-9.1f | %-9.1f | %-9.1f | %.1f\n", entry.first.c_str(), entry.second.count, entry.second.failed,
+                      rank(sorted, 50), rank(sorted, 99), rank(sorted, 99.9), sorted.back() / 1000.0);
+        os << line;
+    }
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <iostream>
 #include "Transaction.h"
+#include "Tracing.h"
 #include "config.h"
 
 class CustomerExpenseTracker {
@@ -15,6 +16,7 @@ public:
     explicit CustomerExpenseTracker(UserId customerId) : customerId(customerId) {}
 
     void loadSpendingHistory(const std::vector<Transaction>& allTransactions) {
+        TRACE_SPAN("CustomerExpenseTracker::loadSpendingHistory");
         spendingHistory.clear();
         for (const auto& t : allTransactions) {
             if (t.getUserId() == customerId && (t.isSale() || t.isRefund())) {
@@ -96,13 +98,16 @@ public:
         std::cout << "Date       | Type    | Amount  | Description\n";
         std::cout << "--------------------------------------------\n";
         
+        // Reused from row to row
+        std::string timestamp, description;
         for (const auto& t : spendingHistory) {
-            std::string date = std::string(t.getTimestamp());
-            if (date.length() >= 10) date = date.substr(0, 10);
-            std::string type = t.isSale() ? "PURCHASE" : "REFUND";
+            formatTimestamp(t.getTimestampMicros(), timestamp);
+            description.clear();
+            t.appendDescription(description);
+            const char* type = t.isSale() ? "PURCHASE" : "REFUND";
             
-            printf("%-10s | %-7s | $%-6.2f | %s\n", 
-                   date.c_str(), type.c_str(), t.getAmount(), t.getDescription().c_str());
+            printf("%-10.10s | %-7s | $%-6.2f | %s\n", 
+                   timestamp.c_str(), type, t.getAmount(), description.c_str());
         }
     }
 
@@ -4,123 +4,169 @@
 #include <fstream>
 #include <functional>
 #include <stdexcept>
+#include <cstring>
 #include <iostream>
+#include <memory_resource>
 #include "Product.h"
 #include "User.h"
 #include "Order.h"
 #include "Transaction.h"
+#include "SalesAnalytics.h"
+#include "Metrics.h"
+#include "Tracing.h"
+#include "Logger.h"
 #include "config.h"
 
 class DataManager {
 public:
+    // Users and orders keep their strings in
+    // `arena` (an Arena, say), which must then outlive them; by default each
+    // gets its own heap allocations. Order items go in `orderItems`.
     static void loadSystemState(std::vector<Product>& products, std::vector<User>& users, 
-                               std::vector<Order>& orders, std::vector<Transaction>& transactions) {
-        std::cout << "Loading system state...\n";
+                               std::vector<Order>& orders, std::vector<Transaction>& transactions, OrderItemPool& orderItems,
+                               std::pmr::memory_resource* arena = std::pmr::get_default_resource()) {
+        LOG_INFO("data", "loading system state");
         loadProducts(products);
-        loadUsers(users);
-        loadOrders(orders);
+        loadUsers(users, arena);
+        loadOrders(orders, orderItems, arena);
         loadTransactions(transactions);
-        std::cout << "System state loaded successfully.\n";
+        LOG_INFO("data", "system state loaded");
     }
 
     static void saveSystemState(const std::vector<Product>& products, const std::vector<User>& users,
                                const std::vector<Order>& orders, const std::vector<Transaction>& transactions) {
-        std::cout << "Saving system state...\n";
+        LOG_INFO("data", "saving system state");
         saveProducts(products);
         saveUsers(users);
         saveOrders(orders);
         saveTransactions(transactions);
-        std::cout << "System state saved successfully.\n";
+        LOG_INFO("data", "system state saved");
     }
 
     static void loadProducts(std::vector<Product>& products) {
+        TIME_OPERATION(Operation::LOAD_PRODUCTS);
+        TRACE_SPAN("DataManager::loadProducts");
         products.clear();
         std::ifstream ifs(PRODUCT_FILE, std::ios::binary);
         if (!ifs.is_open()) {
-            std::cout << "Info: No existing product file found. Starting with empty inventory.\n";
+            LOG_INFO("data", "no product file, starting with an empty inventory");
             return;
         }
 
         try {
+            // Format 1 files predate the header and the string dictionary
+            StringDictionaryReader dictionary;
+            int format = readHeader(ifs, PRODUCT_MAGIC);
+            if (format > PRODUCT_FORMAT || (format > 1 && !dictionary.readFrom(ifs))) {
+                LOG_ERROR("data", "product file has an unknown format or a damaged dictionary");
+                return;
+            }
             while (ifs.peek() != EOF) {
                 Product p;
-                p.readFromStream(ifs);
+                p.readFromStream(ifs, format, dictionary);
                 if (ifs.good()) {
                     products.push_back(p);
                 }
             }
-            std::cout << "Loaded " << products.size() << " products.\n";
+            LOG_INFO("data", "loaded %zu products", products.size());
         } catch (const std::exception& e) {
-            std::cerr << "Error loading products: " << e.what() << "\n";
-            std::cerr << "Some products may not have been loaded. File might be corrupted.\n";
+            LOG_ERROR("data", "error loading products after %zu, the file may be corrupted: %s", products.size(), e.what());
         }
     }
 
     static void saveProducts(const std::vector<Product>& products) {
+        TIME_OPERATION(Operation::SAVE_PRODUCTS);
+        TRACE_SPAN("DataManager::saveProducts");
         atomicWrite(PRODUCT_FILE, [&](std::ofstream& ofs) {
+            StringDictionaryWriter dictionary;
+            for (const auto& p : products) {
+                p.addStrings(dictionary);
+            }
+            writeHeader(ofs, PRODUCT_MAGIC, PRODUCT_FORMAT);
+            dictionary.writeTo(ofs);
             for (const auto& p : products) {
-                p.writeToStream(ofs);
+                p.writeToStream(ofs, dictionary);
             }
         });
-        std::cout << "Saved " << products.size() << " products.\n";
+        LOG_INFO("data", "saved %zu products", products.size());
     }
 
-    static void loadUsers(std::vector<User>& users) {
+    static void loadUsers(std::vector<User>& users, std::pmr::memory_resource* arena = std::pmr::get_default_resource()) {
+        TIME_OPERATION(Operation::LOAD_USERS);
+        TRACE_SPAN("DataManager::loadUsers");
         users.clear();
         std::ifstream ifs(USER_FILE, std::ios::binary);
         if (!ifs.is_open()) {
-            std::cout << "Info: No existing user file found. Creating default admin user.\n";
             users.push_back(User(1, "admin", "admin123", UserType::ADMIN));
-            std::cout << "Default admin created (Username: admin, Password: admin123).\n";
+            LOG_INFO("data", "no user file, created the default admin account (admin/admin123)");
             return;
         }
 
         try {
+            int format = readHeader(ifs, USER_MAGIC);
+            if (format > USER_FORMAT) {
+                LOG_ERROR("data", "user file has an unknown format");
+                return;
+            }
+            if (format < USER_FORMAT) LOG_INFO("data", "user file is in format %d, it will be converted on the next save", format);
             while (ifs.peek() != EOF) {
-                User u;
-                u.readFromStream(ifs);
+                User u(arena);
+                u.readFromStream(ifs, format);
                 if (ifs.good()) {
-                    users.push_back(u);
+                    users.push_back(std::move(u));
                 }
             }
-            std::cout << "Loaded " << users.size() << " users.\n";
+            LOG_INFO("data", "loaded %zu users", users.size());
         } catch (const std::exception& e) {
-            std::cerr << "Error loading users: " << e.what() << "\n";
+            LOG_ERROR("data", "error loading users: %s", e.what());
         }
     }
 
     static void saveUsers(const std::vector<User>& users) {
+        TIME_OPERATION(Operation::SAVE_USERS);
+        TRACE_SPAN("DataManager::saveUsers");
         atomicWrite(USER_FILE, [&](std::ofstream& ofs) {
+            writeHeader(ofs, USER_MAGIC, USER_FORMAT);
             for (const auto& u : users) {
                 u.writeToStream(ofs);
             }
         });
-        std::cout << "Saved " << users.size() << " users.\n";
+        LOG_INFO("data", "saved %zu users", users.size());
     }
 
-    static void loadOrders(std::vector<Order>& orders) 
+    static void loadOrders(std::vector<Order>& orders, OrderItemPool& orderItems, std::pmr::memory_resource* arena = std::pmr::get_default_resource()) 
     {
+        TIME_OPERATION(Operation::LOAD_ORDERS);
+        TRACE_SPAN("DataManager::loadOrders");
         orders.clear();
         std::ifstream ifs(ORDER_FILE, std::ios::binary);
         if (!ifs.is_open()) 
         {
-            std::cout << "Info: No existing order file found.\n";
+            LOG_INFO("data", "no order file");
             return;
         }
 
         try 
         {
+            int format = readHeader(ifs, ORDER_MAGIC);
+            if (format > ORDER_FORMAT) 
+            {
+                LOG_ERROR("data", "order file has an unknown format");
+                return;
+            }
+            if (format < ORDER_FORMAT) LOG_INFO("data", "order file is in format %d, it will be converted on the next save", format);
             OrderId maxId = 0;
             while (ifs.peek() != EOF) 
             {
-                Order o = Order::readFromStream(ifs);
+                Order o = Order::readFromStream(ifs, format, orderItems, arena);
                 if (ifs.good()) 
                 {
-                    orders.push_back(o);
                     if (o.getId() > maxId) maxId = o.getId();
+                    orders.push_back(std::move(o));
                 }
             }
-            std::cout << "Loaded " << orders.size() << " orders.\n";
+            if (ifs.fail()) LOG_ERROR("data", "order file is damaged after %zu orders; the rest were not loaded", orders.size());
+            LOG_INFO("data", "loaded %zu orders", orders.size());
             // Set the next order ID to avoid collisions
             if (!orders.empty()) 
             {
@@ -129,60 +175,111 @@ public:
         } 
         catch (const std::exception& e) 
         {
-            std::cerr << "Error loading orders: " << e.what() << "\n";
+            LOG_ERROR("data", "error loading orders: %s", e.what());
         }
     }
 
     static void saveOrders(const std::vector<Order>& orders) 
     {
+        TIME_OPERATION(Operation::SAVE_ORDERS);
+        TRACE_SPAN("DataManager::saveOrders");
         atomicWrite(ORDER_FILE, [&](std::ofstream& ofs) 
         {
+            writeHeader(ofs, ORDER_MAGIC, ORDER_FORMAT);
             for (const auto& o : orders) 
             {
                 o.writeToStream(ofs);
             }
         });
-        std::cout << "Saved " << orders.size() << " orders.\n";
+        LOG_INFO("data", "saved %zu orders", orders.size());
     }
 
     static void loadTransactions(std::vector<Transaction>& transactions) 
     {
+        TIME_OPERATION(Operation::LOAD_TRANSACTIONS);
+        TRACE_SPAN("DataManager::loadTransactions");
         transactions.clear();
         std::ifstream ifs(TRANSACTION_FILE, std::ios::binary);
         if (!ifs.is_open()) 
         {
-            std::cout << "Info: No existing transaction file found.\n";
+            LOG_INFO("data", "no transaction file");
             return;
         }
 
         try 
         {
+            // Older formats are read as they are and rewritten in the current
+            // one by the next save
+            StringDictionaryReader dictionary;
+            int format = readHeader(ifs, TRANSACTION_MAGIC);
+            if (format > TRANSACTION_FORMAT || (format >= 3 && !dictionary.readFrom(ifs))) 
+            {
+                LOG_ERROR("data", "transaction file has an unknown format or a damaged dictionary");
+                return;
+            }
+            if (format < TRANSACTION_FORMAT) LOG_INFO("data", "transaction file is in format %d, it will be converted on the next save", format);
             while (ifs.peek() != EOF) 
             {
-                Transaction t = Transaction::readFromStream(ifs);
+                Transaction t = Transaction::readFromStream(ifs, format, dictionary);
                 if (ifs.good()) 
                 {
                     transactions.push_back(t);
                 }
             }
-            std::cout << "Loaded " << transactions.size() << " transactions.\n";
+            LOG_INFO("data", "loaded %zu transactions", transactions.size());
         } 
         catch (const std::exception& e) 
         {
-            std::cerr << "Error loading transactions: " << e.what() << "\n";
+            LOG_ERROR("data", "error loading transactions: %s", e.what());
         }
     }
 
     static void saveTransactions(const std::vector<Transaction>& transactions) 
     {
+        TIME_OPERATION(Operation::SAVE_TRANSACTIONS);
+        TRACE_SPAN("DataManager::saveTransactions");
         atomicWrite(TRANSACTION_FILE, [&](std::ofstream& ofs) 
         {
+            StringDictionaryWriter dictionary;
             for (const auto& t : transactions) 
             {
-                t.writeToStream(ofs);
+                t.addStrings(dictionary);
+            }
+            writeHeader(ofs, TRANSACTION_MAGIC, TRANSACTION_FORMAT);
+            dictionary.writeTo(ofs);
+            for (const auto& t : transactions) 
+            {
+                t.writeToStream(ofs, dictionary);
             }
         });
-        std::cout << "Saved " << transactions.size() << " transactions.\n";
+        LOG_INFO("data", "saved %zu transactions", transactions.size());
+    }
+
+    static void loadAnalytics(SalesAnalytics& analytics) 
+    {
+        TIME_OPERATION(Operation::LOAD_ANALYTICS);
+        TRACE_SPAN("DataManager::loadAnalytics");
+        std::ifstream ifs(ANALYTICS_FILE, std::ios::binary);
+        if (!ifs.is_open()) 
+        {
+            LOG_INFO("data", "no analytics file, sketches will be rebuilt from history");
+            return;
+        }
+
+        if (!analytics.readFromStream(ifs)) 
+        {
+            LOG_WARN("data", "analytics file is outdated or corrupted, sketches will be rebuilt from history");
+        }
+    }
+
+    static void saveAnalytics(const SalesAnalytics& analytics) 
+    {
+        TIME_OPERATION(Operation::SAVE_ANALYTICS);
+        TRACE_SPAN("DataManager::saveAnalytics");
+        atomicWrite(ANALYTICS_FILE, [&](std::ofstream& ofs) 
+        {
+            analytics.writeToStream(ofs);
+        });
     }
 
     static TransactionId getNextTransactionId(const std::vector<Transaction>& transactions) 
@@ -226,8 +323,38 @@ public:
     }
 
 private:
+    // Versioned files start with a 7-character magic and a format byte; files
+    // written before a format had a version start straight with records and
+    // count as format 1. Products and transactions also carry a dictionary of
+    // their interned strings (see StringDictionaryWriter) after the header.
+    static constexpr const char* PRODUCT_MAGIC = "ECPRODS";
+    static constexpr int PRODUCT_FORMAT = 2;
+    static constexpr const char* TRANSACTION_MAGIC = "ECTXLOG";
+    static constexpr int TRANSACTION_FORMAT = 3; // 2: epoch timestamps, 3: dictionary
+    static constexpr const char* USER_MAGIC = "ECUSERS";
+    static constexpr int USER_FORMAT = 2; // 2: no order ids, see OrderHistoryIndex
+    static constexpr const char* ORDER_MAGIC = "ECORDER";
+    static constexpr int ORDER_FORMAT = 2; // 2: one-byte OrderStatus
+
+    static void writeHeader(std::ostream& os, const char* magic, int format) 
+    {
+        os.write(magic, 7);
+        os.put(static_cast<char>(format));
+    }
+
+    // Consumes the header if there is one and returns the format it names
+    static int readHeader(std::istream& is, const char* magic) 
+    {
+        char header[8] = {};
+        if (is.read(header, sizeof(header)) && std::memcmp(header, magic, 7) == 0) return static_cast<unsigned char>(header[7]);
+        is.clear();
+        is.seekg(0);
+        return 1;
+    }
+
     static void atomicWrite(const std::string& filename, const std::function<void(std::ofstream&)>& writer) 
     {
+        TRACE_SPAN("DataManager::atomicWrite");
         std::string tempFile = filename + ".tmp";
         
         try 
@@ -260,7 +387,7 @@ private:
         catch (const std::exception& e) 
         {
             std::remove(tempFile.c_str());
-            std::cerr << "File operation error: " << e.what() << "\n";
+            LOG_ERROR("data", "file operation error: %s", e.what());
             throw;
         }
     }
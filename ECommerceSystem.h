@@ -2,17 +2,41 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <sstream>
+#include <iomanip>
 #include <memory>
 #include <algorithm>
-#include <cstdio>  
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdio>
+#include <chrono>
+#include <unordered_map>
+#include <span>
 #include "Product.h"
+#include "ProductCatalog.h"
+#include "ProductIndex.h"
+#include "ProductImport.h"
+#include "ColumnarFile.h"
+#include "CartHolds.h"
+#include "ShardedMap.h"
+#include "Arena.h"
 #include "User.h"
 #include "Order.h"
+#include "OrderHistory.h"
+#include "OrderStatusIndex.h"
 #include "Cart.h"
 #include "Transaction.h"
+#include "TransactionLog.h"
 #include "ExpenseTracker.h"
 #include "CustomerExpenseTracker.h"
+#include "SalesAnalytics.h"
+#include "Session.h"
 #include "DataManager.h"
+#include "Metrics.h"
+#include "Tracing.h"
 
 #ifdef _WIN32
 #include <direct.h>
@@ -22,114 +46,423 @@
 #define MKDIR(path) mkdir(path, 0755)
 #endif
 
-class ECommerceSystem 
+class CheckoutPipeline;
+
+// Shared, thread-safe store. All per-user state lives in the Session passed
+// to each operation, so many sessions can be served at the same time.
+class ECommerceSystem
 {
+    // Runs the checkout stages below asynchronously
+    friend class CheckoutPipeline;
+
 private:
-    std::vector<Product> products;
-    std::vector<User> users;
-    std::vector<Order> orders;
-    std::vector<Transaction> transactions;
-    
-    Cart cart;
-    UserId currentUserId;
-    
-    std::unique_ptr<ExpenseTracker> sellerTracker;
-    std::unique_ptr<CustomerExpenseTracker> customerTracker;
+    static constexpr size_t ANALYTICS_SHARDS = 16;
 
-public:
-    ECommerceSystem() : currentUserId(0) 
+    struct alignas(64) AnalyticsShard
     {
-        if (MKDIR("data") != 0 && errno != EEXIST) 
+        std::mutex mutex;
+        SalesAnalytics sketch;
+    };
+
+    ProductCatalog products;
+    ProductIndex productIndex{products};
+    CartHolds holds{products};
+    std::chrono::seconds cartHoldTtl{CART_HOLD_SECONDS};
+    // Holds the strings and vectors of the users and orders loaded at startup, so it comes before them
+    Arena loadArena;
+    ShardedMap<UserId, User> users;
+    ShardedMap<std::string, UserId, 16, StringKeyHash, std::equal_to<>> usernames;
+    // Holds the line items of every order, so it comes before them
+    OrderItemPool orderItems;
+    ShardedMap<OrderId, Order> orders;
+    OrderHistoryIndex histories;
+    OrderStatusIndex statuses;
+    TransactionLog transactions;
+    // Sketches are sharded by customer and merged when a report or save needs them
+    std::array<AnalyticsShard, ANALYTICS_SHARDS> analytics;
+
+    std::atomic<UserId> nextUserId;
+    std::atomic<ProductId> nextProductId;
+    std::atomic<TransactionId> nextTransactionId;
+
+    std::mutex persistMutex;
+    bool autoSave;
+
+    // Expires cart holds once a CartHolds tick, so the stock of carts that
+    // went quiet comes back even while no one else uses the store
+    std::mutex sweepMutex;
+    std::condition_variable sweepWake;
+    bool sweepStopping = false;
+    std::thread holdSweeper;
+
+    static constexpr int MAX_CHECKOUT_ATTEMPTS = 5; // quotes a customer gets before a checkout gives up on moving prices
+
+    struct ReservedLine
+    {
+        double price;
+        StringId name;
+        StringId category;
+        int fromHold; // units that came from the customer's cart hold
+    };
+
+    bool holdsEnabled() const
+    {
+        return cartHoldTtl.count() > 0;
+    }
+
+    void sweepHolds()
+    {
+        std::unique_lock<std::mutex> lock(sweepMutex);
+        while (!sweepWake.wait_for(lock, std::chrono::milliseconds(CartHolds::TICK_MS), [this] { return sweepStopping; }))
         {
-            std::cerr << "Warning: Could not create data directory. Please create it manually.\n";
+            lock.unlock();
+            holds.expire();
+            lock.lock();
         }
-        
-        DataManager::loadSystemState(products, users, orders, transactions);
-        initializeTrackers();
     }
 
-    bool login(const std::string& username, const std::string& password) 
+    // Undoes a reservation line by line: units that came from the customer's
+    // holds are held again, the rest go back on sale
+    void releaseStock(UserId customerId, const std::vector<CartItem>& items, const std::vector<ReservedLine>& lines)
     {
-        for (const auto& user : users) 
+        for (size_t i = 0; i < lines.size(); ++i)
         {
-            if (user.getUsername() == username && user.authenticate(password)) 
+            int fromStock = items[i].quantity - lines[i].fromHold;
+            int fromHold = lines[i].fromHold;
+            products.modifyConcurrent(items[i].productId, [&](ProductRef& p)
             {
-                currentUserId = user.getId();
-                initializeTrackers();
-                std::cout << "Welcome back, " << username << "! (ID: " << currentUserId << ")\n";
-                return true;
+                p.release(fromStock);
+                holds.reinstate(customerId, p, fromHold, cartHoldTtl);
+            });
+        }
+    }
+
+    enum class ReserveResult { RESERVED, OUT_OF_STOCK, PRICE_CHANGED };
+
+    // The cart's total at current prices, with the price version of each
+    // line's product in `versions` (see Product::readPrice). Nothing is
+    // reserved.
+    double quoteCart(const std::vector<CartItem>& items, std::vector<uint64_t>& versions) const
+    {
+        TRACE_SPAN("ECommerceSystem::quoteCart");
+        double total = 0.0;
+        versions.assign(items.size(), 0);
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            double price = 0.0;
+            products.read(items[i].productId, [&price, &versions, i](const ProductRef& p) { price = p.readPrice(versions[i]); });
+            total += price * items[i].quantity;
+        }
+        return total;
+    }
+
+    // Checkout in one pass over the cart. Each line's product is looked up
+    // once, and through that lookup the customer's held units are taken, the
+    // rest is reserved from stock with a compare-and-swap (no lock), and the
+    // price, name and category the order and its sales need are read. `total`
+    // adds up the prices the stock was taken at, so it is what the order
+    // charges. With `quoted` (versions from quoteCart), a line whose product
+    // was repriced since the quote fails the checkout: optimistic concurrency,
+    // so repricing never waits for checkouts and a checkout never charges a
+    // price other than the one quoted. All or nothing: if a line is unknown, comes up
+    // short or was repriced, the lines already taken are handed back.
+    ReserveResult reserveCart(UserId customerId, const std::vector<CartItem>& items, const std::vector<uint64_t>* quoted, std::vector<ReservedLine>& lines, double& total)
+    {
+        TRACE_SPAN("ECommerceSystem::reserveCart");
+        holds.expire();
+        lines.clear();
+        lines.reserve(items.size());
+        total = 0.0;
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            const CartItem& item = items[i];
+            ReservedLine line{0.0, 0, 0, 0};
+            bool current = true;
+            bool reserved = false;
+            products.modifyConcurrent(item.productId, [&](ProductRef& p)
+            {
+                uint64_t version = 0;
+                line.price = p.readPrice(version);
+                current = !quoted || version == (*quoted)[i];
+                if (!current) return;
+                line.fromHold = holdsEnabled() ? holds.take(customerId, p, item.quantity) : 0;
+                reserved = line.fromHold == item.quantity || p.tryReserve(item.quantity - line.fromHold);
+                if (!reserved)
+                {
+                    holds.reinstate(customerId, p, line.fromHold, cartHoldTtl);
+                    return;
+                }
+                line.name = p.getNameId();
+                line.category = p.getCategoryId();
+            });
+
+            if (!reserved)
+            {
+                LOG_DEBUG("checkout", "could not reserve %d of product %d for customer %d%s", item.quantity, item.productId, customerId,
+                          current ? "" : ": repriced since the quote");
+                releaseStock(customerId, items, lines);
+                lines.clear();
+                return current ? ReserveResult::OUT_OF_STOCK : ReserveResult::PRICE_CHANGED;
+            }
+            total += line.price * item.quantity;
+            lines.push_back(line);
+        }
+        return ReserveResult::RESERVED;
+    }
+
+    // Record stage of a checkout: turns reserved lines into an order with its
+    // sales, updates analytics and the customer, and empties the cart
+    OrderId recordOrder(Session& session, const std::vector<ReservedLine>& lines, double total)
+    {
+        TRACE_SPAN("ECommerceSystem::recordOrder");
+        const UserId customerId = session.getUserId();
+        Cart& cart = session.getCart();
+        const std::vector<CartItem>& items = cart.getItems();
+        Order newOrder(orderItems, customerId, items, total);
+        AnalyticsShard& sketchShard = analytics[static_cast<size_t>(customerId) % ANALYTICS_SHARDS];
+
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            TRACE_SPAN("ECommerceSystem::recordSale");
+            const CartItem& item = items[i];
+            const ReservedLine& line = lines[i];
+            Transaction sale = Transaction::purchase(nextTransactionId++, customerId, item.productId, line.price * item.quantity, line.name);
+            transactions.append(sale);
+            {
+                std::lock_guard<std::mutex> lock(sketchShard.mutex);
+                sketchShard.sketch.observeSale(sale, internedText(line.category));
+            }
+
+            if (session.getCustomerTracker())
+            {
+                session.getCustomerTracker()->addPurchase(sale);
             }
         }
+
+        // Indexed before it can be found, so a status change always finds it in the index
+        statuses.add(newOrder.getId(), newOrder.getStatus());
+        orders.insert(newOrder.getId(), newOrder);
+        {
+            std::lock_guard<std::mutex> lock(sketchShard.mutex);
+            sketchShard.sketch.observeOrder(newOrder);
+        }
+
+        histories.append(customerId, newOrder.getId());
+        session.setLastOrderId(newOrder.getId());
+        std::cout << "Order #" << newOrder.getId() << " placed successfully!\n";
+
+        cart.clear();
+        return newOrder.getId();
+    }
+
+    void persist()
+    {
+        if (autoSave) saveAllData();
+    }
+
+    SalesAnalytics mergedAnalytics()
+    {
+        SalesAnalytics merged;
+        for (auto& shard : analytics)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            merged.merge(shard.sketch);
+        }
+        return merged;
+    }
+
+public:
+    // One order of a batch, see placeOrders
+    struct OrderRequest
+    {
+        UserId customerId;
+        std::vector<CartItem> items;
+    };
+
+    enum class OrderOutcome { PLACED, UNKNOWN_CUSTOMER, INVALID_ITEMS, UNKNOWN_PRODUCT, OUT_OF_STOCK };
+
+    struct OrderResult
+    {
+        OrderOutcome outcome;
+        OrderId orderId; // 0 unless placed
+        double total;
+    };
+
+    // With autoSave off nothing is written until saveAllData() or destruction
+    explicit ECommerceSystem(bool autoSave = true) : nextUserId(1), nextProductId(1), nextTransactionId(1), autoSave(autoSave)
+    {
+        if (MKDIR("data") != 0 && errno != EEXIST)
+        {
+            std::cerr << "Warning: Could not create data directory. Please create it manually.\n";
+        }
+
+        std::vector<Product> loadedProducts;
+        std::vector<User> loadedUsers;
+        std::vector<Order> loadedOrders;
+        std::vector<Transaction> loadedTransactions;
+        DataManager::loadSystemState(loadedProducts, loadedUsers, loadedOrders, loadedTransactions, orderItems, &loadArena);
+
+        nextUserId = DataManager::getNextUserId(loadedUsers);
+        nextProductId = DataManager::getNextProductId(loadedProducts);
+        nextTransactionId = DataManager::getNextTransactionId(loadedTransactions);
+        Order::setNextId(DataManager::getNextOrderId(loadedOrders));
+
+        DataManager::loadAnalytics(analytics[0].sketch);
+        analytics[0].sketch.catchUp(loadedTransactions, loadedOrders, loadedProducts);
+        histories.build(loadedOrders);
+        statuses.build(loadedOrders);
+
+        // Moving keeps each record's data where it is, in loadArena
+        products.insertBatch(loadedProducts);
+        for (auto& u : loadedUsers)
+        {
+            usernames.insert(std::string(u.getUsername()), u.getId());
+            users.insert(u.getId(), std::move(u));
+        }
+        for (auto& o : loadedOrders) orders.insert(o.getId(), std::move(o));
+        transactions.load(loadedTransactions);
+
+        holdSweeper = std::thread([this] { sweepHolds(); });
+    }
+
+    // Checks a username and password without touching any session; allocates
+    // nothing. Returns the user's id, or 0 if the credentials do not match.
+    UserId authenticate(std::string_view username, std::string_view password, UserType& type) const
+    {
+        UserId userId = 0;
+        usernames.read(username, [&userId](UserId id) { userId = id; });
+
+        bool authenticated = false;
+        users.read(userId, [&](const User& user)
+        {
+            authenticated = user.authenticate(password);
+            type = user.getType();
+        });
+        return authenticated ? userId : 0;
+    }
+
+    bool login(Session& session, const std::string& username, const std::string& password)
+    {
+        TIME_OPERATION(Operation::LOGIN);
+        UserType type = UserType::CUSTOMER;
+        const UserId userId = authenticate(username, password, type);
+
+        if (userId != 0)
+        {
+            session.begin(userId, username, type);
+            initializeTrackers(session);
+            std::cout << "Welcome back, " << username << "! (ID: " << userId << ")\n";
+            return true;
+        }
         std::cout << "Invalid username or password. Please try again.\n";
         return false;
     }
 
-    bool registerUser(const std::string& username, const std::string& password, UserType type) 
+    bool registerUser(const std::string& username, const std::string& password, UserType type)
     {
-        if (username.empty() || password.empty()) 
+        TIME_OPERATION(Operation::REGISTER_USER);
+        if (username.empty() || password.empty())
         {
             std::cout << "Username and password cannot be empty.\n";
             return false;
         }
 
-        for (const auto& user : users) 
+        UserId newId = nextUserId++;
+        if (!usernames.insert(username, newId))
         {
-            if (user.getUsername() == username) 
-            {
-                std::cout << "Username already exists. Please choose another.\n";
-                return false;
-            }
+            std::cout << "Username already exists. Please choose another.\n";
+            return false;
         }
+        users.insert(newId, User(newId, username, password, type));
 
-        UserId newId = DataManager::getNextUserId(users);
-        users.emplace_back(newId, username, password, type);
-        
-        saveAllData();
+        persist();
         std::cout << "Registration successful! Your user ID is " << newId << ". You can now log in.\n";
         return true;
     }
 
-    void logout() 
+    void logout(Session& session)
     {
-        if (isLoggedIn()) 
+        TIME_OPERATION(Operation::LOGOUT);
+        if (session.isLoggedIn())
         {
-            std::cout << "Goodbye, " << getCurrentUser().getUsername() << "! Logging out...\n";
-            saveCart();
+            std::cout << "Goodbye, " << session.getUsername() << "! Logging out...\n";
+            saveCart(session);
         }
-        currentUserId = 0;
-        sellerTracker.reset();
-        customerTracker.reset();
-        cart = Cart();
+        session.end();
+    }
+
+    // One sorted page of the catalog, see ProductIndex. False if the cursor
+    // does not belong to this sort order.
+    bool getProductPage(ProductSort sort, bool reverse, std::string_view cursor, size_t limit, ProductPage& page)
+    {
+        TIME_OPERATION(Operation::BROWSE_PRODUCTS);
+        return productIndex.page(sort, reverse, cursor, std::max<size_t>(1, limit), page);
     }
 
-    void browseProducts() const 
+    // Prints one page of the catalog; `nextCursor` is left empty after the last
+    // page. False if the cursor is not valid for this listing.
+    bool browseProducts(ProductSort sort, bool reverse, const std::string& cursor, std::string& nextCursor)
     {
-        std::cout << "\n=== AVAILABLE PRODUCTS ===\n";
-        if (products.empty()) 
+        nextCursor.clear();
+        std::cout << "\n=== AVAILABLE PRODUCTS (by " << ProductIndex::sortName(sort) << (reverse ? ", reversed" : "") << ") ===\n";
+        ProductPage page;
+        if (!getProductPage(sort, reverse, cursor, BROWSE_PAGE_SIZE, page))
         {
-            std::cout << "No products available in the catalog.\n";
-            return;
+            std::cout << "That page cursor is not valid for this listing.\n";
+            return false;
+        }
+        if (page.products.empty())
+        {
+            std::cout << (cursor.empty() ? "No products available in the catalog.\n" : "No more products.\n");
+            return true;
         }
 
         std::cout << "ID  | Name                           | Price   | Stock | Category         | Seller\n";
         std::cout << "--------------------------------------------------------------------------------\n";
-        for (const auto& product : products) 
+        for (const Product& product : page.products)
         {
-            printf("%-3d | %-30s | $%-6.2f | %-5d | %-16s | %d\n",
-                   product.getId(), 
-                   product.getName().substr(0, 30).c_str(),
+            const std::string_view name = product.getName().substr(0, 30), category = product.getCategory().substr(0, 16);
+            printf("%-3d | %-30.*s | $%-6.2f | %-5d | %-16.*s | %d\n",
+                   product.getId(),
+                   static_cast<int>(name.size()), name.data(),
                    product.getPrice(),
                    product.getStock(),
-                   product.getCategory().substr(0, 16).c_str(),
+                   static_cast<int>(category.size()), category.data(),
                    product.getSellerId());
         }
         std::cout << "--------------------------------------------------------------------------------\n";
-        std::cout << "Total products: " << products.size() << "\n";
+        std::cout << "Showing " << page.products.size() << " of " << products.size() << " products.";
+        if (!page.nextCursor.empty()) std::cout << " Next page: " << page.nextCursor;
+        std::cout << "\n";
+        nextCursor = page.nextCursor;
+        return true;
     }
 
-    void searchProducts(const std::string& query) const 
+    // Calls f(const ProductRef&) for each product whose name or category
+    // contains `query`, ignoring case; allocates nothing
+    template <typename F>
+    void findProducts(std::string_view query, F&& f) const
     {
-        if (query.empty()) 
+        TIME_OPERATION(Operation::SEARCH_PRODUCTS);
+        products.forEach([&](ProductId, const ProductRef& product)
+        {
+            if (containsIgnoreCase(product.getName(), query) || containsIgnoreCase(product.getCategory(), query))
+            {
+                f(product);
+            }
+        });
+    }
+
+    std::vector<Product> findProducts(std::string_view query) const
+    {
+        std::vector<Product> matches;
+        findProducts(query, [&matches](const ProductRef& product) { matches.emplace_back(product); });
+        return matches;
+    }
+
+    void searchProducts(std::string_view query) const
+    {
+        if (query.empty())
         {
             std::cout << "Search query cannot be empty.\n";
             return;
@@ -137,458 +470,1062 @@ public:
 
         std::cout << "\n=== SEARCH RESULTS FOR '" << query << "' ===\n";
         bool found = false;
-        std::string queryLower = query;
-        std::transform(queryLower.begin(), queryLower.end(), queryLower.begin(), ::tolower);
-        
-        for (const auto& product : products) 
-        {
-            std::string nameLower = product.getName();
-            std::string categoryLower = product.getCategory();
-            std::transform(nameLower.begin(), nameLower.end(), nameLower.begin(), ::tolower);
-            std::transform(categoryLower.begin(), categoryLower.end(), categoryLower.begin(), ::tolower);            
-            if (nameLower.find(queryLower) != std::string::npos || categoryLower.find(queryLower) != std::string::npos) 
-            {
-                product.display();
-                found = true;
-            }
-        }
-        
-        if (!found) 
+        findProducts(query, [&found](const ProductRef& product)
+        {
+            product.display();
+            found = true;
+        });
+
+        if (!found)
         {
             std::cout << "No products found matching your search.\n";
         }
     }
 
-    void addToCart(ProductId productId, int quantity) 
+    // Visits every product in id order without copying the catalog
+    template <typename F>
+    void forEachProduct(F&& f) const
+    {
+        products.forEach([&f](ProductId, const ProductRef& product) { f(product); });
+    }
+
+    template <typename F>
+    bool readProduct(ProductId productId, F&& f) const
+    {
+        return products.read(productId, std::forward<F>(f));
+    }
+
+    bool addToCart(Session& session, ProductId productId, int quantity)
     {
-        if (!isLoggedIn()) 
+        TIME_OPERATION(Operation::ADD_TO_CART);
+        if (!session.isLoggedIn())
         {
             std::cout << "Please log in to add items to cart.\n";
-            return;
+            return false;
         }
 
-        if (cart.addItem(productId, quantity, products)) 
+        holds.expire();
+        const UserId userId = session.getUserId();
+        bool holding = holdsEnabled() && holds.hold(userId, productId, quantity, cartHoldTtl);
+        int held = holdsEnabled() ? holds.heldQuantity(userId, productId) : 0;
+
+        if (session.getCart().addItem(productId, quantity, products, held))
         {
             std::cout << "Added to cart successfully!\n";
-            saveCart();
-        } else 
+            saveCart(session);
+            return true;
+        } else
         {
+            if (holding) holds.release(userId, productId, quantity);
             std::cout << "Failed to add item to cart.\n";
+            return false;
         }
     }
 
-    void viewCart() const 
+    void viewCart(const Session& session) const
     {
-        if (!isLoggedIn()) 
+        TIME_OPERATION(Operation::VIEW_CART);
+        if (!session.isLoggedIn())
         {
             std::cout << "Please log in to view your cart.\n";
             return;
         }
-        cart.display(products);
+        session.getCart().display(products);
     }
 
-    void removeFromCart(ProductId productId) 
+    void removeFromCart(Session& session, ProductId productId)
     {
-        if (!isLoggedIn()) 
+        TIME_OPERATION(Operation::REMOVE_FROM_CART);
+        if (!session.isLoggedIn())
         {
             std::cout << "Please log in to modify your cart.\n";
             return;
         }
 
-        if (cart.removeItem(productId)) 
+        if (session.getCart().removeItem(productId))
         {
+            holds.release(session.getUserId(), productId);
             std::cout << "Item removed from cart.\n";
-            saveCart();
+            saveCart(session);
         }
-        else 
+        else
         {
             std::cout << "Item not found in cart.\n";
         }
     }
 
-    void clearCart() 
+    void clearCart(Session& session)
     {
-        if (!isLoggedIn()) 
+        TIME_OPERATION(Operation::CLEAR_CART);
+        if (!session.isLoggedIn())
         {
             std::cout << "Please log in to modify your cart.\n";
             return;
         }
-        
-        if (!cart.isEmpty()) 
+
+        if (!session.getCart().isEmpty())
         {
-            char confirm;
-            std::cout << "Are you sure you want to clear your cart? (y/N): ";
-            std::cin >> confirm;
-            std::cin.ignore();
-            if (confirm == 'y' || confirm == 'Y') 
+            if (session.ask("Are you sure you want to clear your cart?"))
             {
-                cart.clear();
-                saveCart();
-            } 
-            else 
+                for (const CartItem& item : session.getCart().getItems())
+                {
+                    holds.release(session.getUserId(), item.productId);
+                }
+                session.getCart().clear();
+                saveCart(session);
+                std::cout << "Cart cleared successfully.\n";
+            }
+            else
             {
                 std::cout << "Clear cart cancelled.\n";
             }
-        } 
-        else 
+        }
+        else
         {
             std::cout << "Your cart is already empty.\n";
         }
     }
 
-    bool placeOrder() 
+    bool placeOrder(Session& session)
     {
-        if (!isLoggedIn()) 
+        TIME_OPERATION(Operation::PLACE_ORDER);
+        TRACE_SPAN("ECommerceSystem::placeOrder");
+        if (!session.isLoggedIn())
         {
             std::cout << "Please log in to place an order.\n";
             return false;
         }
 
-        if (cart.isEmpty()) 
+        Cart& cart = session.getCart();
+        if (cart.isEmpty())
         {
             std::cout << "Your cart is empty. Add some items first!\n";
             return false;
         }
-
-        if (!cart.validateStock(products)) 
+        if (cart.getItemCount() > MAX_CART_ITEMS)
         {
-            std::cout << "Some items in your cart exceed available stock. Please update your cart.\n";
+            std::cout << "An order can have at most " << MAX_CART_ITEMS << " different products. Please remove some from your cart.\n";
             return false;
         }
 
-        double total = cart.calculateTotal(products);
-        std::cout << "Order total: $" << total << "\n";
-        char confirm;
-        std::cout << "Confirm order placement? (y/N): ";
-        std::cin >> confirm;
-        std::cin.ignore();
-        if (confirm != 'y' && confirm != 'Y') 
+        // Nothing is reserved while the customer is asked, so an open prompt
+        // keeps no stock from anyone else. The reservation then checks every
+        // line's price version against the quote, so the total confirmed is
+        // the one charged; a repricing in between costs a retry.
+        const UserId customerId = session.getUserId();
+        const std::vector<CartItem>& items = cart.getItems();
+        std::vector<uint64_t> quoted;
+        std::vector<ReservedLine> lines;
+        double total = 0.0;
+        double confirmedTotal = -1.0;
+        for (int attempt = 1; ; ++attempt)
         {
-            std::cout << "Order cancelled.\n";
-            return false;
+            Metrics::instance().add(Counter::CHECKOUT_ATTEMPTS);
+            const double quote = quoteCart(items, quoted);
+            if (quote != confirmedTotal)
+            {
+                std::cout << (confirmedTotal < 0 ? "Order total: $" : "Prices changed. New order total: $") << quote << "\n";
+                if (!session.ask("Confirm order placement?"))
+                {
+                    std::cout << "Order cancelled.\n";
+                    return false;
+                }
+                confirmedTotal = quote;
+            }
+
+            ReserveResult result = reserveCart(customerId, items, &quoted, lines, total);
+            if (result == ReserveResult::RESERVED)
+            {
+                break;
+            }
+            if (result == ReserveResult::OUT_OF_STOCK)
+            {
+                std::cout << "Some items in your cart exceed available stock. Nothing was charged; please update your cart.\n";
+                return false;
+            }
+
+            Metrics::instance().add(Counter::CHECKOUT_CONFLICTS);
+            if (attempt >= MAX_CHECKOUT_ATTEMPTS)
+            {
+                Metrics::instance().add(Counter::CHECKOUT_ABANDONED);
+                std::cout << "Prices are changing too quickly right now. Nothing was charged; please try again.\n";
+                return false;
+            }
+            Metrics::instance().add(Counter::CHECKOUT_RETRIES);
         }
+        Metrics::instance().add(Counter::CHECKOUT_COMMITTED);
 
-        TransactionId nextTransId = DataManager::getNextTransactionId(transactions);
-        OrderId nextOrderId = DataManager::getNextOrderId(orders);
-        
-        Order newOrder(currentUserId, cart.getItems(), total);
-        newOrder.setId(nextOrderId);
-        orders.push_back(newOrder);
+        recordOrder(session, lines, total);
+        persist();
+        saveCart(session);
 
-        std::vector<UserId> sellerIdsToUpdate;
+        return true;
+    }
+
+    // Places many orders at once, for imports and replaying order backlogs. No
+    // prompts; each request gets its own result in `requests` order, and an
+    // order is placed only if all of its lines can be filled.
+    //
+    // The batch is handled as a whole rather than order by order: each product
+    // is looked up once and its total demand claimed in a single sorted pass,
+    // orders are then filled from the claimed units in request order and what
+    // is left is handed back. Order and transaction ids are taken as contiguous
+    // blocks, and the data is persisted once.
+    std::vector<OrderResult> placeOrders(const Session& session, std::span<const OrderRequest> requests)
+    {
+        TIME_OPERATION(Operation::PLACE_ORDERS);
+        if (!session.isAdmin())
+        {
+            std::cout << "Only administrators can import orders.\n";
+            return {};
+        }
 
-        for (const auto& item : cart.getItems()) 
+        std::vector<OrderResult> results(requests.size(), OrderResult{ OrderOutcome::PLACED, 0, 0.0 });
+
+        // Customers: one lookup each, however many orders they have in the batch
+        std::unordered_map<UserId, bool> customers;
+        for (size_t r = 0; r < requests.size(); ++r)
         {
-            auto productIt = std::find_if(products.begin(), products.end(),
-                [item](const Product& p) { return p.getId() == item.productId; });
-            
-            if (productIt != products.end()) 
+            const OrderRequest& request = requests[r];
+            auto known = customers.find(request.customerId);
+            if (known == customers.end())
             {
-                Transaction sale(nextTransId++, currentUserId, item.productId, productIt->getPrice() * item.quantity, TransactionType::SALE, "Purchase: " + productIt->getName());
-                transactions.push_back(sale);
+                bool isCustomer = false;
+                users.read(request.customerId, [&isCustomer](const User& user) { isCustomer = user.getType() == UserType::CUSTOMER; });
+                known = customers.emplace(request.customerId, isCustomer).first;
+            }
 
-                if (customerTracker) 
-                {
-                    customerTracker->addPurchase(sale);
-                }
+            if (!known->second)
+            {
+                results[r].outcome = OrderOutcome::UNKNOWN_CUSTOMER;
+            }
+            else if (request.items.empty() || request.items.size() > static_cast<size_t>(MAX_CART_ITEMS) ||
+                     std::any_of(request.items.begin(), request.items.end(), [](const CartItem& item) { return item.quantity <= 0; }))
+            {
+                results[r].outcome = OrderOutcome::INVALID_ITEMS;
+            }
+        }
+
+        // Distinct products in id order, and each line's position among them
+        std::vector<ProductId> ids;
+        for (size_t r = 0; r < requests.size(); ++r)
+        {
+            if (results[r].outcome != OrderOutcome::PLACED) continue;
+            for (const CartItem& item : requests[r].items) ids.push_back(item.productId);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        std::vector<size_t> lineSlots;
+        std::vector<int> demand(ids.size(), 0);
+        for (size_t r = 0; r < requests.size(); ++r)
+        {
+            if (results[r].outcome != OrderOutcome::PLACED) continue;
+            for (const CartItem& item : requests[r].items)
+            {
+                size_t slot = static_cast<size_t>(std::lower_bound(ids.begin(), ids.end(), item.productId) - ids.begin());
+                lineSlots.push_back(slot);
+                demand[slot] += item.quantity;
+            }
+        }
+
+        // Claim each product's demand (or whatever is left of it) in one pass
+        std::vector<bool> exists(ids.size(), false);
+        std::vector<int> remaining(ids.size(), 0);
+        std::vector<double> prices(ids.size(), 0.0);
+        std::vector<StringId> names(ids.size());
+        std::vector<StringId> categories(ids.size());
+        products.modifyBatch(ids, [&](size_t i, ProductRef* p)
+        {
+            if (!p) return;
+            exists[i] = true;
+            prices[i] = p->getPrice();
+            names[i] = p->getNameId();
+            categories[i] = p->getCategoryId();
+            remaining[i] = p->takeUpTo(demand[i]);
+        });
+
+        // Fill orders in request order from the claimed units
+        size_t placedCount = 0;
+        size_t saleCount = 0;
+        size_t line = 0;
+        for (size_t r = 0; r < requests.size(); ++r)
+        {
+            if (results[r].outcome != OrderOutcome::PLACED) continue;
+            const std::vector<CartItem>& items = requests[r].items;
+            const size_t first = line;
+            line += items.size();
 
-                // Update seller tracker for the product's owner
-                UserId sellerId = productIt->getSellerId();
-                bool sellerTrackerFound = false;
-                for (auto& user : users) 
+            OrderOutcome outcome = OrderOutcome::PLACED;
+            size_t filled = 0;
+            double total = 0.0;
+            for (; filled < items.size(); ++filled)
+            {
+                size_t slot = lineSlots[first + filled];
+                if (!exists[slot])
                 {
-                    if (user.getId() == sellerId && user.isSeller()) 
-                    {
-                        sellerIdsToUpdate.push_back(sellerId);
-                        sellerTrackerFound = true;
-                        break;
-                    }
+                    outcome = OrderOutcome::UNKNOWN_PRODUCT;
+                    break;
                 }
-                
-                if (sellerTrackerFound) 
+                if (remaining[slot] < items[filled].quantity)
                 {
-                    // We need to update the seller's tracker
-                    ExpenseTracker tempTracker(sellerId);
-                    tempTracker.loadTransactions(transactions);
-                    tempTracker.addSale(sale);
-                    // Save the seller's transactions (simplified - in production use a map of trackers)
+                    outcome = OrderOutcome::OUT_OF_STOCK;
+                    break;
                 }
+                remaining[slot] -= items[filled].quantity;
+                total += prices[slot] * items[filled].quantity;
+            }
+
+            if (outcome != OrderOutcome::PLACED)
+            {
+                for (size_t i = 0; i < filled; ++i) remaining[lineSlots[first + i]] += items[i].quantity;
+                results[r].outcome = outcome;
+                continue;
+            }
+            results[r].total = total;
+            placedCount++;
+            saleCount += items.size();
+        }
+
+        products.modifyBatch(ids, [&remaining](size_t i, ProductRef* p)
+        {
+            if (p && remaining[i] > 0) p->release(remaining[i]);
+        });
+
+        if (placedCount == 0)
+        {
+            std::cout << "Batch: 0 of " << requests.size() << " orders placed.\n";
+            return results;
+        }
+
+        // Ids in contiguous blocks, one timestamp for the whole batch
+        OrderId nextOrder = Order::reserveIds(static_cast<int>(placedCount));
+        TransactionId nextSale = nextTransactionId.fetch_add(static_cast<TransactionId>(saleCount));
+        const int64_t now = CoarseClock::nowMicros();
+        const std::string timestamp = formatTimestamp(now);
 
-                // Update product stock
-                productIt->reduceStock(item.quantity);
+        std::vector<Transaction> sales;
+        std::vector<size_t> saleSlots; // product slot of each sale
+        std::vector<size_t> saleStarts; // first sale of each placed order
+        std::vector<Order> placed;
+        std::array<std::vector<size_t>, ANALYTICS_SHARDS> byShard; // placed orders per analytics shard
+        sales.reserve(saleCount);
+        saleSlots.reserve(saleCount);
+        saleStarts.reserve(placedCount + 1);
+        placed.reserve(placedCount);
+        line = 0;
+        for (size_t r = 0; r < requests.size(); ++r)
+        {
+            const OrderRequest& request = requests[r];
+            const size_t first = line;
+            if (results[r].outcome == OrderOutcome::UNKNOWN_CUSTOMER || results[r].outcome == OrderOutcome::INVALID_ITEMS) continue;
+            line += request.items.size();
+            if (results[r].outcome != OrderOutcome::PLACED) continue;
+
+            results[r].orderId = nextOrder++;
+            byShard[static_cast<size_t>(request.customerId) % ANALYTICS_SHARDS].push_back(placed.size());
+            saleStarts.push_back(sales.size());
+            for (size_t i = 0; i < request.items.size(); ++i)
+            {
+                const CartItem& item = request.items[i];
+                size_t slot = lineSlots[first + i];
+                saleSlots.push_back(slot);
+                sales.push_back(Transaction::purchase(nextSale++, request.customerId, item.productId, prices[slot] * item.quantity, names[slot], now));
             }
+            placed.emplace_back(orderItems, results[r].orderId, request.customerId, request.items, results[r].total, timestamp);
         }
+        saleStarts.push_back(sales.size());
 
-        for (auto& user : users) 
+        for (size_t shard = 0; shard < ANALYTICS_SHARDS; ++shard)
         {
-            if (user.getId() == currentUserId) 
+            if (byShard[shard].empty()) continue;
+            std::lock_guard<std::mutex> lock(analytics[shard].mutex);
+            for (size_t o : byShard[shard])
             {
-                user.addOrder(newOrder.getId());
-                std::cout << "Order #" << newOrder.getId() << " placed successfully!\n";
-                break;
+                for (size_t t = saleStarts[o]; t < saleStarts[o + 1]; ++t)
+                {
+                    analytics[shard].sketch.observeSale(sales[t], internedText(categories[saleSlots[t]]));
+                }
+                analytics[shard].sketch.observeOrder(placed[o]);
             }
         }
 
-        cart.clear();
-        saveAllData();
-        
-        return true;
+        for (const Order& order : placed)
+        {
+            histories.append(order.getUserId(), order.getId());
+            statuses.add(order.getId(), order.getStatus());
+            orders.insert(order.getId(), order);
+        }
+        transactions.appendBatch(std::move(sales));
+
+        persist();
+        std::cout << "Batch: " << placedCount << " of " << requests.size() << " orders placed.\n";
+        return results;
     }
 
-    void viewOrderHistory() const 
+    template <typename F>
+    bool readOrder(OrderId orderId, F&& f) const
     {
-        if (!isLoggedIn()) 
+        return orders.read(orderId, std::forward<F>(f));
+    }
+
+    // The logged-in user's orders, oldest first
+    std::vector<Order> getOrderHistory(const Session& session) const
+    {
+        std::vector<OrderId> history;
+        histories.read(session.getUserId(), [&history](std::span<const OrderId> orderIds) { history.assign(orderIds.begin(), orderIds.end()); });
+
+        std::vector<Order> result;
+        result.reserve(history.size());
+        for (OrderId orderId : history)
+        {
+            orders.read(orderId, [&result](const Order& o) { result.push_back(o); });
+        }
+        return result;
+    }
+
+    void viewOrderHistory(const Session& session) const
+    {
+        if (!session.isLoggedIn())
         {
             std::cout << "Please log in to view order history.\n";
             return;
         }
 
         std::cout << "\n=== YOUR ORDER HISTORY ===\n";
-        bool found = false;
-        
-        for (const auto& order : orders) 
+        std::vector<Order> history = getOrderHistory(session);
+        for (const Order& order : history)
         {
-            if (order.getUserId() == currentUserId) 
-            {
-                order.display(products);
-                std::cout << "------------------------\n";
-                found = true;
-            }
+            order.display(products);
+            std::cout << "------------------------\n";
         }
-        
-        if (!found) 
+
+        if (history.empty())
         {
             std::cout << "No orders found.\n";
         }
     }
 
-    void addProduct(const std::string& name, double price, const std::string& category, int stock) 
+    bool addProduct(const Session& session, const std::string& name, double price, const std::string& category, int stock)
     {
-        if (!isLoggedIn() || !getCurrentUser().isSeller()) 
+        TIME_OPERATION(Operation::ADD_PRODUCT);
+        if (!session.isSeller())
         {
             std::cout << "Only sellers can add products.\n";
-            return;
+            return false;
         }
 
-        if (name.empty() || category.empty() || stock <= 0 || price < 0) 
+        if (name.empty() || category.empty() || stock <= 0 || price < 0)
         {
             std::cout << "Invalid product parameters. Please check your input.\n";
-            return;
+            return false;
         }
 
-        ProductId newId = DataManager::getNextProductId(products);
-        products.emplace_back(newId, name, price, category, stock, currentUserId);
-        
-        saveAllData();
+        ProductId newId = nextProductId++;
+        products.insert(newId, Product(newId, name, price, category, stock, session.getUserId()));
+
+        persist();
         std::cout << "Product added successfully! Product ID: " << newId << "\n";
+        return true;
     }
 
-    void recordExpense(double amount, const std::string& description) 
+    // Adds every valid row of a CSV or TSV catalog (see ProductImport) in one
+    // block: ids are handed out together, the catalog publishes one new
+    // version and the store is saved once. Bad rows are listed in `report`
+    // and do not stop the others. `threads` 0 means one per core.
+    bool importProducts(const Session& session, const std::string& path, ImportReport& report, unsigned threads = 0)
     {
-        if (!isLoggedIn() || !getCurrentUser().isSeller()) 
+        TIME_OPERATION(Operation::IMPORT_PRODUCTS);
+        report = ImportReport();
+        if (!session.isSeller())
+        {
+            std::cout << "Only sellers can import products.\n";
+            return false;
+        }
+
+        MappedFile file(path);
+        if (!file.isOpen())
+        {
+            std::cout << "Could not open '" << path << "'.\n";
+            return false;
+        }
+
+        std::vector<ProductImport::Chunk> chunks = ProductImport::parse(file.data(), file.size(), threads, report);
+        const size_t valid = report.rows - report.rejected;
+        if (valid > 0)
+        {
+            ProductId firstId = nextProductId.fetch_add(static_cast<ProductId>(valid));
+            std::vector<Product> batch = ProductImport::build(chunks, firstId, session.getUserId());
+            chunks.clear();
+            report.imported = products.insertBatch(batch);
+            report.firstId = firstId;
+            report.lastId = firstId + static_cast<ProductId>(valid) - 1;
+            persist();
+        }
+
+        std::cout << "Imported " << report.imported << " of " << report.rows << " products";
+        if (report.imported > 0) std::cout << " (IDs " << report.firstId << "-" << report.lastId << ")";
+        std::cout << ". " << report.rejected << " rows rejected.\n";
+        for (const ImportError& error : report.errors)
+        {
+            std::cout << "  line " << error.line << ": " << error.message << "\n";
+        }
+        if (report.rejected > report.errors.size())
+        {
+            std::cout << "  ... and " << report.rejected - report.errors.size() << " more.\n";
+        }
+        return true;
+    }
+
+    bool recordExpense(Session& session, double amount, const std::string& description)
+    {
+        TIME_OPERATION(Operation::RECORD_EXPENSE);
+        if (!session.isSeller())
         {
             std::cout << "Only sellers can record expenses.\n";
-            return;
+            return false;
         }
 
-        if (amount <= 0) 
+        if (amount <= 0)
         {
             std::cout << "Expense amount must be positive.\n";
-            return;
+            return false;
         }
 
-        if (sellerTracker) 
+        if (!session.getSellerTracker())
         {
-            TransactionId newId = DataManager::getNextTransactionId(transactions);
-            sellerTracker->addExpense(amount, description, newId);
-            
-            Transaction expense(newId, currentUserId, -1, -amount,
-                              TransactionType::EXPENSE, description);
-            transactions.push_back(expense);
-            
-            saveAllData();
-            std::cout << "Expense recorded successfully!\n";
+            std::cout << "Expenses cannot be recorded for this session.\n";
+            return false;
         }
+
+        TransactionId newId = nextTransactionId++;
+        session.getSellerTracker()->addExpense(amount, description, newId);
+
+        Transaction expense(newId, session.getUserId(), -1, -amount,
+                          TransactionType::EXPENSE, description);
+        transactions.append(expense);
+
+        persist();
+        std::cout << "Expense recorded successfully!\n";
+        return true;
     }
 
-    void processRefund(OrderId orderId) 
+    bool processRefund(const Session& session, OrderId orderId)
     {
-        if (!isLoggedIn() || !getCurrentUser().isAdmin()) 
+        TIME_OPERATION(Operation::PROCESS_REFUND);
+        if (!session.isAdmin())
         {
             std::cout << "Only administrators can process refunds.\n";
-            return;
+            return false;
         }
 
-        auto orderIt = std::find_if(orders.begin(), orders.end(), [orderId](const Order& o) { return o.getId() == orderId; });
-        
-        if (orderIt == orders.end()) 
+        UserId customerId = 0;
+        double total = 0.0;
+        OrderStatus status = OrderStatus::PENDING;
+        if (!orders.read(orderId, [&](const Order& o)
+        {
+            customerId = o.getUserId();
+            total = o.getTotal();
+            status = o.getStatus();
+        }))
         {
             std::cout << "Order not found.\n";
-            return;
+            return false;
         }
 
-        if (orderIt->getStatus() == "Refunded") 
+        if (status == OrderStatus::REFUNDED)
         {
             std::cout << "This order has already been refunded.\n";
-            return;
+            return false;
         }
 
-        char confirm;
-        std::cout << "Refund order #" << orderId << " for $" << orderIt->getTotal() << "? (y/N): ";
-        std::cin >> confirm;
-        std::cin.ignore();
-        if (confirm != 'y' && confirm != 'Y') 
+        std::ostringstream prompt;
+        prompt << "Refund order #" << orderId << " for $" << std::fixed << std::setprecision(2) << total << "?";
+        if (!session.ask(prompt.str()))
         {
             std::cout << "Refund cancelled.\n";
-            return;
+            return false;
+        }
+
+        // Re-check under the shard lock so two admins cannot refund the same order
+        bool refunded = false;
+        orders.write(orderId, [this, &refunded](Order& o)
+        {
+            const OrderStatus from = o.getStatus();
+            refunded = o.transitionTo(OrderStatus::REFUNDED);
+            if (refunded) statuses.move(o.getId(), from, OrderStatus::REFUNDED);
+        });
+        if (!refunded)
+        {
+            std::cout << "This order has already been refunded.\n";
+            return false;
+        }
+
+        TransactionId refundId = nextTransactionId++;
+        Transaction refund = Transaction::refund(refundId, customerId, -total, orderId);
+        transactions.append(refund);
+
+        persist();
+        std::cout << "Refund processed successfully for Order #" << orderId << ".\n";
+        return true;
+    }
+
+    // Moves an order along its fulfilment, e.g. to Shipped. Refunds go
+    // through processRefund(), which also returns the money.
+    bool updateOrderStatus(const Session& session, OrderId orderId, OrderStatus next)
+    {
+        TIME_OPERATION(Operation::UPDATE_ORDER_STATUS);
+        if (!session.isAdmin())
+        {
+            std::cout << "Only administrators can change order status.\n";
+            return false;
+        }
+
+        if (next == OrderStatus::REFUNDED)
+        {
+            std::cout << "Use refund to refund an order.\n";
+            return false;
+        }
+
+        OrderStatus from = OrderStatus::PENDING;
+        bool moved = false;
+        if (!orders.write(orderId, [this, next, &from, &moved](Order& o)
+        {
+            from = o.getStatus();
+            moved = o.transitionTo(next);
+            if (moved) statuses.move(o.getId(), from, next);
+        }))
+        {
+            std::cout << "Order not found.\n";
+            return false;
         }
 
-        TransactionId refundId = DataManager::getNextTransactionId(transactions);
-        Transaction refund(refundId, orderIt->getUserId(), -1, -orderIt->getTotal(), TransactionType::REFUND, "Refund for Order #" + std::to_string(orderId));
-        transactions.push_back(refund);
+        if (!moved)
+        {
+            std::cout << "Order #" << orderId << " cannot go from " << orderStatusName(from) << " to " << orderStatusName(next) << ".\n";
+            return false;
+        }
 
-        // Update order status
-        const_cast<Order&>(*orderIt).setStatus("Refunded");
+        persist();
+        std::cout << "Order #" << orderId << " is now " << orderStatusName(next) << ".\n";
+        return true;
+    }
 
-        // Update customer tracker
-        for (auto& user : users) 
+    // Orders in `status`, lowest id first, found through the status index
+    std::vector<Order> getOrdersByStatus(OrderStatus status) const
+    {
+        std::vector<Order> result;
+        for (OrderId orderId : statuses.list(status))
         {
-            if (user.getId() == orderIt->getUserId() && user.isCustomer()) 
+            // An order may have moved on since the index was read
+            orders.read(orderId, [&result, status](const Order& o)
             {
-                CustomerExpenseTracker tracker(orderIt->getUserId());
-                tracker.loadSpendingHistory(transactions);
-                tracker.addRefund(refund);
-                break;
-            }
+                if (o.getStatus() == status) result.push_back(o);
+            });
         }
+        return result;
+    }
 
-        saveAllData();
-        std::cout << "Refund processed successfully for Order #" << orderId << ".\n";
+    std::array<size_t, ORDER_STATUS_COUNT> getOrderStatusCounts() const
+    {
+        std::array<size_t, ORDER_STATUS_COUNT> counts{};
+        for (size_t i = 0; i < ORDER_STATUS_COUNT; ++i) counts[i] = statuses.count(static_cast<OrderStatus>(i));
+        return counts;
     }
 
-    void viewSellerReport() const 
+    void viewOrdersByStatus(const Session& session, OrderStatus status) const
     {
-        if (!isLoggedIn() || !getCurrentUser().isSeller()) 
+        TIME_OPERATION(Operation::VIEW_ORDERS_BY_STATUS);
+        if (!session.isAdmin())
+        {
+            std::cout << "Only administrators can list orders.\n";
+            return;
+        }
+
+        std::vector<Order> listed = getOrdersByStatus(status);
+        std::cout << "\n=== ORDERS: " << orderStatusName(status) << " ===\n";
+        std::cout << "ID     | Customer | Date                | Items | Total\n";
+        std::cout << "------------------------------------------------------\n";
+        for (const Order& order : listed)
+        {
+            const std::string_view timestamp = order.getTimestamp();
+            printf("%-6d | %-8d | %-19.*s | %-5zu | $%.2f\n", order.getId(), order.getUserId(), static_cast<int>(timestamp.size()), timestamp.data(),
+                   order.getItems().size(), order.getTotal());
+        }
+        std::cout << "------------------------------------------------------\n";
+        std::cout << listed.size() << " " << (listed.size() == 1 ? "order" : "orders") << ".\n";
+    }
+
+    void viewSellerReport(const Session& session) const
+    {
+        if (!session.isSeller())
         {
             std::cout << "Only sellers can view reports.\n";
             return;
         }
 
-        if (sellerTracker) 
+        if (session.getSellerTracker())
         {
-            sellerTracker->displaySummary();
+            session.getSellerTracker()->displaySummary();
         }
     }
 
-    void viewSellerDetailedReport() const 
+    void viewSellerDetailedReport(const Session& session) const
     {
-        if (!isLoggedIn() || !getCurrentUser().isSeller()) 
+        if (!session.isSeller())
         {
             std::cout << "Only sellers can view detailed reports.\n";
             return;
         }
 
-        if (sellerTracker) 
+        if (session.getSellerTracker())
         {
-            sellerTracker->displayDetailedReport();
+            session.getSellerTracker()->displayDetailedReport();
         }
     }
 
-    void viewSpendingSummary() const 
+    void viewSpendingSummary(const Session& session) const
     {
-        if (!isLoggedIn() || !getCurrentUser().isCustomer()) 
+        if (!session.isCustomer())
         {
             std::cout << "Only customers can view spending summary.\n";
             return;
         }
 
-        if (customerTracker) 
+        if (session.getCustomerTracker())
         {
-            customerTracker->displaySpendingSummary();
+            session.getCustomerTracker()->displaySpendingSummary();
         }
     }
 
-    void viewSpendingHistory() const 
+    void viewSpendingHistory(const Session& session) const
     {
-        if (!isLoggedIn() || !getCurrentUser().isCustomer()) 
+        if (!session.isCustomer())
         {
             std::cout << "Only customers can view spending history.\n";
             return;
         }
 
-        if (customerTracker) 
+        if (session.getCustomerTracker())
         {
-            customerTracker->displayDetailedHistory();
-            customerTracker->displayMonthlySummary();
+            session.getCustomerTracker()->displayDetailedHistory();
+            session.getCustomerTracker()->displayMonthlySummary();
         }
     }
 
-    bool isLoggedIn() const 
-    { 
-        return currentUserId != 0; 
+    bool updatePrice(const Session& session, ProductId productId, double newPrice)
+    {
+        TIME_OPERATION(Operation::UPDATE_PRICE);
+        if (!session.isSeller())
+        {
+            std::cout << "Only sellers can change prices.\n";
+            return false;
+        }
+
+        if (newPrice < 0)
+        {
+            std::cout << "Price cannot be negative.\n";
+            return false;
+        }
+
+        // Lock-free on the product; a checkout that quoted the old price sees the
+        // change when it reserves and quotes again (see reserveCart)
+        bool owned = false;
+        bool found = products.modifyConcurrent(productId, [&](ProductRef& p)
+        {
+            owned = p.getSellerId() == session.getUserId();
+            if (owned) p.setPrice(newPrice);
+        });
+
+        if (!found || !owned)
+        {
+            std::cout << "You can only change the price of your own products.\n";
+            return false;
+        }
+
+        persist();
+        std::cout << "Price of product " << productId << " updated to $" << newPrice << "\n";
+        return true;
     }
-    
-    const User& getCurrentUser() const 
+
+    // Checkouts tried and placed, how many found a price changed since the
+    // customer confirmed the total (placeOrder, CheckoutPipeline), and how
+    // many of those placeOrder quoted again or gave up on.
+    // Counted in Metrics, so the figures cover every store in the process.
+    struct CheckoutStats
     {
-        for (const auto& user : users) 
+        uint64_t attempts;
+        uint64_t committed;
+        uint64_t conflicts;
+        uint64_t retries;
+        uint64_t abandoned;
+
+        double conflictRate() const
         {
-            if (user.getId() == currentUserId) 
-            {
-                return user;
-            }
+            return attempts ? static_cast<double>(conflicts) / attempts : 0.0;
         }
-        throw std::runtime_error("Current user not found in system");
+    };
+
+    CheckoutStats getCheckoutStats() const
+    {
+        const Metrics& metrics = Metrics::instance();
+        return { metrics.get(Counter::CHECKOUT_ATTEMPTS), metrics.get(Counter::CHECKOUT_COMMITTED), metrics.get(Counter::CHECKOUT_CONFLICTS),
+                 metrics.get(Counter::CHECKOUT_RETRIES), metrics.get(Counter::CHECKOUT_ABANDONED) };
+    }
+
+    // Units currently available, or -1 for an unknown product
+    int getAvailableStock(ProductId productId) const
+    {
+        int stock = -1;
+        products.read(productId, [&stock](const ProductRef& p) { stock = p.getStock(); });
+        return stock;
+    }
+
+    // Units set aside by cart holds, or -1 for an unknown product
+    int getHeldStock(ProductId productId) const
+    {
+        int held = -1;
+        products.read(productId, [&held](const ProductRef& p) { held = p.getHeld(); });
+        return held;
+    }
+
+    // Zero turns cart holds off; set before sessions are being served
+    void setCartHoldTtl(std::chrono::seconds ttl)
+    {
+        cartHoldTtl = ttl;
+    }
+
+    // Releases expired cart holds now instead of on the next sweep
+    size_t expireCartHolds()
+    {
+        return holds.expire();
+    }
+
+    struct StoreCounts
+    {
+        size_t users;
+        size_t products;
+        size_t orders;
+        size_t transactions;
+        size_t cartHolds;
+    };
+
+    StoreCounts getStoreCounts() const
+    {
+        return { users.size(), products.size(), orders.size(), transactions.size(), holds.size() };
     }
 
-    void initializeTrackers() 
+    struct InventoryTotals
     {
-        if (!isLoggedIn()) 
+        long long unitsInStock = 0;
+        long long unitsHeld = 0;
+        double stockValue = 0.0; // units in stock and held, at current prices
+        size_t outOfStock = 0;
+    };
+
+    // One pass over the hot product records; names and categories are not read
+    InventoryTotals getInventoryTotals() const
+    {
+        InventoryTotals totals;
+        products.forEachHot([&totals](const ProductHot& p)
+        {
+            int stock = p.stock.load(std::memory_order_relaxed);
+            int held = p.held.load(std::memory_order_relaxed);
+            totals.unitsInStock += stock;
+            totals.unitsHeld += held;
+            totals.stockValue += p.price.load(std::memory_order_relaxed) * (stock + held);
+            if (stock == 0) ++totals.outOfStock;
+        });
+        return totals;
+    }
+
+    void viewSystemStatistics(const Session& session)
+    {
+        if (!session.isAdmin())
+        {
+            std::cout << "Only administrators can view system statistics.\n";
+            return;
+        }
+
+        std::cout << "\n=== SYSTEM STATISTICS ===\n";
+        StoreCounts counts = getStoreCounts();
+        std::cout << "Users: " << counts.users << " | Products: " << counts.products << " | Orders: " << counts.orders << " | Transactions: " << counts.transactions << "\n";
+        CheckoutStats checkout = getCheckoutStats();
+        printf("Checkouts: %llu committed | %llu price conflicts (%.2f%% of attempts) | %llu retries | %llu abandoned\n",
+               static_cast<unsigned long long>(checkout.committed), static_cast<unsigned long long>(checkout.conflicts),
+               checkout.conflictRate() * 100.0, static_cast<unsigned long long>(checkout.retries), static_cast<unsigned long long>(checkout.abandoned));
+        std::array<size_t, ORDER_STATUS_COUNT> byStatus = getOrderStatusCounts();
+        std::cout << "Orders by status:";
+        for (size_t i = 0; i < ORDER_STATUS_COUNT; ++i) std::cout << (i == 0 ? " " : " | ") << orderStatusName(static_cast<OrderStatus>(i)) << " " << byStatus[i];
+        std::cout << "\n";
+        std::cout << "Cart holds: " << counts.cartHolds << " active | " << holds.getExpiredUnits() << " units released on expiry\n";
+        InventoryTotals inventory = getInventoryTotals();
+        printf("Inventory: %lld units in stock, %lld held | $%.2f at current prices | %zu products out of stock\n",
+               inventory.unitsInStock, inventory.unitsHeld, inventory.stockValue, inventory.outOfStock);
+        mergedAnalytics().display(products.sortedValues());
+    }
+
+    // Latency percentiles per operation; with a path, also writes them there
+    // in Prometheus text format
+    bool viewMetrics(const Session& session, const std::string& prometheusPath = "")
+    {
+        if (!session.isAdmin())
+        {
+            std::cout << "Only administrators can view metrics.\n";
+            return false;
+        }
+
+        std::cout << "\n=== METRICS ===\n";
+        Metrics::instance().display(std::cout);
+        if (prometheusPath.empty()) return true;
+        if (!Metrics::instance().writePrometheus(prometheusPath))
+        {
+            std::cout << "Could not write metrics to " << prometheusPath << "\n";
+            return false;
+        }
+        std::cout << "Metrics written to " << prometheusPath << "\n";
+        return true;
+    }
+
+    void initializeTrackers(Session& session)
+    {
+        TRACE_SPAN("ECommerceSystem::initializeTrackers");
+        session.setSellerTracker(nullptr);
+        session.setCustomerTracker(nullptr);
+        if (!session.isLoggedIn())
         {
-            sellerTracker.reset();
-            customerTracker.reset();
             return;
         }
 
-        const User& user = getCurrentUser();
-        loadCart();
+        session.getCart().loadFromFile();
 
-        if (user.isSeller()) 
+        if (session.isSeller())
         {
-            sellerTracker = std::make_unique<ExpenseTracker>(currentUserId);
-            sellerTracker->loadTransactions(transactions);
-        } 
-        else if (user.isCustomer()) 
+            auto tracker = std::make_unique<ExpenseTracker>(session.getUserId());
+            tracker->loadTransactions(transactions.forUser(session.getUserId()));
+            session.setSellerTracker(std::move(tracker));
+        }
+        else if (session.isCustomer())
         {
-            customerTracker = std::make_unique<CustomerExpenseTracker>(currentUserId);
-            customerTracker->loadSpendingHistory(transactions);
+            auto tracker = std::make_unique<CustomerExpenseTracker>(session.getUserId());
+            tracker->loadSpendingHistory(transactions.forUser(session.getUserId()));
+            session.setCustomerTracker(std::move(tracker));
         }
     }
 
-    void saveCart() 
+    void saveCart(const Session& session)
     {
-        if (isLoggedIn()) 
+        if (autoSave && session.isLoggedIn())
         {
-            cart.saveToFile();
+            session.getCart().saveToFile();
         }
     }
 
-    void loadCart() 
+    // Writes transactions, orders and order lines to columnar files (see
+    // ColumnarWriter) in `directory` for offline analysis. History is streamed
+    // one row group at a time, so memory use does not grow with its size.
+    // Timestamps are seconds since 1970 of the recorded wall-clock time.
+    bool exportColumnar(const std::string& directory)
     {
-        if (isLoggedIn()) 
+        TIME_OPERATION(Operation::EXPORT_COLUMNAR);
+        MKDIR(directory.c_str());
+        const std::string base = directory + "/";
+        ColumnarWriter transactionFile(base + "transactions.ecol", {
+            { "id", ColumnType::INT64 }, { "user_id", ColumnType::INT64 }, { "product_id", ColumnType::INT64 }, { "amount", ColumnType::DOUBLE },
+            { "type", ColumnType::STRING }, { "description", ColumnType::STRING }, { "timestamp", ColumnType::TIMESTAMP } });
+        ColumnarWriter orderFile(base + "orders.ecol", {
+            { "id", ColumnType::INT64 }, { "user_id", ColumnType::INT64 }, { "total", ColumnType::DOUBLE }, { "status", ColumnType::STRING },
+            { "timestamp", ColumnType::TIMESTAMP }, { "item_count", ColumnType::INT64 } });
+        ColumnarWriter itemFile(base + "order_items.ecol", {
+            { "order_id", ColumnType::INT64 }, { "product_id", ColumnType::INT64 }, { "quantity", ColumnType::INT64 } });
+        if (!transactionFile.isOpen() || !orderFile.isOpen() || !itemFile.isOpen())
+        {
+            std::cout << "Could not create export files in '" << directory << "'.\n";
+            return false;
+        }
+
+        // Neighbouring rows mostly share a timestamp, so the last one parsed is kept
+        std::string lastTimestamp;
+        int64_t seconds = 0;
+        auto toSeconds = [&lastTimestamp, &seconds](std::string_view text)
+        {
+            if (lastTimestamp != text)
+            {
+                lastTimestamp = text;
+                if (!wallClockSeconds(lastTimestamp.c_str(), seconds)) seconds = 0;
+            }
+            return seconds;
+        };
+
+        transactions.forEachBatch(COLUMNAR_ROW_GROUP_ROWS, [&transactionFile](const std::vector<Transaction>& batch)
+        {
+            for (const Transaction& t : batch)
+            {
+                transactionFile.addInt(0, t.getId());
+                transactionFile.addInt(1, t.getUserId());
+                transactionFile.addInt(2, t.getProductId());
+                transactionFile.addDouble(3, t.getAmount());
+                transactionFile.addString(4, Transaction::typeName(t.getType()));
+                transactionFile.addString(5, t.getDescription());
+                transactionFile.addInt(6, wallClockSeconds(t.getTimestampMicros()));
+                transactionFile.endRow();
+            }
+        });
+
+        // Order ids are dense, so walking them needs no copy of the order table
+        const OrderId end = Order::getNextId();
+        for (OrderId id = 1; id < end; ++id)
+        {
+            orders.read(id, [&orderFile, &itemFile, &toSeconds](const Order& order)
+            {
+                orderFile.addInt(0, order.getId());
+                orderFile.addInt(1, order.getUserId());
+                orderFile.addDouble(2, order.getTotal());
+                orderFile.addString(3, orderStatusName(order.getStatus()));
+                orderFile.addInt(4, toSeconds(order.getTimestamp()));
+                orderFile.addInt(5, static_cast<int64_t>(order.getItems().size()));
+                orderFile.endRow();
+
+                for (const CartItem& item : order.getItems())
+                {
+                    itemFile.addInt(0, order.getId());
+                    itemFile.addInt(1, item.productId);
+                    itemFile.addInt(2, item.quantity);
+                    itemFile.endRow();
+                }
+            });
+        }
+
+        bool written = transactionFile.finish() & orderFile.finish() & itemFile.finish();
+        if (!written)
         {
-            cart = Cart(currentUserId);
-            cart.loadFromFile();
+            std::cout << "Writing the export to '" << directory << "' failed.\n";
+            return false;
         }
+        std::cout << "Exported " << transactionFile.getRows() << " transactions, " << orderFile.getRows() << " orders and "
+                  << itemFile.getRows() << " order lines to '" << directory << "' ("
+                  << (transactionFile.getBytesWritten() + orderFile.getBytesWritten() + itemFile.getBytesWritten()) / 1024 << " KB).\n";
+        return true;
     }
 
-    void saveAllData() 
+    // Writes a copy of every store; concurrent operations keep running meanwhile
+    void saveAllData()
     {
-        DataManager::saveSystemState(products, users, orders, transactions);
-        saveCart();
+        TIME_OPERATION(Operation::SAVE_ALL_DATA);
+        TRACE_SPAN("ECommerceSystem::saveAllData");
+        std::lock_guard<std::mutex> lock(persistMutex);
+        DataManager::saveSystemState(products.sortedValues(), users.sortedValues(), orders.sortedValues(), transactions.snapshot());
+        DataManager::saveAnalytics(mergedAnalytics());
     }
 
-    ~ECommerceSystem() 
+    ~ECommerceSystem()
     {
+        {
+            std::lock_guard<std::mutex> lock(sweepMutex);
+            sweepStopping = true;
+        }
+        sweepWake.notify_one();
+        holdSweeper.join();
         saveAllData();
     }
-}; 
\ No newline at end of file
+};
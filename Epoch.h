@@ -0,0 +1,155 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+// Epoch-based reclamation for read-copy-update structures.
+//
+// Readers enter the domain (EpochGuard) before loading a published pointer
+// and leave when done; they never block. A writer that unpublishes an object
+// hands it to retire(), and it is deleted once every reader that could still
+// see it has left.
+class EpochDomain
+{
+public:
+    static constexpr size_t MAX_THREADS = 256;
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> claimed{false};
+    };
+
+    struct Retired
+    {
+        uint64_t epoch;
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    // One per thread: which slot it announces in, and how deeply it is nested
+    struct ThreadState
+    {
+        Slot* slot = nullptr;
+        int depth = 0;
+
+        ~ThreadState()
+        {
+            if (slot) slot->claimed.store(false);
+        }
+    };
+
+    std::array<Slot, MAX_THREADS> slots;
+    std::atomic<uint64_t> globalEpoch{1};
+    std::mutex retiredMutex;
+    std::vector<Retired> retired;
+
+    ThreadState& threadState()
+    {
+        thread_local ThreadState state;
+        if (!state.slot)
+        {
+            for (Slot& slot : slots)
+            {
+                bool expected = false;
+                if (slot.claimed.compare_exchange_strong(expected, true))
+                {
+                    state.slot = &slot;
+                    break;
+                }
+            }
+            if (!state.slot) throw std::runtime_error("EpochDomain: too many reader threads");
+        }
+        return state;
+    }
+
+    uint64_t oldestActiveEpoch() const
+    {
+        uint64_t oldest = IDLE;
+        for (const Slot& slot : slots)
+        {
+            uint64_t e = slot.epoch.load();
+            if (e < oldest) oldest = e;
+        }
+        return oldest;
+    }
+
+    EpochDomain() = default;
+
+public:
+    static EpochDomain& instance()
+    {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    void enter()
+    {
+        ThreadState& state = threadState();
+        if (state.depth++ == 0)
+        {
+            state.slot->epoch.store(globalEpoch.load());
+        }
+    }
+
+    void leave()
+    {
+        ThreadState& state = threadState();
+        if (--state.depth == 0)
+        {
+            state.slot->epoch.store(IDLE);
+        }
+    }
+
+    // Call after the object has been unpublished
+    template <typename T>
+    void retire(const T* object)
+    {
+        {
+            std::lock_guard<std::mutex> lock(retiredMutex);
+            retired.push_back({ globalEpoch.load(), const_cast<T*>(object), [](void* p) { delete static_cast<T*>(p); } });
+        }
+        globalEpoch.fetch_add(1);
+        reclaim();
+    }
+
+    // Deletes every retired object no reader can still be looking at
+    void reclaim()
+    {
+        std::vector<Retired> ready;
+        {
+            std::lock_guard<std::mutex> lock(retiredMutex);
+            uint64_t oldest = oldestActiveEpoch();
+            auto keep = std::partition(retired.begin(), retired.end(), [oldest](const Retired& r) { return r.epoch >= oldest; });
+            ready.assign(keep, retired.end());
+            retired.erase(keep, retired.end());
+        }
+        for (const Retired& r : ready)
+        {
+            r.destroy(r.object);
+        }
+    }
+};
+
+class EpochGuard
+{
+public:
+    EpochGuard()
+    {
+        EpochDomain::instance().enter();
+    }
+
+    ~EpochGuard()
+    {
+        EpochDomain::instance().leave();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
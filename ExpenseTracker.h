@@ -5,6 +5,7 @@
 #include <iostream>
 #include <algorithm>
 #include "Transaction.h"
+#include "Tracing.h"
 #include "config.h"
 
 class ExpenseTracker {
@@ -16,6 +17,7 @@ public:
     explicit ExpenseTracker(UserId sellerId) : sellerId(sellerId) {}
 
     void loadTransactions(const std::vector<Transaction>& allTransactions) {
+        TRACE_SPAN("ExpenseTracker::loadTransactions");
         transactions.clear();
         for (const auto& t : allTransactions) {
             if (t.getUserId() == sellerId && 
@@ -119,15 +121,18 @@ public:
         std::cout << "Date       | Type    | Amount  | Description\n";
         std::cout << "--------------------------------------------\n";
         
+        // Reused from row to row
+        std::string timestamp, description;
         for (const auto& t : transactions) {
-            std::string date = std::string(t.getTimestamp());
-            if (date.length() >= 10) date = date.substr(0, 10);
-            std::string type = t.isSale() ? "SALE" : 
+            formatTimestamp(t.getTimestampMicros(), timestamp);
+            description.clear();
+            t.appendDescription(description);
+            const char* type = t.isSale() ? "SALE" : 
                              t.isExpense() ? "EXPENSE" : "REFUND";
             double amount = t.isExpense() ? -std::abs(t.getAmount()) : t.getAmount();
             
-            printf("%-10s | %-7s | $%-6.2f | %s\n", 
-                   date.c_str(), type.c_str(), amount, t.getDescription().c_str());
+            printf("%-10.10s | %-7s | $%-6.2f | %s\n", 
+                   timestamp.c_str(), type, amount, description.c_str());
         }
     }
 
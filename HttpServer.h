@@ -0,0 +1,534 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+struct HttpRequest
+{
+    std::string method;
+    std::string path;   // without the query string
+    std::string query;  // raw, after '?'
+    std::string body;
+    std::map<std::string, std::string> headers; // names lower-cased
+    bool keepAlive = true;
+
+    static std::string urlDecode(const std::string& text)
+    {
+        std::string result;
+        result.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (text[i] == '+')
+            {
+                result += ' ';
+            }
+            else if (text[i] == '%' && i + 2 < text.size() && std::isxdigit(static_cast<unsigned char>(text[i + 1])) && std::isxdigit(static_cast<unsigned char>(text[i + 2])))
+            {
+                result += static_cast<char>(std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            }
+            else
+            {
+                result += text[i];
+            }
+        }
+        return result;
+    }
+
+    // Looks `name` up in the query string, then in a form-encoded body
+    bool param(const std::string& name, std::string& value) const
+    {
+        for (const std::string* source : { &query, &body })
+        {
+            size_t pos = 0;
+            while (pos <= source->size())
+            {
+                size_t end = source->find('&', pos);
+                if (end == std::string::npos) end = source->size();
+                size_t eq = source->find('=', pos);
+                if (eq != std::string::npos && eq < end && urlDecode(source->substr(pos, eq - pos)) == name)
+                {
+                    value = urlDecode(source->substr(eq + 1, end - eq - 1));
+                    return true;
+                }
+                pos = end + 1;
+            }
+        }
+        return false;
+    }
+
+    std::string header(const std::string& lowerName) const
+    {
+        auto it = headers.find(lowerName);
+        return it == headers.end() ? std::string() : it->second;
+    }
+};
+
+struct HttpResponse
+{
+    int status = 200;
+    std::string contentType = "application/json";
+    std::string body;
+
+    static HttpResponse json(int status, std::string body)
+    {
+        HttpResponse response;
+        response.status = status;
+        response.body = std::move(body);
+        return response;
+    }
+
+    static const char* reason(int status)
+    {
+        switch (status)
+        {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        default: return status < 500 ? "Bad Request" : "Internal Server Error";
+        }
+    }
+
+    void serialize(std::string& out, bool keepAlive) const
+    {
+        out += "HTTP/1.1 ";
+        out += std::to_string(status);
+        out += ' ';
+        out += reason(status);
+        out += "\r\nContent-Type: ";
+        out += contentType;
+        out += "\r\nContent-Length: ";
+        out += std::to_string(body.size());
+        out += keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+        out += body;
+    }
+};
+
+// Incremental HTTP/1.1 request parser. Works on a buffer that may hold a
+// partial request or several pipelined ones; chunked bodies are not supported.
+class HttpParser
+{
+public:
+    enum class Result { COMPLETE, INCOMPLETE, HEADERS_TOO_LARGE, BODY_TOO_LARGE, BAD_REQUEST, UNSUPPORTED };
+
+    static constexpr size_t MAX_HEADER_BYTES = 16 * 1024;
+    static constexpr size_t MAX_BODY_BYTES = 1024 * 1024;
+
+    // Parses one request starting at `offset`; on COMPLETE, `consumed` is its length
+    static Result parse(const std::string& buffer, size_t offset, HttpRequest& request, size_t& consumed)
+    {
+        size_t headerEnd = buffer.find("\r\n\r\n", offset);
+        if (headerEnd == std::string::npos)
+        {
+            return buffer.size() - offset > MAX_HEADER_BYTES ? Result::HEADERS_TOO_LARGE : Result::INCOMPLETE;
+        }
+        if (headerEnd - offset > MAX_HEADER_BYTES) return Result::HEADERS_TOO_LARGE;
+
+        request = HttpRequest();
+        size_t lineEnd = buffer.find("\r\n", offset);
+        size_t firstSpace = buffer.find(' ', offset);
+        size_t secondSpace = firstSpace == std::string::npos ? std::string::npos : buffer.find(' ', firstSpace + 1);
+        if (firstSpace == std::string::npos || secondSpace == std::string::npos || secondSpace > lineEnd) return Result::BAD_REQUEST;
+
+        request.method = buffer.substr(offset, firstSpace - offset);
+        std::string target = buffer.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+        std::string version = buffer.substr(secondSpace + 1, lineEnd - secondSpace - 1);
+        if (version != "HTTP/1.1" && version != "HTTP/1.0") return Result::BAD_REQUEST;
+
+        size_t question = target.find('?');
+        request.path = target.substr(0, question);
+        if (question != std::string::npos) request.query = target.substr(question + 1);
+
+        for (size_t pos = lineEnd + 2; pos < headerEnd;)
+        {
+            size_t end = buffer.find("\r\n", pos);
+            size_t colon = buffer.find(':', pos);
+            if (colon == std::string::npos || colon > end) return Result::BAD_REQUEST;
+
+            std::string name = buffer.substr(pos, colon - pos);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            size_t valueStart = buffer.find_first_not_of(" \t", colon + 1);
+            std::string value = valueStart < end ? buffer.substr(valueStart, end - valueStart) : std::string();
+            request.headers[name] = value;
+            pos = end + 2;
+        }
+
+        std::string connection = request.header("connection");
+        std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+        request.keepAlive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+
+        if (!request.header("transfer-encoding").empty()) return Result::UNSUPPORTED;
+
+        size_t bodyLength = 0;
+        std::string length = request.header("content-length");
+        if (!length.empty())
+        {
+            char* end = nullptr;
+            unsigned long long parsed = std::strtoull(length.c_str(), &end, 10);
+            if (*end != '\0') return Result::BAD_REQUEST;
+            if (parsed > MAX_BODY_BYTES) return Result::BODY_TOO_LARGE;
+            bodyLength = static_cast<size_t>(parsed);
+        }
+
+        size_t bodyStart = headerEnd + 4;
+        if (buffer.size() - bodyStart < bodyLength) return Result::INCOMPLETE;
+        request.body = buffer.substr(bodyStart, bodyLength);
+        consumed = bodyStart + bodyLength - offset;
+        return Result::COMPLETE;
+    }
+};
+
+// Embedded non-blocking HTTP/1.1 server.
+//
+// Each worker thread runs its own epoll loop and owns the connections it
+// accepts; all workers wait on the same listening socket (EPOLLEXCLUSIVE, so
+// a new connection wakes one of them). A connection is only ever touched by
+// its worker, so requests are handled in arrival order, which is what
+// keep-alive and pipelining need: every complete request in the read buffer
+// is answered in one pass and the responses go out in a single write.
+//
+// The handler is called concurrently from all workers and must be thread-safe.
+// Linux only; start() throws elsewhere.
+class HttpServer
+{
+public:
+    using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+private:
+    Handler handler;
+    int threadCount;
+    int listenFd = -1;
+    int boundPort = 0;
+    std::vector<std::thread> workers;
+    std::vector<int> wakeFds;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> requestsServed{0};
+
+#ifdef __linux__
+    static constexpr size_t MAX_PENDING_OUTPUT = 256 * 1024; // per connection, before reading pauses
+
+    struct Connection
+    {
+        std::string in;
+        std::string out;
+        size_t written = 0;
+        bool closeAfterWrite = false;
+        bool wantWrite = false;
+    };
+
+    static void closeConnection(int epollFd, int fd, std::unordered_map<int, Connection>& connections)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    }
+
+    // Sends what it can; false if the connection is finished or broken
+    static bool flush(int epollFd, int fd, Connection& connection)
+    {
+        while (connection.written < connection.out.size())
+        {
+            ssize_t n = send(fd, connection.out.data() + connection.written, connection.out.size() - connection.written, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                connection.written += static_cast<size_t>(n);
+            }
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                if (!connection.wantWrite)
+                {
+                    // Stop reading until the client takes what it already asked for
+                    epoll_event ev{};
+                    ev.events = EPOLLOUT | EPOLLRDHUP;
+                    ev.data.fd = fd;
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+                    connection.wantWrite = true;
+                }
+                return true;
+            }
+            else if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        connection.out.clear();
+        connection.written = 0;
+        if (connection.wantWrite)
+        {
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+            connection.wantWrite = false;
+        }
+        return !connection.closeAfterWrite;
+    }
+
+    static HttpResponse errorResponse(HttpParser::Result result)
+    {
+        switch (result)
+        {
+        case HttpParser::Result::HEADERS_TOO_LARGE: return HttpResponse::json(431, "{\"error\":\"headers too large\"}");
+        case HttpParser::Result::BODY_TOO_LARGE: return HttpResponse::json(413, "{\"error\":\"body too large\"}");
+        case HttpParser::Result::UNSUPPORTED: return HttpResponse::json(501, "{\"error\":\"chunked bodies are not supported\"}");
+        default: return HttpResponse::json(400, "{\"error\":\"malformed request\"}");
+        }
+    }
+
+    // Answers the complete requests in the read buffer until the output buffer
+    // fills; true if it stopped for that, so requests may be left
+    bool serve(Connection& connection)
+    {
+        size_t offset = 0;
+        HttpRequest request;
+        while (!connection.closeAfterWrite && connection.out.size() < MAX_PENDING_OUTPUT)
+        {
+            size_t consumed = 0;
+            HttpParser::Result result = HttpParser::parse(connection.in, offset, request, consumed);
+            if (result == HttpParser::Result::INCOMPLETE) break;
+            if (result != HttpParser::Result::COMPLETE)
+            {
+                errorResponse(result).serialize(connection.out, false);
+                connection.closeAfterWrite = true;
+                break;
+            }
+
+            offset += consumed;
+            HttpResponse response;
+            try
+            {
+                response = handler(request);
+            }
+            catch (const std::exception&)
+            {
+                response = HttpResponse::json(500, "{\"error\":\"internal error\"}");
+            }
+            response.serialize(connection.out, request.keepAlive);
+            requestsServed.fetch_add(1, std::memory_order_relaxed);
+            if (!request.keepAlive) connection.closeAfterWrite = true;
+        }
+        connection.in.erase(0, offset);
+        return !connection.closeAfterWrite && connection.out.size() >= MAX_PENDING_OUTPUT;
+    }
+
+    void acceptAll(int epollFd, std::unordered_map<int, Connection>& connections)
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN: another worker took it, or nothing left
+
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+            {
+                close(fd);
+                continue;
+            }
+            connections[fd] = Connection();
+        }
+    }
+
+    void workerLoop(int wakeFd)
+    {
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+        std::unordered_map<int, Connection> connections;
+        std::vector<epoll_event> events(256);
+        char buffer[64 * 1024];
+
+        while (running.load())
+        {
+            int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0 && errno != EINTR) break;
+
+            for (int i = 0; i < ready; ++i)
+            {
+                int fd = events[i].data.fd;
+                uint32_t flags = events[i].events;
+                if (fd == wakeFd) continue;
+                if (fd == listenFd)
+                {
+                    acceptAll(epollFd, connections);
+                    continue;
+                }
+
+                auto it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection& connection = it->second;
+
+                bool alive = true;
+                bool peerClosed = false;
+                if (flags & EPOLLOUT)
+                {
+                    alive = flush(epollFd, fd, connection);
+                }
+                if (alive && (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+                {
+                    while (true)
+                    {
+                        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                        if (n > 0)
+                        {
+                            connection.in.append(buffer, static_cast<size_t>(n));
+                            if (static_cast<size_t>(n) < sizeof(buffer)) break;
+                        }
+                        else if (n == 0)
+                        {
+                            peerClosed = true;
+                            break;
+                        }
+                        else if (errno == EINTR)
+                        {
+                            continue;
+                        }
+                        else
+                        {
+                            peerClosed = errno != EAGAIN && errno != EWOULDBLOCK;
+                            break;
+                        }
+                    }
+                }
+                // A level-triggered socket does not report requests that are
+                // already read, so ones left over when the output buffer filled
+                // are served here as soon as the output has gone out, or after
+                // EPOLLOUT if the send would block
+                bool more = true;
+                while (alive && more && !connection.wantWrite)
+                {
+                    more = serve(connection);
+                    alive = flush(epollFd, fd, connection);
+                }
+                if (peerClosed) alive = false;
+
+                if (!alive) closeConnection(epollFd, fd, connections);
+            }
+        }
+
+        for (auto& entry : connections) close(entry.first);
+        close(epollFd);
+    }
+#endif
+
+public:
+    HttpServer(Handler handler, int threadCount) : handler(std::move(handler)), threadCount(std::max(1, threadCount)) {}
+
+    ~HttpServer()
+    {
+        stop();
+    }
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // Binds to `address`:`port` (0 picks a free port) and starts the workers
+    void start(const std::string& address, int port)
+    {
+#ifdef __linux__
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) throw std::runtime_error("HttpServer: socket() failed");
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1 ||
+            bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listenFd, SOMAXCONN) != 0)
+        {
+            close(listenFd);
+            listenFd = -1;
+            throw std::runtime_error("HttpServer: cannot listen on " + address + ":" + std::to_string(port) + ": " + std::strerror(errno));
+        }
+
+        socklen_t length = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &length);
+        boundPort = ntohs(addr.sin_port);
+
+        running = true;
+        for (int i = 0; i < threadCount; ++i)
+        {
+            int wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            wakeFds.push_back(wakeFd);
+            workers.emplace_back(&HttpServer::workerLoop, this, wakeFd);
+        }
+#else
+        (void)address;
+        (void)port;
+        throw std::runtime_error("HttpServer: only supported on Linux");
+#endif
+    }
+
+    void stop()
+    {
+#ifdef __linux__
+        if (!running.exchange(false)) return;
+        for (int wakeFd : wakeFds)
+        {
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+        for (auto& worker : workers) worker.join();
+        for (int wakeFd : wakeFds) close(wakeFd);
+        workers.clear();
+        wakeFds.clear();
+        close(listenFd);
+        listenFd = -1;
+#endif
+    }
+
+    int port() const
+    {
+        return boundPort;
+    }
+
+    uint64_t getRequestsServed() const
+    {
+        return requestsServed.load();
+    }
+};
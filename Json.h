@@ -0,0 +1,154 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <type_traits>
+
+// Minimal streaming JSON writer. Commas are inserted automatically; the
+// caller is responsible for balancing begin/end calls.
+class JsonWriter
+{
+private:
+    std::string out;
+    std::vector<bool> first; // per open container: nothing written into it yet
+    bool afterKey = false;
+
+    void separate()
+    {
+        if (afterKey)
+        {
+            afterKey = false;
+            return;
+        }
+        if (!first.empty())
+        {
+            if (!first.back()) out += ',';
+            first.back() = false;
+        }
+    }
+
+    void appendEscaped(std::string_view text)
+    {
+        out += '"';
+        for (unsigned char c : text)
+        {
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else
+                {
+                    out += static_cast<char>(c);
+                }
+            }
+        }
+        out += '"';
+    }
+
+public:
+    JsonWriter& beginObject()
+    {
+        separate();
+        out += '{';
+        first.push_back(true);
+        return *this;
+    }
+
+    JsonWriter& endObject()
+    {
+        out += '}';
+        first.pop_back();
+        return *this;
+    }
+
+    JsonWriter& beginArray()
+    {
+        separate();
+        out += '[';
+        first.push_back(true);
+        return *this;
+    }
+
+    JsonWriter& endArray()
+    {
+        out += ']';
+        first.pop_back();
+        return *this;
+    }
+
+    JsonWriter& key(std::string_view name)
+    {
+        separate();
+        appendEscaped(name);
+        out += ':';
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view text)
+    {
+        separate();
+        appendEscaped(text);
+        return *this;
+    }
+
+    JsonWriter& value(const char* text)
+    {
+        return value(std::string_view(text));
+    }
+
+    JsonWriter& value(double number)
+    {
+        separate();
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.15g", number);
+        out += buf;
+        return *this;
+    }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    JsonWriter& value(T number)
+    {
+        separate();
+        out += std::to_string(number);
+        return *this;
+    }
+
+    JsonWriter& value(bool flag)
+    {
+        separate();
+        out += flag ? "true" : "false";
+        return *this;
+    }
+
+    JsonWriter& null()
+    {
+        separate();
+        out += "null";
+        return *this;
+    }
+
+    // key(name).value(v) in one call
+    template <typename T>
+    JsonWriter& field(std::string_view name, const T& v)
+    {
+        key(name);
+        return value(v);
+    }
+
+    const std::string& str() const
+    {
+        return out;
+    }
+};
@@ -0,0 +1,273 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <ctime>
+#include "config.h"
+
+enum class LogLevel { DEBUG, INFO, WARN, ERROR, OFF };
+
+// Leveled logger for the domain code, which never prints diagnostics itself.
+//
+// A message below the current level costs one relaxed load: the macros test
+// the level before the arguments are evaluated. A message that passes is
+// formatted into a ring buffer owned by the calling thread (one producer,
+// one consumer, no locks) and a background thread writes it out, so the
+// caller never waits on the console or the disk. When a ring is full the
+// message is dropped and counted rather than blocking.
+//
+// Each line is: time level component thread=N message
+class Logger
+{
+public:
+    static constexpr size_t MAX_THREADS = 256;
+    static constexpr size_t RING_SIZE = 1024; // messages per thread, a power of two
+    static constexpr size_t MESSAGE_SIZE = 200;
+
+private:
+    struct Record
+    {
+        int64_t timeUs; // since the Unix epoch
+        LogLevel level;
+        const char* component;
+        char text[MESSAGE_SIZE];
+    };
+
+    // Written by its thread, read by the flusher
+    struct Ring
+    {
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        std::array<Record, RING_SIZE> records;
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<Ring*> ring{nullptr};
+        std::atomic<bool> claimed{false};
+    };
+
+    struct ThreadState
+    {
+        Ring* ring = nullptr;
+        Slot* owned = nullptr;
+        size_t thread = 0;
+
+        ~ThreadState()
+        {
+            if (owned) owned->claimed.store(false);
+        }
+    };
+
+    struct Pending
+    {
+        const Record* record;
+        size_t thread;
+    };
+
+    static inline std::atomic<int> threshold{static_cast<int>(LogLevel::WARN)};
+
+    std::array<Slot, MAX_THREADS> slots;
+    std::mutex drainMutex; // one drain at a time: the flusher, or flush()
+    std::FILE* output = stderr;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> lost{0}; // messages from threads past MAX_THREADS
+    std::thread flusher;
+
+    Ring* threadRing(size_t& thread)
+    {
+        thread_local ThreadState state;
+        if (!state.ring && !state.owned)
+        {
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                bool expected = false;
+                if (!slots[i].claimed.compare_exchange_strong(expected, true)) continue;
+                state.owned = &slots[i];
+                state.thread = i + 1;
+                Ring* ring = slots[i].ring.load(std::memory_order_acquire);
+                if (!ring)
+                {
+                    ring = new Ring();
+                    slots[i].ring.store(ring, std::memory_order_release);
+                }
+                state.ring = ring;
+                break;
+            }
+        }
+        thread = state.thread;
+        return state.ring;
+    }
+
+    static const char* levelName(LogLevel level)
+    {
+        static const char* const names[] = { "DEBUG", "INFO", "WARN", "ERROR", "OFF" };
+        return names[static_cast<int>(level)];
+    }
+
+    // Caller holds drainMutex. Writes everything queued, oldest first across threads.
+    void drain()
+    {
+        std::vector<Pending> pending;
+        std::vector<std::pair<Ring*, uint64_t>> taken;
+        uint64_t dropped = lost.exchange(0);
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            Ring* ring = slots[i].ring.load(std::memory_order_acquire);
+            if (!ring) continue;
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            for (uint64_t r = tail; r < head; ++r) pending.push_back({ &ring->records[r % RING_SIZE], i + 1 });
+            taken.emplace_back(ring, head);
+            dropped += ring->dropped.exchange(0);
+        }
+        if (pending.empty() && dropped == 0) return;
+
+        std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) { return a.record->timeUs < b.record->timeUs; });
+        for (const Pending& p : pending)
+        {
+            const Record& record = *p.record;
+            std::time_t seconds = static_cast<std::time_t>(record.timeUs / 1000000);
+            std::tm local = localTime(seconds);
+            char time[32];
+            std::strftime(time, sizeof(time), "%Y-%m-%d %H:%M:%S", &local);
+            std::fprintf(output, "%s.%06lld %-5s %s thread=%zu %s\n", time, static_cast<long long>(record.timeUs % 1000000), levelName(record.level),
+                         record.component, p.thread, record.text);
+        }
+        if (dropped > 0) std::fprintf(output, "WARN  logger: %llu messages dropped, log rings were full\n", static_cast<unsigned long long>(dropped));
+        std::fflush(output);
+
+        // Hand the slots back only once their records have been written
+        for (const auto& entry : taken) entry.first->tail.store(entry.second, std::memory_order_release);
+    }
+
+    void flushLoop()
+    {
+        while (!stopping.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            std::lock_guard<std::mutex> lock(drainMutex);
+            drain();
+        }
+    }
+
+    Logger()
+    {
+        flusher = std::thread([this] { flushLoop(); });
+    }
+
+    ~Logger()
+    {
+        stopping.store(true);
+        flusher.join();
+        {
+            std::lock_guard<std::mutex> lock(drainMutex);
+            drain();
+            if (output != stderr) std::fclose(output);
+        }
+        for (Slot& slot : slots) delete slot.ring.load();
+    }
+
+public:
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    static Logger& instance()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    static bool enabled(LogLevel level)
+    {
+        return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed);
+    }
+
+    // Messages below `level` are skipped at the call site; WARN unless changed
+    static void setLevel(LogLevel level)
+    {
+        threshold.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    static bool parseLevel(const std::string& text, LogLevel& level)
+    {
+        static const char* const names[] = { "debug", "info", "warn", "error", "off" };
+        for (int i = 0; i <= static_cast<int>(LogLevel::OFF); ++i)
+        {
+            if (text == names[i])
+            {
+                level = static_cast<LogLevel>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Appends to `path` instead of stderr; false if it cannot be opened
+    bool setOutput(const std::string& path)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "a");
+        if (!file) return false;
+        std::lock_guard<std::mutex> lock(drainMutex);
+        drain();
+        if (output != stderr) std::fclose(output);
+        output = file;
+        return true;
+    }
+
+    // Writes out everything logged so far
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(drainMutex);
+        drain();
+    }
+
+#if defined(__GNUC__)
+    __attribute__((format(printf, 4, 5)))
+#endif
+    void write(LogLevel level, const char* component, const char* format, ...)
+    {
+        size_t thread = 0;
+        Ring* ring = threadRing(thread);
+        if (!ring)
+        {
+            lost.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) >= RING_SIZE)
+        {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Record& record = ring->records[head % RING_SIZE];
+        record.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        record.level = level;
+        record.component = component;
+        va_list args;
+        va_start(args, format);
+        std::vsnprintf(record.text, sizeof(record.text), format, args);
+        va_end(args);
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+};
+
+// printf-style; `component` must be a string literal. Arguments are only
+// evaluated when the level is enabled.
+#define LOG_AT(level, component, ...) \
+    do { if (Logger::enabled(level)) Logger::instance().write(level, component, __VA_ARGS__); } while (0)
+#define LOG_DEBUG(component, ...) LOG_AT(LogLevel::DEBUG, component, __VA_ARGS__)
+#define LOG_INFO(component, ...) LOG_AT(LogLevel::INFO, component, __VA_ARGS__)
+#define LOG_WARN(component, ...) LOG_AT(LogLevel::WARN, component, __VA_ARGS__)
+#define LOG_ERROR(component, ...) LOG_AT(LogLevel::ERROR, component, __VA_ARGS__)
@@ -3,7 +3,19 @@
 #include <limits>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <csignal>
+#include <atomic>
 #include "ECommerceSystem.h"
+#include "CommandProcessor.h"
+#include "StoreApi.h"
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
 
 int getIntInput(const std::string& prompt, int min = INT_MIN, int max = INT_MAX) {
     int value;
@@ -55,6 +67,21 @@ void waitForEnter() {
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 
+// Lets the user pick an order, then pages through the catalog
+void browseCatalog(ECommerceSystem& system, const Session& session) {
+    static const ProductSort sorts[] = { ProductSort::NEWEST, ProductSort::PRICE, ProductSort::PRICE, ProductSort::NAME, ProductSort::STOCK };
+    std::cout << "Sort by: 1. Newest  2. Price (low to high)  3. Price (high to low)  4. Name  5. Stock\n";
+    int choice = getIntInput("Choice: ", 1, 5);
+    ProductSort sort = sorts[choice - 1];
+    bool reverse = choice == 3;
+
+    std::string cursor;
+    system.browseProducts(sort, reverse, "", cursor);
+    while (!cursor.empty() && session.ask("Show the next page?")) {
+        system.browseProducts(sort, reverse, std::string(cursor), cursor);
+    }
+}
+
 void showGuestMenu() {
     std::cout << "\n=== E-COMMERCE SYSTEM (GUEST) ===\n";
     std::cout << "1. Login\n";
@@ -90,7 +117,9 @@ void showSellerMenu() {
     std::cout << "4. View Financial Summary\n";
     std::cout << "5. View Detailed Report\n";
     std::cout << "6. Record Expense\n";
-    std::cout << "7. Logout\n";
+    std::cout << "7. Update Product Price\n";
+    std::cout << "8. Import Products from CSV/TSV\n";
+    std::cout << "9. Logout\n";
     std::cout << "Choice: ";
 }
 
@@ -101,18 +130,164 @@ void showAdminMenu() {
     std::cout << "3. View All Users\n";
     std::cout << "4. Process Refund\n";
     std::cout << "5. View System Statistics\n";
-    std::cout << "6. Logout\n";
+    std::cout << "6. View Metrics\n";
+    std::cout << "7. List Orders by Status\n";
+    std::cout << "8. Update Order Status\n";
+    std::cout << "9. Logout\n";
     std::cout << "Choice: ";
 }
 
-int main() {
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--script <file|-> | --replay <file|->] [--yes]\n"
+              << "       " << program << " --serve <port> [--bind <address>] [--threads <n>] [--no-autosave]\n"
+              << "       " << program << " --export <directory>\n"
+              << "  (no options)  interactive menus\n"
+              << "  --script      run commands from a file or stdin ('help' lists them)\n"
+              << "  --replay      run a recorded workload as fast as possible and report\n"
+              << "                throughput and per-command latency on stderr; data is\n"
+              << "                saved once at the end instead of after every change\n"
+              << "  --yes         answer yes to prompts of commands given without --yes/--no\n"
+              << "  --serve       HTTP/JSON API (see StoreApi.h) until interrupted\n"
+              << "  --export      write transactions and orders as columnar files for analysis\n"
+              << "  --trace <file> with any mode above: record spans and write them to <file>\n"
+              << "                as Chrome trace-event JSON (open in ui.perfetto.dev)\n"
+              << "  --log-level <debug|info|warn|error|off> with any mode above (default warn)\n"
+              << "  --log-file <file> append log lines to <file> instead of stderr\n";
+}
+
+std::atomic<bool> stopRequested(false);
+
+void requestStop(int) {
+    stopRequested = true;
+}
+
+int runServer(const std::string& address, int port, int threads, bool autoSave) {
+    // The store narrates every call on stdout; a server has no one to read it
+    std::cout.rdbuf(nullptr);
+    if (!std::freopen(NULL_DEVICE, "w", stdout)) {
+        std::cerr << "Warning: could not redirect stdout.\n";
+    }
+
+    ECommerceSystem system(autoSave);
+    StoreApi api(system);
+    HttpServer server([&api](const HttpRequest& request) { return api.handle(request); }, threads);
+    try {
+        server.start(address, port);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::cerr << "Listening on " << address << ":" << server.port() << " with " << threads << " workers. Ctrl+C to stop.\n";
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    server.stop();
+    std::cerr << "Served " << server.getRequestsServed() << " requests.\n";
+    return 0;
+}
+
+// Script and replay modes; returns the process exit code
+int runCommands(const std::string& mode, const std::string& path, bool confirmByDefault) {
+    std::ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file) {
+            std::cerr << "Cannot open " << path << "\n";
+            return 1;
+        }
+    }
+    std::istream& input = path == "-" ? std::cin : file;
+
+    if (mode == "--script") {
+        ECommerceSystem system;
+        CommandProcessor processor(system, confirmByDefault);
+        return processor.run(input) == 0 ? 0 : 2;
+    }
+
+    // Console output would dominate the timings; the report goes to stderr
+    std::cout.rdbuf(nullptr);
+    if (!std::freopen(NULL_DEVICE, "w", stdout)) {
+        std::cerr << "Warning: could not redirect stdout.\n";
+    }
+    ECommerceSystem system(false);
+    CommandProcessor processor(system, confirmByDefault);
+    CommandProcessor::ReplayReport report = processor.replay(input);
+    report.print(std::cerr);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        std::string mode, path, address = "0.0.0.0", tracePath;
+        LogLevel logLevel = LogLevel::WARN;
+        bool confirmByDefault = false;
+        bool autoSave = true;
+        int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if ((arg == "--script" || arg == "--replay" || arg == "--serve" || arg == "--export") && i + 1 < argc) {
+                mode = arg;
+                path = argv[++i];
+            } else if (arg == "--bind" && i + 1 < argc) {
+                address = argv[++i];
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = std::max(1, std::atoi(argv[++i]));
+            } else if (arg == "--yes") {
+                confirmByDefault = true;
+            } else if (arg == "--no-autosave") {
+                autoSave = false;
+            } else if (arg == "--trace" && i + 1 < argc) {
+                tracePath = argv[++i];
+            } else if (arg == "--log-level" && i + 1 < argc && Logger::parseLevel(argv[i + 1], logLevel)) {
+                Logger::setLevel(logLevel);
+                ++i;
+            } else if (arg == "--log-file" && i + 1 < argc) {
+                if (!Logger::instance().setOutput(argv[++i])) {
+                    std::cerr << "Cannot open log file " << argv[i] << "\n";
+                    return 1;
+                }
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        if (mode.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!tracePath.empty()) {
+            Tracer::instance().start();
+        }
+        int status;
+        if (mode == "--serve") {
+            status = runServer(address, std::atoi(path.c_str()), threads, autoSave);
+        } else if (mode == "--export") {
+            ECommerceSystem system(false);
+            status = system.exportColumnar(path) ? 0 : 1;
+        } else {
+            status = runCommands(mode, path, confirmByDefault);
+        }
+        if (!tracePath.empty()) {
+            Tracer::instance().stop();
+            if (!Tracer::instance().writeChromeTrace(tracePath)) {
+                std::cerr << "Could not write the trace to " << tracePath << "\n";
+            }
+        }
+        return status;
+    }
+
     ECommerceSystem system;
+    Session session;
     
     std::cout << "Welcome to the E-Commerce System!\n";
     std::cout << "Default admin account: Username 'admin', Password 'admin123'\n\n";
     
     while (true) {
-        if (!system.isLoggedIn()) {
+        if (!session.isLoggedIn()) {
             showGuestMenu();
             int choice = getIntInput("", 1, 6);
             
@@ -120,7 +295,7 @@ int main() {
                 case 1: {
                     std::string username = getStringInput("Username: ");
                     std::string password = getStringInput("Password: ");
-                    system.login(username, password);
+                    system.login(session, username, password);
                     waitForEnter();
                     break;
                 }
@@ -139,7 +314,7 @@ int main() {
                     break;
                 }
                 case 4:
-                    system.browseProducts();
+                    browseCatalog(system, session);
                     waitForEnter();
                     break;
                 case 5: {
@@ -153,13 +328,13 @@ int main() {
                     return 0;
             }
         } else {
-            if (system.getCurrentUser().isCustomer()) {
+            if (session.isCustomer()) {
                 showCustomerMenu();
                 int choice = getIntInput("", 1, 11);
                 
                 switch (choice) {
                     case 1:
-                        system.browseProducts();
+                        browseCatalog(system, session);
                         break;
                     case 2: {
                         std::string query = getStringInput("Search term: ");
@@ -167,45 +342,45 @@ int main() {
                         break;
                     }
                     case 3:
-                        system.viewCart();
+                        system.viewCart(session);
                         break;
                     case 4: {
                         ProductId pid = getIntInput("Product ID: ", 1);
                         int qty = getIntInput("Quantity: ", 1);
-                        system.addToCart(pid, qty);
+                        system.addToCart(session, pid, qty);
                         break;
                     }
                     case 5: {
                         ProductId pid = getIntInput("Product ID to remove: ", 1);
-                        system.removeFromCart(pid);
+                        system.removeFromCart(session, pid);
                         break;
                     }
                     case 6:
-                        system.clearCart();
+                        system.clearCart(session);
                         break;
                     case 7:
-                        system.placeOrder();
+                        system.placeOrder(session);
                         break;
                     case 8:
-                        system.viewOrderHistory();
+                        system.viewOrderHistory(session);
                         break;
                     case 9:
-                        system.viewSpendingSummary();
+                        system.viewSpendingSummary(session);
                         break;
                     case 10:
-                        system.viewSpendingHistory();
+                        system.viewSpendingHistory(session);
                         break;
                     case 11:
-                        system.logout();
+                        system.logout(session);
                         continue;
                 }
-            } else if (system.getCurrentUser().isSeller()) {
+            } else if (session.isSeller()) {
                 showSellerMenu();
-                int choice = getIntInput("", 1, 7);
+                int choice = getIntInput("", 1, 9);
                 
                 switch (choice) {
                     case 1:
-                        system.browseProducts();
+                        browseCatalog(system, session);
                         break;
                     case 2: {
                         std::string query = getStringInput("Search term: ");
@@ -217,32 +392,44 @@ int main() {
                         double price = getDoubleInput("Price: $");
                         std::string category = getStringInput("Category: ");
                         int stock = getIntInput("Stock quantity: ", 1);
-                        system.addProduct(name, price, category, stock);
+                        system.addProduct(session, name, price, category, stock);
                         break;
                     }
                     case 4:
-                        system.viewSellerReport();
+                        system.viewSellerReport(session);
                         break;
                     case 5:
-                        system.viewSellerDetailedReport();
+                        system.viewSellerDetailedReport(session);
                         break;
                     case 6: {
                         double amount = getDoubleInput("Expense amount: $");
                         std::string desc = getStringInput("Description: ");
-                        system.recordExpense(amount, desc);
+                        system.recordExpense(session, amount, desc);
                         break;
                     }
-                    case 7:
-                        system.logout();
+                    case 7: {
+                        ProductId pid = getIntInput("Product ID: ", 1);
+                        double price = getDoubleInput("New price: $");
+                        system.updatePrice(session, pid, price);
+                        break;
+                    }
+                    case 8: {
+                        std::string path = getStringInput("File path: ");
+                        ImportReport report;
+                        system.importProducts(session, path, report);
+                        break;
+                    }
+                    case 9:
+                        system.logout(session);
                         continue;
                 }
             } else { // Admin
                 showAdminMenu();
-                int choice = getIntInput("", 1, 6);
+                int choice = getIntInput("", 1, 9);
                 
                 switch (choice) {
                     case 1:
-                        system.browseProducts();
+                        browseCatalog(system, session);
                         break;
                     case 2: {
                         std::string query = getStringInput("Search term: ");
@@ -257,16 +444,38 @@ int main() {
                     }
                     case 4: {
                         OrderId oid = getIntInput("Order ID to refund: ", 1);
-                        system.processRefund(oid);
+                        system.processRefund(session, oid);
                         break;
                     }
-                    case 5: {
-                        std::cout << "\n=== SYSTEM STATISTICS ===\n";
-                        // Basic stats would be displayed here
+                    case 5:
+                        system.viewSystemStatistics(session);
+                        break;
+                    case 6: {
+                        std::string path = getStringInput("Prometheus file (blank to skip): ");
+                        system.viewMetrics(session, path);
                         break;
                     }
-                    case 6:
-                        system.logout();
+                    case 7: {
+                        OrderStatus status;
+                        if (parseOrderStatus(getStringInput("Status (pending, paid, shipped, delivered, refunded, cancelled): "), status)) {
+                            system.viewOrdersByStatus(session, status);
+                        } else {
+                            std::cout << "Unknown status.\n";
+                        }
+                        break;
+                    }
+                    case 8: {
+                        OrderId oid = getIntInput("Order ID: ", 1);
+                        OrderStatus status;
+                        if (parseOrderStatus(getStringInput("New status (paid, shipped, delivered, cancelled): "), status)) {
+                            system.updateOrderStatus(session, oid, status);
+                        } else {
+                            std::cout << "Unknown status.\n";
+                        }
+                        break;
+                    }
+                    case 9:
+                        system.logout(session);
                         continue;
                 }
             }
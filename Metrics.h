@@ -0,0 +1,352 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+
+// Set to 0 (-DECOMMERCE_METRICS=0) to compile the operation timers out;
+// counters stay, since the store reports them as statistics
+#ifndef ECOMMERCE_METRICS
+#define ECOMMERCE_METRICS 1
+#endif
+
+// Timed entry points of the store and phases of loading and saving it
+enum class Operation
+{
+    LOGIN, REGISTER_USER, LOGOUT, BROWSE_PRODUCTS, SEARCH_PRODUCTS, VIEW_CART, ADD_TO_CART, REMOVE_FROM_CART,
+    CLEAR_CART, PLACE_ORDER, PLACE_ORDERS, ADD_PRODUCT, IMPORT_PRODUCTS, UPDATE_PRICE, RECORD_EXPENSE, PROCESS_REFUND,
+    UPDATE_ORDER_STATUS, VIEW_ORDERS_BY_STATUS, SAVE_ALL_DATA, EXPORT_COLUMNAR,
+    LOAD_PRODUCTS, LOAD_USERS, LOAD_ORDERS, LOAD_TRANSACTIONS, LOAD_ANALYTICS,
+    SAVE_PRODUCTS, SAVE_USERS, SAVE_ORDERS, SAVE_TRANSACTIONS, SAVE_ANALYTICS
+};
+
+enum class Counter { CHECKOUT_ATTEMPTS, CHECKOUT_COMMITTED, CHECKOUT_CONFLICTS, CHECKOUT_RETRIES, CHECKOUT_ABANDONED };
+
+// Log-linear latency buckets in the style of HdrHistogram: below 64 ns every
+// nanosecond has a bucket, above that each power of two is split into 32, so
+// a value is known to within about 3%. Anything past ~73 minutes lands in the
+// last bucket.
+struct LatencyBuckets
+{
+    static constexpr int SUB_BITS = 5;
+    static constexpr uint64_t SUB = 1 << SUB_BITS;
+    static constexpr int MAX_EXPONENT = 42;
+    static constexpr size_t COUNT = 2 * SUB + (MAX_EXPONENT - SUB_BITS) * SUB;
+
+    static size_t index(uint64_t ns)
+    {
+        if (ns < 2 * SUB) return static_cast<size_t>(ns);
+        int exponent = std::bit_width(ns) - 1;
+        if (exponent > MAX_EXPONENT) return COUNT - 1;
+        uint64_t sub = (ns >> (exponent - SUB_BITS)) - SUB;
+        return static_cast<size_t>(2 * SUB + (exponent - SUB_BITS - 1) * SUB + sub);
+    }
+
+    // Smallest value in the bucket and how many values it spans
+    static uint64_t lowest(size_t index)
+    {
+        if (index < 2 * SUB) return index;
+        size_t k = index - 2 * SUB;
+        int exponent = static_cast<int>(k / SUB) + SUB_BITS + 1;
+        return (SUB + k % SUB) << (exponent - SUB_BITS);
+    }
+
+    static uint64_t width(size_t index)
+    {
+        if (index < 2 * SUB) return 1;
+        int exponent = static_cast<int>((index - 2 * SUB) / SUB) + SUB_BITS + 1;
+        return uint64_t(1) << (exponent - SUB_BITS);
+    }
+};
+
+// Merged view of one operation across all threads
+struct OperationStats
+{
+    uint64_t count = 0;
+    uint64_t sumNs = 0;
+    uint64_t maxNs = 0;
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(LatencyBuckets::COUNT);
+
+    // Middle of the bucket holding the p-th percentile (p in [0, 100]), capped at the maximum seen
+    uint64_t percentileNs(double p) const
+    {
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * count));
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank) return std::min(maxNs, LatencyBuckets::lowest(i) + LatencyBuckets::width(i) / 2);
+        }
+        return maxNs;
+    }
+
+    double meanNs() const
+    {
+        return count ? static_cast<double>(sumNs) / count : 0.0;
+    }
+};
+
+// Process-wide registry of operation latencies and counters.
+//
+// Each thread records into a block of its own, so recording is a few relaxed
+// atomic adds on cache lines no other thread writes: no locks, no sharing.
+// Reads add the blocks up. Blocks outlive their threads and are handed to
+// the next thread that starts recording, so nothing recorded is lost.
+class Metrics
+{
+public:
+    static constexpr size_t OPERATIONS = static_cast<size_t>(Operation::SAVE_ANALYTICS) + 1;
+    static constexpr size_t COUNTERS = static_cast<size_t>(Counter::CHECKOUT_ABANDONED) + 1;
+    static constexpr size_t MAX_THREADS = 256;
+
+private:
+    struct alignas(64) Recorder
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sumNs{0};
+        std::atomic<uint64_t> maxNs{0};
+        std::array<std::atomic<uint64_t>, LatencyBuckets::COUNT> buckets{};
+    };
+
+    struct ThreadBlock
+    {
+        std::array<Recorder, OPERATIONS> operations;
+        alignas(64) std::array<std::atomic<uint64_t>, COUNTERS> counters{};
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<ThreadBlock*> block{nullptr};
+        std::atomic<bool> claimed{false};
+    };
+
+    // One per thread. Past MAX_THREADS, threads share the last block
+    // without owning it; the atomic adds keep that correct, just slower.
+    struct ThreadState
+    {
+        ThreadBlock* block = nullptr;
+        Slot* owned = nullptr;
+
+        ~ThreadState()
+        {
+            if (owned) owned->claimed.store(false);
+        }
+    };
+
+    std::array<Slot, MAX_THREADS> slots;
+
+    static ThreadBlock* blockOf(Slot& slot)
+    {
+        ThreadBlock* block = slot.block.load(std::memory_order_acquire);
+        if (!block)
+        {
+            ThreadBlock* created = new ThreadBlock();
+            if (slot.block.compare_exchange_strong(block, created, std::memory_order_acq_rel)) block = created;
+            else delete created;
+        }
+        return block;
+    }
+
+    ThreadBlock& threadBlock()
+    {
+        thread_local ThreadState state;
+        if (!state.block)
+        {
+            for (Slot& slot : slots)
+            {
+                bool expected = false;
+                if (slot.claimed.compare_exchange_strong(expected, true))
+                {
+                    state.owned = &slot;
+                    break;
+                }
+            }
+            state.block = blockOf(state.owned ? *state.owned : slots.back());
+        }
+        return *state.block;
+    }
+
+    template <typename F>
+    void forEachBlock(F&& f) const
+    {
+        for (const Slot& slot : slots)
+        {
+            if (const ThreadBlock* block = slot.block.load(std::memory_order_acquire)) f(*block);
+        }
+    }
+
+    Metrics() = default;
+
+    ~Metrics()
+    {
+        for (Slot& slot : slots) delete slot.block.load();
+    }
+
+public:
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    static Metrics& instance()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    void record(Operation operation, uint64_t ns)
+    {
+        Recorder& r = threadBlock().operations[static_cast<size_t>(operation)];
+        r.count.fetch_add(1, std::memory_order_relaxed);
+        r.sumNs.fetch_add(ns, std::memory_order_relaxed);
+        r.buckets[LatencyBuckets::index(ns)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = r.maxNs.load(std::memory_order_relaxed);
+        while (ns > max && !r.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+    }
+
+    void add(Counter counter, uint64_t amount = 1)
+    {
+        threadBlock().counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t get(Counter counter) const
+    {
+        uint64_t total = 0;
+        forEachBlock([&](const ThreadBlock& block) { total += block.counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed); });
+        return total;
+    }
+
+    // Taken while threads keep recording, so the fields may be a few records apart
+    OperationStats get(Operation operation) const
+    {
+        OperationStats stats;
+        forEachBlock([&](const ThreadBlock& block)
+        {
+            const Recorder& r = block.operations[static_cast<size_t>(operation)];
+            stats.count += r.count.load(std::memory_order_relaxed);
+            stats.sumNs += r.sumNs.load(std::memory_order_relaxed);
+            stats.maxNs = std::max(stats.maxNs, r.maxNs.load(std::memory_order_relaxed));
+            for (size_t i = 0; i < LatencyBuckets::COUNT; ++i) stats.buckets[i] += r.buckets[i].load(std::memory_order_relaxed);
+        });
+        return stats;
+    }
+
+    static const char* operationName(Operation operation)
+    {
+        static const char* const names[OPERATIONS] = {
+            "login", "register_user", "logout", "browse_products", "search_products", "view_cart", "add_to_cart", "remove_from_cart",
+            "clear_cart", "place_order", "place_orders", "add_product", "import_products", "update_price", "record_expense", "process_refund",
+            "update_order_status", "view_orders_by_status", "save_all_data", "export_columnar",
+            "load_products", "load_users", "load_orders", "load_transactions", "load_analytics",
+            "save_products", "save_users", "save_orders", "save_transactions", "save_analytics",
+        };
+        return names[static_cast<size_t>(operation)];
+    }
+
+    static const char* counterName(Counter counter)
+    {
+        static const char* const names[COUNTERS] = { "checkout_attempts", "checkout_committed", "checkout_conflicts", "checkout_retries", "checkout_abandoned" };
+        return names[static_cast<size_t>(counter)];
+    }
+
+    // Table of the operations that have run, latencies in microseconds
+    void display(std::ostream& os) const
+    {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-21s | %10s | %10s | %10s | %10s | %10s\n", "operation", "count", "p50 us", "p99 us", "p999 us", "max us");
+        os << line;
+        for (size_t i = 0; i < OPERATIONS; ++i)
+        {
+            OperationStats stats = get(static_cast<Operation>(i));
+            if (stats.count == 0) continue;
+            std::snprintf(line, sizeof(line), "%-21s | %10llu | %10.1f | %10.1f | %10.1f | %10.1f\n", operationName(static_cast<Operation>(i)),
+                          static_cast<unsigned long long>(stats.count), stats.percentileNs(50) / 1000.0, stats.percentileNs(99) / 1000.0,
+                          stats.percentileNs(99.9) / 1000.0, stats.maxNs / 1000.0);
+            os << line;
+        }
+        for (size_t i = 0; i < COUNTERS; ++i)
+        {
+            os << counterName(static_cast<Counter>(i)) << ": " << get(static_cast<Counter>(i)) << "\n";
+        }
+    }
+
+    // Prometheus text exposition format: one summary for the operations, one counter each
+    std::string prometheus() const
+    {
+        std::string text = "# HELP ecommerce_operation_duration_seconds Time spent in store operations.\n"
+                           "# TYPE ecommerce_operation_duration_seconds summary\n";
+        char line[200];
+        for (size_t i = 0; i < OPERATIONS; ++i)
+        {
+            OperationStats stats = get(static_cast<Operation>(i));
+            const char* name = operationName(static_cast<Operation>(i));
+            for (double q : { 0.5, 0.99, 0.999 })
+            {
+                if (stats.count) std::snprintf(line, sizeof(line), "ecommerce_operation_duration_seconds{operation=\"%s\",quantile=\"%g\"} %.9g\n", name, q, stats.percentileNs(q * 100) / 1e9);
+                else std::snprintf(line, sizeof(line), "ecommerce_operation_duration_seconds{operation=\"%s\",quantile=\"%g\"} NaN\n", name, q);
+                text += line;
+            }
+            std::snprintf(line, sizeof(line), "ecommerce_operation_duration_seconds_sum{operation=\"%s\"} %.9g\n", name, stats.sumNs / 1e9);
+            text += line;
+            std::snprintf(line, sizeof(line), "ecommerce_operation_duration_seconds_count{operation=\"%s\"} %llu\n", name, static_cast<unsigned long long>(stats.count));
+            text += line;
+        }
+        for (size_t i = 0; i < COUNTERS; ++i)
+        {
+            const char* name = counterName(static_cast<Counter>(i));
+            std::snprintf(line, sizeof(line), "# TYPE ecommerce_%s_total counter\necommerce_%s_total %llu\n", name, name,
+                          static_cast<unsigned long long>(get(static_cast<Counter>(i))));
+            text += line;
+        }
+        return text;
+    }
+
+    // Replaces `path` whole, so a scraper reading the file never sees half of it
+    bool writePrometheus(const std::string& path) const
+    {
+        const std::string temp = path + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file) return false;
+            file << prometheus();
+            if (!file) return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+};
+
+// Records the time from construction to destruction against an operation
+class OperationTimer
+{
+private:
+    Operation operation;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit OperationTimer(Operation operation) : operation(operation), start(std::chrono::steady_clock::now()) {}
+
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+    ~OperationTimer()
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        Metrics::instance().record(operation, static_cast<uint64_t>(elapsed));
+    }
+};
+
+// Times the rest of the enclosing scope
+#if ECOMMERCE_METRICS
+#define TIME_OPERATION(operation) OperationTimer operationTimer(operation)
+#else
+#define TIME_OPERATION(operation) ((void)0)
+#endif
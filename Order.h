@@ -1,47 +1,72 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <array>
 #include <ctime>
 #include <iostream>
 #include <iomanip>
+#include <atomic>
+#include <span>
+#include <memory_resource>
+#include "ProductCatalog.h"
+#include "OrderItemPool.h"
+#include "OrderStatus.h"
 #include "config.h"
 
 class Order {
 private:
     OrderId orderId;
     UserId userId;
-    std::string timestamp;
-    std::vector<CartItem> items;
+    std::pmr::string timestamp;
+    std::span<const CartItem> items; // in the store's OrderItemPool
     double totalAmount;
-    std::string status;
-    static OrderId nextId;  
+    OrderStatus status = OrderStatus::PENDING;
+    static std::atomic<OrderId> nextId;  
 
 public:
-    Order() : orderId(0), userId(0), totalAmount(0.0), status("Pending") {}
+    Order() : orderId(0), userId(0), totalAmount(0.0) {}
+
+    // Keeps the timestamp in `arena`, see Arena. Copies go back to the heap.
+    explicit Order(std::pmr::memory_resource* arena)
+        : orderId(0), userId(0), timestamp(arena), totalAmount(0.0) {}
     
-    Order(UserId userId, const std::vector<CartItem>& items, double total)
-        : userId(userId), items(items), totalAmount(total), status("Pending") {
+    // The items are copied into `pool`, which must outlive the order and its copies
+    Order(OrderItemPool& pool, UserId userId, std::span<const CartItem> items, double total)
+        : userId(userId), items(pool.append(items)), totalAmount(total) {
         orderId = nextId++;
         updateTimestamp();
     }
 
+    // For ids taken from a reserveIds() block; the timestamp is shared across the batch
+    Order(OrderItemPool& pool, OrderId orderId, UserId userId, std::span<const CartItem> items, double total, std::string_view timestamp)
+        : orderId(orderId), userId(userId), timestamp(timestamp), items(pool.append(items)), totalAmount(total) {}
+
     void updateTimestamp() {
         std::time_t now = std::time(nullptr);
         char buf[DATE_STR_LEN];
-        std::strftime(buf, DATE_STR_LEN, "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+        std::tm local = localTime(now);
+        std::strftime(buf, DATE_STR_LEN, "%Y-%m-%d %H:%M:%S", &local);
         timestamp = buf;
     }
 
     OrderId getId() const { return orderId; }
     static void setNextId(OrderId id) { nextId = id; }
-    static OrderId getNextId() { return nextId; }
+    static OrderId getNextId() { return nextId.load(); }
+    // Claims `count` consecutive ids and returns the first
+    static OrderId reserveIds(int count) { return nextId.fetch_add(count); }
     
     UserId getUserId() const { return userId; }
-    std::string getTimestamp() const { return timestamp; }
-    const std::vector<CartItem>& getItems() const { return items; }
+    std::string_view getTimestamp() const { return timestamp; }
+    std::span<const CartItem> getItems() const { return items; }
     double getTotal() const { return totalAmount; }
-    std::string getStatus() const { return status; }
-    void setStatus(const std::string& newStatus) { status = newStatus; }
+    OrderStatus getStatus() const { return status; }
+    // False, and no change, unless the order may move to `next`; see canTransition()
+    bool transitionTo(OrderStatus next) {
+        if (!canTransition(status, next)) return false;
+        status = next;
+        return true;
+    }
     void setId(OrderId id) { orderId = id; }
 
     void writeToStream(std::ostream& os) const {
@@ -52,9 +77,7 @@ public:
         os.write(reinterpret_cast<const char*>(&len), sizeof(len));
         os.write(timestamp.c_str(), len);
         
-        len = status.size();
-        os.write(reinterpret_cast<const char*>(&len), sizeof(len));
-        os.write(status.c_str(), len);
+        os.put(static_cast<char>(status));
         
         os.write(reinterpret_cast<const char*>(&totalAmount), sizeof(totalAmount));
         
@@ -66,8 +89,9 @@ public:
         }
     }
 
-    static Order readFromStream(std::istream& is) {
-        Order order;
+    // Format 1 spelled the status out, length first
+    static Order readFromStream(std::istream& is, int format, OrderItemPool& pool, std::pmr::memory_resource* arena = std::pmr::get_default_resource()) {
+        Order order(arena);
         
         is.read(reinterpret_cast<char*>(&order.orderId), sizeof(order.orderId));
         is.read(reinterpret_cast<char*>(&order.userId), sizeof(order.userId));
@@ -79,10 +103,17 @@ public:
             is.read(&order.timestamp[0], len);
         }
         
-        is.read(reinterpret_cast<char*>(&len), sizeof(len));
-        if (len > 0 && len < 100) {
-            order.status.resize(len);
-            is.read(&order.status[0], len);
+        if (format == 1) {
+            is.read(reinterpret_cast<char*>(&len), sizeof(len));
+            if (len > 0 && len < 100) {
+                std::string status(len, '\0');
+                is.read(&status[0], len);
+                parseOrderStatus(status, order.status);
+            }
+        } else {
+            int status = is.get();
+            if (status >= 0 && static_cast<size_t>(status) < ORDER_STATUS_COUNT) order.status = static_cast<OrderStatus>(status);
+            else is.setstate(std::ios::failbit);
         }
         
         is.read(reinterpret_cast<char*>(&order.totalAmount), sizeof(order.totalAmount));
@@ -90,29 +121,31 @@ public:
         size_t itemCount;
         is.read(reinterpret_cast<char*>(&itemCount), sizeof(itemCount));
         if (itemCount <= MAX_CART_ITEMS) {
-            order.items.resize(itemCount);
+            std::array<CartItem, MAX_CART_ITEMS> read;
             for (size_t i = 0; i < itemCount; ++i) {
-                is.read(reinterpret_cast<char*>(&order.items[i].productId), sizeof(order.items[i].productId));
-                is.read(reinterpret_cast<char*>(&order.items[i].quantity), sizeof(order.items[i].quantity));
+                is.read(reinterpret_cast<char*>(&read[i].productId), sizeof(read[i].productId));
+                is.read(reinterpret_cast<char*>(&read[i].quantity), sizeof(read[i].quantity));
             }
+            if (is.good()) order.items = pool.append(std::span<const CartItem>(read.data(), itemCount));
+        } else {
+            is.setstate(std::ios::failbit); // the items cannot be skipped reliably, so neither can the rest
         }
         
         return order;
     }
 
-    void display(const std::vector<Product>& products) const {
+    void display(const ProductCatalog& products) const {
         std::cout << "\n=== ORDER #" << orderId << " ===\n";
-        std::cout << "Date: " << timestamp << " | Status: " << status << "\n";
+        std::cout << "Date: " << timestamp << " | Status: " << orderStatusName(status) << "\n";
         std::cout << "Items:\n";
         
-        for (const auto& item : items) {
-            auto productIt = std::find_if(products.begin(), products.end(),
-                [item](const Product& p) { return p.getId() == item.productId; });
+        for (const auto& item : getItems()) {
+            bool found = products.read(item.productId, [&item](const ProductRef& p) {
+                std::cout << "  - " << p.getName() << " x" << item.quantity 
+                          << " @ $" << p.getPrice() << "\n";
+            });
             
-            if (productIt != products.end()) {
-                std::cout << "  - " << productIt->getName() << " x" << item.quantity 
-                          << " @ $" << productIt->getPrice() << "\n";
-            } else {
+            if (!found) {
                 std::cout << "  - [Product ID " << item.productId << " no longer available] x" << item.quantity << "\n";
             }
         }
@@ -121,4 +154,4 @@ public:
     }
 };
 
-OrderId Order::nextId = 1;
+std::atomic<OrderId> Order::nextId{1};
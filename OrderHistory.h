@@ -0,0 +1,162 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <span>
+#include <shared_mutex>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include "config.h"
+
+// Each user's orders, oldest first, in compressed sparse row form: the ids
+// sit back to back in one pool per shard and a user holds the offset and
+// length of their run, found by user id in O(1). Reading a history is a
+// sequential scan.
+//
+// A run has room to grow. A run that is full and not at the end of the pool
+// moves to the end with twice the room, leaving a hole behind; once holes
+// make up half a pool it is compacted. Users are spread over SHARDS shards,
+// each with its own lock, so checkouts for different users rarely wait.
+class OrderHistoryIndex
+{
+public:
+    static constexpr size_t SHARDS = 16;
+
+private:
+    struct Run
+    {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        uint32_t capacity = 0;
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::vector<Run> runs; // by user id / SHARDS
+        std::vector<OrderId> ids;
+        size_t unused = 0; // slots no run covers
+    };
+
+    std::array<Shard, SHARDS> shards;
+
+    Shard& shardFor(UserId userId)
+    {
+        return shards[static_cast<size_t>(userId) % SHARDS];
+    }
+
+    const Shard& shardFor(UserId userId) const
+    {
+        return shards[static_cast<size_t>(userId) % SHARDS];
+    }
+
+    static size_t slotOf(UserId userId)
+    {
+        return static_cast<size_t>(userId) / SHARDS;
+    }
+
+    // Caller holds the shard exclusively. Packs the runs back to back with no room to spare.
+    static void compact(Shard& shard)
+    {
+        std::vector<OrderId> packed;
+        packed.reserve(shard.ids.size() - shard.unused);
+        for (Run& run : shard.runs)
+        {
+            const uint32_t offset = static_cast<uint32_t>(packed.size());
+            packed.insert(packed.end(), shard.ids.begin() + run.offset, shard.ids.begin() + run.offset + run.length);
+            run = { offset, run.length, run.length };
+        }
+        shard.ids.swap(packed);
+        shard.unused = 0;
+    }
+
+public:
+    // Replaces the histories with the given orders, each user's in the order
+    // they come. Not safe to call while other threads use the index.
+    template <typename Orders>
+    void build(const Orders& orders)
+    {
+        for (Shard& shard : shards)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.runs.clear();
+            shard.ids.clear();
+            shard.unused = 0;
+        }
+        for (const auto& order : orders)
+        {
+            Shard& shard = shardFor(order.getUserId());
+            const size_t slot = slotOf(order.getUserId());
+            if (slot >= shard.runs.size()) shard.runs.resize(slot + 1);
+            shard.runs[slot].length++;
+        }
+        for (Shard& shard : shards)
+        {
+            uint32_t offset = 0;
+            for (Run& run : shard.runs)
+            {
+                run = { offset, 0, run.length };
+                offset += run.capacity;
+            }
+            shard.ids.resize(offset);
+        }
+        for (const auto& order : orders)
+        {
+            Shard& shard = shardFor(order.getUserId());
+            Run& run = shard.runs[slotOf(order.getUserId())];
+            shard.ids[run.offset + run.length++] = order.getId();
+        }
+    }
+
+    void append(UserId userId, OrderId orderId)
+    {
+        Shard& shard = shardFor(userId);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        const size_t slot = slotOf(userId);
+        if (slot >= shard.runs.size()) shard.runs.resize(slot + 1);
+        Run* run = &shard.runs[slot];
+
+        if (run->offset + run->capacity == shard.ids.size())
+        {
+            // Last run in the pool: grow in place
+            if (run->length == run->capacity)
+            {
+                shard.ids.push_back(0);
+                run->capacity++;
+            }
+        }
+        else if (run->length == run->capacity)
+        {
+            if (shard.unused * 2 > shard.ids.size())
+            {
+                compact(shard);
+                run = &shard.runs[slot];
+            }
+            const uint32_t offset = static_cast<uint32_t>(shard.ids.size());
+            const uint32_t capacity = std::max<uint32_t>(4, run->length * 2);
+            shard.ids.resize(shard.ids.size() + capacity);
+            std::copy_n(shard.ids.begin() + run->offset, run->length, shard.ids.begin() + offset);
+            shard.unused += run->capacity;
+            run->offset = offset;
+            run->capacity = capacity;
+        }
+        shard.ids[run->offset + run->length++] = orderId;
+    }
+
+    // Calls f(std::span<const OrderId>) with the user's orders, oldest first,
+    // under the shard's shared lock
+    template <typename F>
+    void read(UserId userId, F&& f) const
+    {
+        const Shard& shard = shardFor(userId);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        const size_t slot = slotOf(userId);
+        if (slot >= shard.runs.size())
+        {
+            f(std::span<const OrderId>());
+            return;
+        }
+        const Run& run = shard.runs[slot];
+        f(std::span<const OrderId>(shard.ids.data() + run.offset, run.length));
+    }
+};
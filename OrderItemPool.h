@@ -0,0 +1,43 @@
+#pragma once
+#include <span>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "Arena.h"
+#include "config.h"
+
+// Line items of a store's orders, packed one after another in the blocks of
+// an Arena; an order keeps a span over its own. Items are appended once and
+// never change or move, so copies of an order share them and reading takes
+// no lock. Nothing is freed until the pool goes, all at once, so the pool
+// must outlive every order whose items it holds, copies included.
+class OrderItemPool
+{
+public:
+    static constexpr size_t FIRST_BLOCK = 64 * 1024;
+
+private:
+    Arena arena{FIRST_BLOCK};
+    std::atomic<uint64_t> count{0};
+
+public:
+    OrderItemPool() = default;
+
+    OrderItemPool(const OrderItemPool&) = delete;
+    OrderItemPool& operator=(const OrderItemPool&) = delete;
+
+    std::span<const CartItem> append(std::span<const CartItem> items)
+    {
+        if (items.empty()) return {};
+        CartItem* placed = static_cast<CartItem*>(arena.allocate(items.size_bytes(), alignof(CartItem)));
+        std::uninitialized_copy(items.begin(), items.end(), placed);
+        count.fetch_add(items.size(), std::memory_order_relaxed);
+        return { placed, items.size() };
+    }
+
+    // Items appended so far
+    uint64_t size() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+};
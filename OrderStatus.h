@@ -0,0 +1,52 @@
+#pragma once
+#include <string_view>
+#include <cctype>
+#include <cstdint>
+
+// Where an order is in its life. Stored in one byte; the values are written
+// to disk, so new ones go at the end.
+enum class OrderStatus : uint8_t { PENDING, PAID, SHIPPED, DELIVERED, REFUNDED, CANCELLED };
+
+constexpr size_t ORDER_STATUS_COUNT = 6;
+
+// Bit `to` of entry `from` is set when an order may move from `from` to `to`:
+// Pending -> Paid -> Shipped -> Delivered, and a refund from anywhere it has
+// not happened yet. Orders are cancelled before they ship; a cancelled order
+// can still be refunded.
+constexpr uint8_t ORDER_TRANSITIONS[ORDER_STATUS_COUNT] = {
+    /* PENDING   */ 1 << static_cast<int>(OrderStatus::PAID) | 1 << static_cast<int>(OrderStatus::REFUNDED) | 1 << static_cast<int>(OrderStatus::CANCELLED),
+    /* PAID      */ 1 << static_cast<int>(OrderStatus::SHIPPED) | 1 << static_cast<int>(OrderStatus::REFUNDED) | 1 << static_cast<int>(OrderStatus::CANCELLED),
+    /* SHIPPED   */ 1 << static_cast<int>(OrderStatus::DELIVERED) | 1 << static_cast<int>(OrderStatus::REFUNDED),
+    /* DELIVERED */ 1 << static_cast<int>(OrderStatus::REFUNDED),
+    /* REFUNDED  */ 0,
+    /* CANCELLED */ 1 << static_cast<int>(OrderStatus::REFUNDED),
+};
+
+constexpr bool canTransition(OrderStatus from, OrderStatus to)
+{
+    return (ORDER_TRANSITIONS[static_cast<size_t>(from)] >> static_cast<int>(to)) & 1;
+}
+
+inline const char* orderStatusName(OrderStatus status)
+{
+    static const char* const names[ORDER_STATUS_COUNT] = { "Pending", "Paid", "Shipped", "Delivered", "Refunded", "Cancelled" };
+    return names[static_cast<size_t>(status)];
+}
+
+// Accepts the names above in any case
+inline bool parseOrderStatus(std::string_view text, OrderStatus& status)
+{
+    for (size_t i = 0; i < ORDER_STATUS_COUNT; ++i)
+    {
+        std::string_view name = orderStatusName(static_cast<OrderStatus>(i));
+        if (name.size() != text.size()) continue;
+        size_t c = 0;
+        while (c < name.size() && std::tolower(static_cast<unsigned char>(name[c])) == std::tolower(static_cast<unsigned char>(text[c]))) ++c;
+        if (c == name.size())
+        {
+            status = static_cast<OrderStatus>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include "OrderStatus.h"
+#include "config.h"
+
+// The orders in each status, so listing, say, the pending ones touches only
+// those rather than every order. Each status keeps an unordered list of ids
+// and each order remembers its place in its list, so adding an order or
+// moving it to another status is O(1): a move swaps the last id of the old
+// list into the gap. Orders are spread over SHARDS shards by id, each with
+// its own lock. Per-status counts are kept beside the lists and read without
+// a lock.
+//
+// The index does not own the statuses. Callers add an order before it can
+// be looked up and move it while holding the order's lock, right after
+// changing it, so a listing may be a moment behind the orders but never
+// loses one.
+class OrderStatusIndex
+{
+public:
+    static constexpr size_t SHARDS = 16;
+
+private:
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::array<std::vector<OrderId>, ORDER_STATUS_COUNT> members;
+        std::vector<uint32_t> positions; // by order id / SHARDS, in its status's list
+    };
+
+    std::array<Shard, SHARDS> shards;
+    std::array<std::atomic<size_t>, ORDER_STATUS_COUNT> counts{};
+
+    Shard& shardFor(OrderId orderId)
+    {
+        return shards[static_cast<size_t>(orderId) % SHARDS];
+    }
+
+    static size_t slotOf(OrderId orderId)
+    {
+        return static_cast<size_t>(orderId) / SHARDS;
+    }
+
+public:
+    // Replaces the index with the given orders. Not safe to call while other
+    // threads use the index.
+    template <typename Orders>
+    void build(const Orders& orders)
+    {
+        for (Shard& shard : shards)
+        {
+            for (auto& ids : shard.members) ids.clear();
+            shard.positions.clear();
+        }
+        for (auto& count : counts) count.store(0);
+        for (const auto& order : orders) add(order.getId(), order.getStatus());
+    }
+
+    void add(OrderId orderId, OrderStatus status)
+    {
+        Shard& shard = shardFor(orderId);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        const size_t slot = slotOf(orderId);
+        if (slot >= shard.positions.size()) shard.positions.resize(slot + 1);
+        std::vector<OrderId>& ids = shard.members[static_cast<size_t>(status)];
+        shard.positions[slot] = static_cast<uint32_t>(ids.size());
+        ids.push_back(orderId);
+        counts[static_cast<size_t>(status)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // `orderId` must have been added with status `from`
+    void move(OrderId orderId, OrderStatus from, OrderStatus to)
+    {
+        if (from == to) return;
+        Shard& shard = shardFor(orderId);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        const size_t slot = slotOf(orderId);
+        std::vector<OrderId>& old = shard.members[static_cast<size_t>(from)];
+        const uint32_t position = shard.positions[slot];
+        old[position] = old.back();
+        shard.positions[slotOf(old[position])] = position;
+        old.pop_back();
+
+        std::vector<OrderId>& ids = shard.members[static_cast<size_t>(to)];
+        shard.positions[slot] = static_cast<uint32_t>(ids.size());
+        ids.push_back(orderId);
+        counts[static_cast<size_t>(from)].fetch_sub(1, std::memory_order_relaxed);
+        counts[static_cast<size_t>(to)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t count(OrderStatus status) const
+    {
+        return counts[static_cast<size_t>(status)].load(std::memory_order_relaxed);
+    }
+
+    // Ids of the orders in `status`, lowest first
+    std::vector<OrderId> list(OrderStatus status) const
+    {
+        std::vector<OrderId> result;
+        result.reserve(count(status));
+        for (const Shard& shard : shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            const std::vector<OrderId>& ids = shard.members[static_cast<size_t>(status)];
+            result.insert(result.end(), ids.begin(), ids.end());
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+};
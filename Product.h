@@ -1,134 +1,399 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include "config.h"
+#include "Logger.h"
+#include "StringInterner.h"
 
-class Product 
+// The fields that stock, price and seller scans read, packed so that a scan
+// over the catalog reads 24 bytes per product (see ProductCatalog::forEachHot)
+struct ProductHot 
+{
+    ProductId id = 0;
+    UserId sellerId = 0;
+    std::atomic<int> stock{0}; // changed concurrently by checkouts, see tryReserve
+    std::atomic<int> held{0}; // units set aside by cart holds, not part of stock
+    std::atomic<double> price{0.0};
+};
+
+static_assert(sizeof(ProductHot) == 24, "ProductHot is sized for dense catalog scans");
+
+// The rest of a product, read when it is shown, searched or repriced.
+// Categories are interned, being shared by many products; names are mostly
+// unique and only interned once the product sells (see getNameId).
+struct ProductCold 
 {
-private:
-    ProductId id;
     std::string name;
-    double price;
-    std::string category;
-    int stock;
-    UserId sellerId;
+    StringId category = 0;
+    std::atomic<StringId> nameId{0}; // the interned name, 0 until first asked for
+    std::atomic<uint64_t> version{0}; // price version, odd while a new price is being stored; see readPrice
+    std::atomic<bool> reindex{false}; // changed since the sorted indexes last looked; not copied
+};
+
+// A product whose hot and cold parts live apart, as in the catalog. Copying
+// a ProductRef copies the reference; to keep a product, copy it into a Product.
+class ProductRef 
+{
+protected:
+    ProductHot* hot;
+    ProductCold* cold;
 
 public:
-    Product() : id(0), name("Unknown"), price(0.0), category("Misc"), stock(0), sellerId(0) {}
-    
-    Product(ProductId id, const std::string& name, double price, const std::string& category, int stock, UserId sellerId = 0) : id(id), name(name), price(price), category(category), stock(stock), sellerId(sellerId) {}
+    ProductRef(ProductHot* hot, ProductCold* cold) : hot(hot), cold(cold) {}
+
+private:
+    void assignAllButName(const ProductRef& other) 
+    {
+        hot->id = other.hot->id;
+        hot->sellerId = other.hot->sellerId;
+        hot->stock.store(other.getStock());
+        hot->held.store(other.getHeld());
+        hot->price.store(other.getPrice());
+        cold->category = other.cold->category;
+        cold->nameId.store(other.cold->nameId.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        cold->version.store(other.getVersion() & ~uint64_t{1});
+    }
+
+public:
+    // Overwrites the referenced product with the values of `other`
+    void assign(const ProductRef& other) 
+    {
+        assignAllButName(other);
+        cold->name = other.cold->name;
+    }
+
+    // As above, taking the name from `other`
+    void assign(ProductRef&& other) 
+    {
+        assignAllButName(other);
+        cold->name = std::move(other.cold->name);
+    }
 
     ProductId getId() const 
     { 
-        return id; 
+        return hot->id; 
     }
-    std::string getName() const 
+    std::string_view getName() const 
     { 
-        return name; 
+        return cold->name; 
+    }
+
+    // The name as an interned string, e.g. for sales to refer to; interned
+    // on first use, so products that never sell cost the interner nothing
+    StringId getNameId() const 
+    { 
+        StringId id = cold->nameId.load(std::memory_order_relaxed);
+        if (id == 0) 
+        {
+            id = intern(cold->name);
+            cold->nameId.store(id, std::memory_order_relaxed);
+        }
+        return id; 
     }
     double getPrice() const 
     { 
-        return price; 
+        return hot->price.load(std::memory_order_acquire); 
     }
-    std::string getCategory() const 
+    uint64_t getVersion() const 
     { 
-        return category; 
+        return cold->version.load(std::memory_order_acquire); 
+    }
+
+    // Reads the price together with the version it belongs to, for optimistic
+    // checkout: if readPrice() later returns the same version, the price has
+    // not changed in between. Retries while a new price is being stored.
+    double readPrice(uint64_t& readVersion) const 
+    {
+        while (true) 
+        {
+            uint64_t before = getVersion();
+            double value = getPrice();
+            if ((before & 1) == 0 && getVersion() == before) 
+            {
+                readVersion = before;
+                return value;
+            }
+        }
+    }
+    std::string_view getCategory() const 
+    { 
+        return internedText(cold->category); 
+    }
+    StringId getCategoryId() const 
+    { 
+        return cold->category; 
     }
     int getStock() const 
     { 
-        return stock; 
+        return hot->stock.load(); 
+    }
+    int getHeld() const 
+    { 
+        return hot->held.load(); 
     }
     UserId getSellerId() const 
     { 
-        return sellerId; 
+        return hot->sellerId; 
+    }
+
+    // Flags the product for the sorted indexes; true if it was not flagged yet
+    bool markForReindex() 
+    { 
+        return !cold->reindex.load(std::memory_order_relaxed) && !cold->reindex.exchange(true, std::memory_order_acq_rel); 
+    }
+
+    // Clears the flag before the indexes read the new values, so a change made
+    // meanwhile flags the product again
+    void clearReindex() 
+    { 
+        cold->reindex.exchange(false, std::memory_order_acq_rel); 
     }
 
     void setStock(int newStock) 
     { 
-        if (newStock >= 0) stock = newStock; 
+        if (newStock >= 0) hot->stock.store(newStock); 
     }
     
+    // Lock-free for readers. The version goes odd while the price is stored
+    // and even again after, so concurrent repricings take turns.
     void setPrice(double newPrice) 
     { 
-        if (newPrice >= 0) price = newPrice; 
+        if (newPrice < 0) return;
+        uint64_t version = cold->version.load(std::memory_order_relaxed);
+        do 
+        {
+            version &= ~uint64_t{1};
+        } while (!cold->version.compare_exchange_weak(version, version + 1, std::memory_order_acquire, std::memory_order_relaxed));
+        hot->price.store(newPrice, std::memory_order_release);
+        cold->version.store(version + 2, std::memory_order_release);
     }
 
-    void setName(const std::string& newName) 
+    void setName(std::string newName) 
     { 
-        if (!newName.empty()) name = newName; 
+        if (newName.empty()) return;
+        cold->name = std::move(newName);
+        cold->nameId.store(0, std::memory_order_relaxed); 
     }
 
-    bool reduceStock(int quantity) 
+    // Takes `quantity` units if that many are available. Lock-free and safe to
+    // call from several threads on the same product.
+    bool tryReserve(int quantity) 
     {
-        if (quantity > 0 && stock >= quantity) 
+        if (quantity <= 0) return false;
+        int current = hot->stock.load(std::memory_order_relaxed);
+        while (current >= quantity) 
         {
-            stock -= quantity;
-            return true;
+            if (hot->stock.compare_exchange_weak(current, current - quantity, std::memory_order_acq_rel, std::memory_order_relaxed)) 
+            {
+                return true;
+            }
         }
-        std::cout << "Insufficient stock for product '" << name << "'. Available: " << stock << "\n";
         return false;
     }
 
+    // Takes as many of `quantity` units as are available; returns how many
+    int takeUpTo(int quantity) 
+    {
+        if (quantity <= 0) return 0;
+        int current = hot->stock.load(std::memory_order_relaxed);
+        while (current > 0) 
+        {
+            int taken = std::min(current, quantity);
+            if (hot->stock.compare_exchange_weak(current, current - taken, std::memory_order_acq_rel, std::memory_order_relaxed)) 
+            {
+                return taken;
+            }
+        }
+        return 0;
+    }
+
+    // Gives back units taken by tryReserve or takeUpTo
+    void release(int quantity) 
+    {
+        if (quantity > 0) hot->stock.fetch_add(quantity, std::memory_order_acq_rel);
+    }
+
+    // Cart holds move units from stock to `held`: getStock() stays what anyone
+    // can still buy, getHeld() what carts are keeping for their owners.
+    bool hold(int quantity) 
+    {
+        if (!tryReserve(quantity)) return false;
+        hot->held.fetch_add(quantity, std::memory_order_acq_rel);
+        return true;
+    }
+
+    // An expired or abandoned hold goes back on sale
+    void releaseHold(int quantity) 
+    {
+        if (quantity <= 0) return;
+        hot->held.fetch_sub(quantity, std::memory_order_acq_rel);
+        hot->stock.fetch_add(quantity, std::memory_order_acq_rel);
+    }
+
+    // Held units were sold; they are already out of stock
+    void consumeHold(int quantity) 
+    {
+        if (quantity > 0) hot->held.fetch_sub(quantity, std::memory_order_acq_rel);
+    }
+
+    // Undoes consumeHold when a checkout is rolled back
+    void reinstateHold(int quantity) 
+    {
+        if (quantity > 0) hot->held.fetch_add(quantity, std::memory_order_acq_rel);
+    }
+
     void restock(int quantity) 
     {
         if (quantity > 0) 
         {
-            stock += quantity;
-            std::cout << "Restocked " << quantity << " units of '" << name << "'. New stock: " << stock << "\n";
+            int newStock = hot->stock.fetch_add(quantity, std::memory_order_acq_rel) + quantity;
+            LOG_DEBUG("product", "restocked %d units of '%s', stock now %d", quantity, cold->name.c_str(), newStock);
         }
     }
 
     bool isInStock() const 
     { 
-        return stock > 0; 
+        return getStock() > 0; 
     }
 
     void display() const 
     {
-        std::cout << "ID: " << id << " | " << name << " | $" << price << " | Stock: " << stock << " | Category: " << category << " | Seller: " << sellerId << "\n";
+        std::cout << "ID: " << hot->id << " | " << cold->name << " | $" << getPrice() << " | Stock: " << getStock();
+        if (getHeld() > 0) std::cout << " (+" << getHeld() << " held)";
+        std::cout << " | Category: " << getCategory() << " | Seller: " << hot->sellerId << "\n";
     }
 
-    void writeToStream(std::ostream& os) const 
+    // Categories go into the file's dictionary, once per file
+    void addStrings(StringDictionaryWriter& dictionary) const 
     {
-        os.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        dictionary.add(cold->category);
+    }
+
+    void writeToStream(std::ostream& os, const StringDictionaryWriter& dictionary) const 
+    {
+        os.write(reinterpret_cast<const char*>(&hot->id), sizeof(hot->id));
         
-        size_t len = name.size();
+        size_t len = cold->name.size();
         os.write(reinterpret_cast<const char*>(&len), sizeof(len));
-        os.write(name.c_str(), len);
+        os.write(cold->name.c_str(), len);
         
-        os.write(reinterpret_cast<const char*>(&price), sizeof(price));
+        double priceValue = getPrice();
+        os.write(reinterpret_cast<const char*>(&priceValue), sizeof(priceValue));
         
-        len = category.size();
-        os.write(reinterpret_cast<const char*>(&len), sizeof(len));
-        os.write(category.c_str(), len);
+        uint32_t category = dictionary.positionOf(cold->category);
+        os.write(reinterpret_cast<const char*>(&category), sizeof(category));
         
-        os.write(reinterpret_cast<const char*>(&stock), sizeof(stock));
-        os.write(reinterpret_cast<const char*>(&sellerId), sizeof(sellerId));
+        // Holds are not persisted, so held units are saved as ordinary stock
+        int stockValue = getStock() + getHeld();
+        os.write(reinterpret_cast<const char*>(&stockValue), sizeof(stockValue));
+        os.write(reinterpret_cast<const char*>(&hot->sellerId), sizeof(hot->sellerId));
     }
 
-    void readFromStream(std::istream& is) 
+    // Format 1 files hold the category text in every record; later formats
+    // hold its position in `dictionary`
+    void readFromStream(std::istream& is, int format, const StringDictionaryReader& dictionary) 
     {
-        is.read(reinterpret_cast<char*>(&id), sizeof(id));
+        is.read(reinterpret_cast<char*>(&hot->id), sizeof(hot->id));
         
         size_t len;
         is.read(reinterpret_cast<char*>(&len), sizeof(len));
         if (len > 0 && len < 1000) 
         {
-            name.resize(len);
-            is.read(&name[0], len);
+            cold->name.resize(len);
+            is.read(&cold->name[0], len);
+            cold->nameId.store(0, std::memory_order_relaxed);
         }
         
-        is.read(reinterpret_cast<char*>(&price), sizeof(price));
+        double priceValue = 0.0;
+        is.read(reinterpret_cast<char*>(&priceValue), sizeof(priceValue));
+        hot->price.store(priceValue);
         
-        is.read(reinterpret_cast<char*>(&len), sizeof(len));
-        if (len > 0 && len < 1000) 
+        if (format == 1) 
         {
-            category.resize(len);
-            is.read(&category[0], len);
+            is.read(reinterpret_cast<char*>(&len), sizeof(len));
+            if (len > 0 && len < 1000) 
+            {
+                std::string category(len, '\0');
+                is.read(&category[0], len);
+                cold->category = intern(category);
+            }
+        }
+        else 
+        {
+            uint32_t position = 0;
+            is.read(reinterpret_cast<char*>(&position), sizeof(position));
+            if (dictionary.idAt(position) != 0) cold->category = dictionary.idAt(position);
         }
         
-        is.read(reinterpret_cast<char*>(&stock), sizeof(stock));
-        is.read(reinterpret_cast<char*>(&sellerId), sizeof(sellerId));
+        int stockValue = 0;
+        is.read(reinterpret_cast<char*>(&stockValue), sizeof(stockValue));
+        hot->stock.store(stockValue);
+        is.read(reinterpret_cast<char*>(&hot->sellerId), sizeof(hot->sellerId));
+    }
+};
+
+// A product that owns its parts: what is built, loaded, saved and handed out
+// by value. The catalog keeps its own copy of each part.
+class Product : public ProductRef 
+{
+private:
+    ProductHot hotPart;
+    ProductCold coldPart;
+
+public:
+    Product() : ProductRef(&hotPart, &coldPart) 
+    {
+        static const StringId misc = intern("Misc");
+        coldPart.name = "Unknown";
+        coldPart.category = misc;
+    }
+    
+    Product(ProductId id, std::string name, double price, std::string_view category, int stock, UserId sellerId = 0) : ProductRef(&hotPart, &coldPart) 
+    {
+        hotPart.id = id;
+        hotPart.sellerId = sellerId;
+        hotPart.stock.store(stock);
+        hotPart.price.store(price);
+        coldPart.name = std::move(name);
+        coldPart.category = intern(category);
+    }
+
+    // Explicit so that a catalog callback taking a Product by mistake fails to
+    // compile instead of copying every product it visits
+    explicit Product(const ProductRef& other) : ProductRef(&hotPart, &coldPart) 
+    {
+        assign(other);
+    }
+
+    Product(const Product& other) : ProductRef(&hotPart, &coldPart) 
+    {
+        assign(other);
+    }
+
+    Product(Product&& other) noexcept : ProductRef(&hotPart, &coldPart) 
+    {
+        assign(std::move(other));
+    }
+
+    Product& operator=(const ProductRef& other) 
+    {
+        if (&other != this) assign(other);
+        return *this;
+    }
+
+    Product& operator=(const Product& other) 
+    {
+        if (&other != this) assign(other);
+        return *this;
+    }
+
+    Product& operator=(Product&& other) noexcept 
+    {
+        if (&other != this) assign(std::move(other));
+        return *this;
     }
 };
\ No newline at end of file
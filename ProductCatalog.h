@@ -0,0 +1,304 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include "Product.h"
+#include "Epoch.h"
+#include "config.h"
+
+// Product catalog published as immutable snapshots (read-copy-update).
+//
+// Readers load the current snapshot inside an EpochGuard and never lock, so
+// browsing and lookups are not slowed down by sellers adding products. Writers
+// serialise among themselves, build the next snapshot and swap it in; the old
+// one is reclaimed once no reader can still see it.
+//
+// Products are stored by id in slabs of CHUNK_SIZE slots, split hot and cold:
+// a dense array of 24-byte ProductHot records (id, seller, stock, held, price)
+// and a side array of ProductCold (name, category, price version) in the same slot.
+// Stock and price scans walk the hot arrays only. Slabs never move; stock and
+// price are atomics and are updated in place without a new snapshot.
+//
+// A snapshot is a directory of chunks, each naming a slab and which of its
+// slots are published. Chunks are reference-counted and shared between
+// versions, so publishing a new product copies the directory and one small
+// chunk rather than the whole catalog. Every insert and modification queues
+// the product id once for the sorted indexes (see ProductIndex).
+class ProductCatalog
+{
+private:
+    static constexpr size_t CHUNK_SIZE = 1024;
+
+    struct Slab
+    {
+        std::array<ProductHot, CHUNK_SIZE> hot;
+        std::array<ProductCold, CHUNK_SIZE> cold;
+    };
+
+    struct Chunk
+    {
+        Slab* slab = nullptr;
+        std::bitset<CHUNK_SIZE> present;
+    };
+
+    struct Snapshot
+    {
+        std::vector<std::shared_ptr<const Chunk>> chunks;
+        size_t count = 0;
+
+        bool find(ProductId id, ProductRef& product) const
+        {
+            if (id < 0) return false;
+            size_t chunk = static_cast<size_t>(id) / CHUNK_SIZE;
+            size_t slot = static_cast<size_t>(id) % CHUNK_SIZE;
+            if (chunk >= chunks.size() || !chunks[chunk] || !chunks[chunk]->present[slot]) return false;
+            product = ProductRef(&chunks[chunk]->slab->hot[slot], &chunks[chunk]->slab->cold[slot]);
+            return true;
+        }
+
+        bool contains(ProductId id) const
+        {
+            ProductRef unused(nullptr, nullptr);
+            return find(id, unused);
+        }
+    };
+
+    static constexpr size_t CHANGE_SHARDS = 16;
+
+    // Ids of products added or modified since the last takeChanged()
+    struct alignas(64) ChangeShard
+    {
+        std::mutex mutex;
+        std::vector<ProductId> ids;
+    };
+
+    std::atomic<const Snapshot*> current;
+    std::mutex writeMutex;
+    std::vector<std::unique_ptr<Slab>> slabs; // by chunk; only touched by writers
+    std::array<ChangeShard, CHANGE_SHARDS> changes;
+
+    // A product is queued once however often it changes before the next takeChanged()
+    void noteChanged(ProductRef& p)
+    {
+        if (!p.markForReindex()) return;
+        ChangeShard& shard = changes[static_cast<size_t>(p.getId()) % CHANGE_SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.ids.push_back(p.getId());
+    }
+
+    // Writes `product` into its slot, which no published snapshot shows yet.
+    // Caller holds writeMutex.
+    ProductRef store(const ProductRef& product)
+    {
+        size_t chunk = static_cast<size_t>(product.getId()) / CHUNK_SIZE;
+        size_t slot = static_cast<size_t>(product.getId()) % CHUNK_SIZE;
+        if (chunk >= slabs.size()) slabs.resize(chunk + 1);
+        if (!slabs[chunk]) slabs[chunk] = std::make_unique<Slab>();
+        ProductRef stored(&slabs[chunk]->hot[slot], &slabs[chunk]->cold[slot]);
+        stored.assign(product);
+        return stored;
+    }
+
+    // Copies `base` and publishes the stored `added` ids in it; chunks that are not written are shared
+    Snapshot* extend(const Snapshot& base, const std::vector<ProductId>& added) const
+    {
+        Snapshot* next = new Snapshot(base);
+        std::vector<Chunk*> writable(next->chunks.size(), nullptr); // chunks already copied for this version
+        for (ProductId id : added)
+        {
+            size_t chunk = static_cast<size_t>(id) / CHUNK_SIZE;
+            if (chunk >= next->chunks.size())
+            {
+                next->chunks.resize(chunk + 1);
+                writable.resize(chunk + 1, nullptr);
+            }
+            if (!writable[chunk])
+            {
+                auto fresh = next->chunks[chunk] ? std::make_shared<Chunk>(*next->chunks[chunk]) : std::make_shared<Chunk>();
+                fresh->slab = slabs[chunk].get();
+                writable[chunk] = fresh.get();
+                next->chunks[chunk] = fresh;
+            }
+            writable[chunk]->present.set(static_cast<size_t>(id) % CHUNK_SIZE);
+            next->count++;
+        }
+        return next;
+    }
+
+    void publish(const Snapshot* next)
+    {
+        const Snapshot* previous = current.exchange(next);
+        EpochDomain::instance().retire(previous);
+    }
+
+public:
+    ProductCatalog() : current(new Snapshot()) {}
+
+    ~ProductCatalog()
+    {
+        delete current.load();
+    }
+
+    ProductCatalog(const ProductCatalog&) = delete;
+    ProductCatalog& operator=(const ProductCatalog&) = delete;
+
+    // Returns false if a product with that id already exists
+    bool insert(ProductId id, const Product& product)
+    {
+        if (id < 0 || id != product.getId()) return false;
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const Snapshot* base = current.load();
+        if (base->contains(id)) return false;
+
+        ProductRef stored = store(product);
+        publish(extend(*base, { id }));
+        noteChanged(stored);
+        return true;
+    }
+
+    // Publishes many products as one new version; duplicates and bad ids are skipped
+    size_t insertBatch(const std::vector<Product>& batch)
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const Snapshot* base = current.load();
+        std::vector<ProductId> added;
+        std::vector<ProductRef> stored;
+        added.reserve(batch.size());
+        stored.reserve(batch.size());
+        std::vector<bool> seen;
+        for (const auto& product : batch)
+        {
+            ProductId id = product.getId();
+            if (id < 0 || base->contains(id)) continue;
+            if (static_cast<size_t>(id) >= seen.size()) seen.resize(static_cast<size_t>(id) + 1, false);
+            if (seen[id]) continue;
+            seen[id] = true;
+
+            stored.push_back(store(product));
+            added.push_back(id);
+        }
+
+        if (!added.empty()) publish(extend(*base, added));
+        for (ProductRef& p : stored) noteChanged(p);
+        return added.size();
+    }
+
+    template <typename F>
+    bool read(ProductId id, F&& f) const
+    {
+        EpochGuard guard;
+        ProductRef p(nullptr, nullptr);
+        if (!current.load()->find(id, p)) return false;
+        f(static_cast<const ProductRef&>(p));
+        return true;
+    }
+
+    // For updates of the atomic fields (stock, price); no lock is taken
+    template <typename F>
+    bool modifyConcurrent(ProductId id, F&& f)
+    {
+        EpochGuard guard;
+        ProductRef p(nullptr, nullptr);
+        if (!current.load()->find(id, p)) return false;
+        f(p);
+        noteChanged(p);
+        return true;
+    }
+
+    // Looks up many products against one version: f(index, ProductRef*) for each
+    // of `ids`, with nullptr for unknown ids. Sorted ids walk the chunks in order.
+    template <typename F>
+    void modifyBatch(const std::vector<ProductId>& ids, F&& f)
+    {
+        EpochGuard guard;
+        const Snapshot* snapshot = current.load();
+        ProductRef p(nullptr, nullptr);
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            bool found = snapshot->find(ids[i], p);
+            f(i, found ? &p : nullptr);
+            if (found) noteChanged(p);
+        }
+    }
+
+    // Moves the ids of products added or modified since the last call into
+    // `ids` (each once) and clears their flags. Values read after this call are
+    // at least as new as the changes reported.
+    void takeChanged(std::vector<ProductId>& ids)
+    {
+        ids.clear();
+        for (ChangeShard& shard : changes)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ids.insert(ids.end(), shard.ids.begin(), shard.ids.end());
+            shard.ids.clear();
+        }
+
+        EpochGuard guard;
+        const Snapshot* snapshot = current.load();
+        ProductRef p(nullptr, nullptr);
+        for (ProductId id : ids)
+        {
+            if (snapshot->find(id, p)) p.clearReindex();
+        }
+    }
+
+    // Visits every product of one consistent version, in id order
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        EpochGuard guard;
+        const Snapshot* snapshot = current.load();
+        for (const auto& chunk : snapshot->chunks)
+        {
+            if (!chunk) continue;
+            for (size_t slot = 0; slot < CHUNK_SIZE; ++slot)
+            {
+                if (!chunk->present[slot]) continue;
+                const ProductRef p(&chunk->slab->hot[slot], &chunk->slab->cold[slot]);
+                f(p.getId(), p);
+            }
+        }
+    }
+
+    // Visits the hot record of every product of one version, in id order,
+    // without touching names or categories: for stock, price and seller scans
+    template <typename F>
+    void forEachHot(F&& f) const
+    {
+        EpochGuard guard;
+        const Snapshot* snapshot = current.load();
+        for (const auto& chunk : snapshot->chunks)
+        {
+            if (!chunk) continue;
+            const ProductHot* hot = chunk->slab->hot.data();
+            if (chunk->present.all())
+            {
+                for (size_t slot = 0; slot < CHUNK_SIZE; ++slot) f(hot[slot]);
+                continue;
+            }
+            for (size_t slot = 0; slot < CHUNK_SIZE; ++slot)
+            {
+                if (chunk->present[slot]) f(hot[slot]);
+            }
+        }
+    }
+
+    // Copy of every product, ordered by id
+    std::vector<Product> sortedValues() const
+    {
+        std::vector<Product> result;
+        result.reserve(size());
+        forEach([&result](ProductId, const ProductRef& p) { result.emplace_back(p); });
+        return result;
+    }
+
+    size_t size() const
+    {
+        EpochGuard guard;
+        return current.load()->count;
+    }
+};
@@ -0,0 +1,397 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <charconv>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Product.h"
+#include "config.h"
+
+#ifdef _WIN32
+#include <sstream>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct ImportError
+{
+    size_t line; // 1-based line in the file
+    std::string message;
+};
+
+struct ImportReport
+{
+    size_t rows = 0; // data rows, not counting the header or blank lines
+    size_t imported = 0;
+    size_t rejected = 0;
+    ProductId firstId = 0; // imported products get firstId..lastId in file order
+    ProductId lastId = 0;
+    std::vector<ImportError> errors; // the first MAX_IMPORT_ERRORS, in line order
+};
+
+// Read-only view of a whole file: memory-mapped where mmap exists, read into
+// memory otherwise
+class MappedFile
+{
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::string buffer;
+#else
+    void* mapping = nullptr;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path)
+    {
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return;
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        buffer = contents.str();
+        bytes = buffer.data();
+        length = buffer.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (::fstat(fd, &info) == 0)
+        {
+            if (info.st_size == 0)
+            {
+                bytes = "";
+            }
+            else
+            {
+                void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED)
+                {
+                    ::madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+                    mapping = mapped;
+                    bytes = static_cast<const char*>(mapped);
+                    length = static_cast<size_t>(info.st_size);
+                }
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (mapping) ::munmap(mapping, length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const
+    {
+        return bytes != nullptr;
+    }
+
+    const char* data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+};
+
+// Parallel parser for product catalogs in CSV or TSV.
+//
+// Columns are name, price, category, stock. A first line naming the columns
+// may give them in any order; without one that order is assumed. The file is
+// tab-separated if its first line contains a tab. Fields may be quoted with
+// "..." ("" for a quote) but must not span lines: the file is cut into one
+// chunk per thread at newline boundaries and every chunk is parsed on its own.
+class ProductImport
+{
+public:
+    struct Row
+    {
+        std::string name;
+        std::string category;
+        double price;
+        int stock;
+    };
+
+    // Rows and errors of one chunk; error lines are relative to the chunk until merged
+    struct Chunk
+    {
+        std::vector<Row> rows;
+        std::vector<ImportError> errors;
+        size_t lines = 0;
+        size_t rejected = 0;
+    };
+
+private:
+    static constexpr size_t FIELDS = 4;
+    static constexpr size_t MAX_TEXT = 999; // longer names are not read back from the data files
+
+    struct Field
+    {
+        std::string_view text;
+        bool escaped; // contains "" pairs to collapse
+    };
+
+    struct Layout
+    {
+        char delimiter = ',';
+        size_t column[FIELDS] = { 0, 1, 2, 3 }; // position of name, price, category, stock
+        size_t width = FIELDS;
+    };
+
+    static std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+        return text;
+    }
+
+    // Splits one line (without its newline); false on an unterminated quote
+    static bool split(std::string_view line, char delimiter, std::vector<Field>& fields)
+    {
+        fields.clear();
+        size_t i = 0;
+        for (;;)
+        {
+            while (i < line.size() && line[i] == ' ') ++i;
+            if (i < line.size() && line[i] == '"')
+            {
+                size_t start = ++i;
+                bool escaped = false;
+                for (;; ++i)
+                {
+                    if (i >= line.size()) return false;
+                    if (line[i] != '"') continue;
+                    if (i + 1 < line.size() && line[i + 1] == '"')
+                    {
+                        escaped = true;
+                        ++i;
+                        continue;
+                    }
+                    break;
+                }
+                fields.push_back({ line.substr(start, i - start), escaped });
+                ++i;
+                while (i < line.size() && line[i] != delimiter) ++i; // anything after the closing quote is dropped
+            }
+            else
+            {
+                size_t end = line.find(delimiter, i);
+                if (end == std::string_view::npos) end = line.size();
+                fields.push_back({ trim(line.substr(i, end - i)), false });
+                i = end;
+            }
+
+            if (i >= line.size()) return true;
+            ++i; // delimiter
+        }
+    }
+
+    static std::string text(const Field& field)
+    {
+        if (!field.escaped) return std::string(field.text);
+        std::string result;
+        result.reserve(field.text.size());
+        for (size_t i = 0; i < field.text.size(); ++i)
+        {
+            result += field.text[i];
+            if (field.text[i] == '"' && i + 1 < field.text.size() && field.text[i + 1] == '"') ++i;
+        }
+        return result;
+    }
+
+    template <typename T>
+    static bool number(std::string_view text, T& value)
+    {
+        text = trim(text);
+        if (text.empty()) return false;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
+
+    static bool parseHeader(std::string_view line, Layout& layout)
+    {
+        std::vector<Field> fields;
+        if (!split(line, layout.delimiter, fields)) return false;
+        static const char* const names[FIELDS] = { "name", "price", "category", "stock" };
+        bool found[FIELDS] = {};
+        for (size_t i = 0; i < fields.size(); ++i)
+        {
+            std::string name(trim(fields[i].text));
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            for (size_t f = 0; f < FIELDS; ++f)
+            {
+                if (name == names[f])
+                {
+                    layout.column[f] = i;
+                    found[f] = true;
+                }
+            }
+        }
+        layout.width = fields.size();
+        return std::all_of(std::begin(found), std::end(found), [](bool f) { return f; });
+    }
+
+    static void reject(Chunk& chunk, size_t line, const char* message)
+    {
+        chunk.rejected++;
+        if (chunk.errors.size() < MAX_IMPORT_ERRORS) chunk.errors.push_back({ line, message });
+    }
+
+    static void parseChunk(const char* begin, const char* end, const Layout& layout, Chunk& chunk)
+    {
+        std::vector<Field> fields;
+        chunk.rows.reserve(static_cast<size_t>(end - begin) / 32);
+        for (const char* line = begin; line < end;)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(line, '\n', static_cast<size_t>(end - line)));
+            const char* lineEnd = newline ? newline : end;
+            std::string_view view(line, static_cast<size_t>(lineEnd - line));
+            line = newline ? newline + 1 : end;
+            size_t lineNumber = ++chunk.lines;
+
+            if (trim(view).empty()) continue;
+            if (!split(view, layout.delimiter, fields))
+            {
+                reject(chunk, lineNumber, "unterminated quote");
+                continue;
+            }
+            if (fields.size() < layout.width)
+            {
+                reject(chunk, lineNumber, "missing fields");
+                continue;
+            }
+
+            Row row;
+            if (!number(fields[layout.column[1]].text, row.price) || !std::isfinite(row.price) || row.price < 0)
+            {
+                reject(chunk, lineNumber, "price must be a number >= 0");
+                continue;
+            }
+            if (!number(fields[layout.column[3]].text, row.stock) || row.stock <= 0)
+            {
+                reject(chunk, lineNumber, "stock must be a whole number > 0");
+                continue;
+            }
+            const Field& name = fields[layout.column[0]];
+            const Field& category = fields[layout.column[2]];
+            if (name.text.empty() || category.text.empty())
+            {
+                reject(chunk, lineNumber, "name and category are required");
+                continue;
+            }
+            if (name.text.size() > MAX_TEXT || category.text.size() > MAX_TEXT)
+            {
+                reject(chunk, lineNumber, "name or category is too long");
+                continue;
+            }
+            row.name = text(name);
+            row.category = text(category);
+            chunk.rows.push_back(std::move(row));
+        }
+    }
+
+public:
+    // Parses `size` bytes with up to `threads` threads (0 for one per core).
+    // Chunks come back in file order; `report` gets the row and error counts.
+    static std::vector<Chunk> parse(const char* data, size_t size, unsigned threads, ImportReport& report)
+    {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+        const char* end = data + size;
+        const char* firstNewline = static_cast<const char*>(std::memchr(data, '\n', size));
+        std::string_view firstLine(data, static_cast<size_t>((firstNewline ? firstNewline : end) - data));
+
+        Layout layout;
+        if (firstLine.find('\t') != std::string_view::npos) layout.delimiter = '\t';
+        const char* body = data;
+        size_t headerLines = 0;
+        Layout named = layout;
+        if (parseHeader(firstLine, named))
+        {
+            layout = named;
+            body = firstNewline ? firstNewline + 1 : end;
+            headerLines = 1;
+        }
+
+        // Small files are not worth the threads
+        const size_t minimumChunk = 1 << 20;
+        size_t remaining = static_cast<size_t>(end - body);
+        size_t count = std::max<size_t>(1, std::min<size_t>(threads, remaining / minimumChunk));
+
+        std::vector<const char*> bounds{ body };
+        for (size_t i = 1; i < count; ++i)
+        {
+            const char* cut = std::max(bounds.back(), body + remaining * i / count);
+            const char* newline = static_cast<const char*>(std::memchr(cut, '\n', static_cast<size_t>(end - cut)));
+            bounds.push_back(newline ? newline + 1 : end);
+        }
+        bounds.push_back(end);
+
+        std::vector<Chunk> chunks(count);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < count; ++i)
+        {
+            workers.emplace_back([&, i] { parseChunk(bounds[i], bounds[i + 1], layout, chunks[i]); });
+        }
+        parseChunk(bounds[0], bounds[1], layout, chunks[0]);
+        for (auto& w : workers) w.join();
+
+        size_t line = headerLines;
+        for (Chunk& chunk : chunks)
+        {
+            for (ImportError& error : chunk.errors)
+            {
+                error.line += line;
+                if (report.errors.size() < MAX_IMPORT_ERRORS) report.errors.push_back(std::move(error));
+            }
+            chunk.errors.clear();
+            line += chunk.lines;
+            report.rows += chunk.rows.size() + chunk.rejected;
+            report.rejected += chunk.rejected;
+        }
+        return chunks;
+    }
+
+    // Turns parsed rows into products numbered from `firstId` in file order,
+    // one thread per chunk
+    static std::vector<Product> build(const std::vector<Chunk>& chunks, ProductId firstId, UserId sellerId)
+    {
+        std::vector<size_t> offsets{ 0 };
+        for (const Chunk& chunk : chunks) offsets.push_back(offsets.back() + chunk.rows.size());
+
+        std::vector<Product> built(offsets.back());
+        auto fill = [&](size_t c)
+        {
+            size_t index = offsets[c];
+            for (const Row& row : chunks[c].rows)
+            {
+                ProductId id = firstId + static_cast<ProductId>(index);
+                built[index++] = Product(id, row.name, row.price, row.category, row.stock, sellerId);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t c = 1; c < chunks.size(); ++c) workers.emplace_back(fill, c);
+        if (!chunks.empty()) fill(0);
+        for (auto& w : workers) w.join();
+        return built;
+    }
+};
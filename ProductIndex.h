@@ -0,0 +1,309 @@
+#pragma once
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+#include "ProductCatalog.h"
+
+// NEWEST lists the most recently added products first; the others ascend
+enum class ProductSort { NEWEST, PRICE, NAME, STOCK };
+
+// Reusing one ProductPage for page after page saves allocating its buffers
+struct ProductPage
+{
+    std::vector<Product> products;
+    std::string nextCursor; // empty on the last page
+    std::vector<ProductId> ids; // of `products`, in order
+};
+
+// Sorted views of the catalog for paging.
+//
+// Price, name and stock each have an ordered set of (value, id). A page seeks
+// just past its cursor and walks on, so page N costs O(log n + page size)
+// however deep it is. The sets follow the catalog incrementally: before a
+// page is served, the products the catalog queued as added or modified are
+// moved to their new positions, and nothing else is touched. Newest-first
+// needs no set and walks the ids down.
+//
+// A cursor is an opaque token holding the sort and the (value, id) of the
+// last product shown, so the next page starts in the right place even if
+// products were added or repriced in between. Values on a page are read
+// when it is built and may be a little newer than the order they were sorted in.
+class ProductIndex
+{
+private:
+    struct Listed
+    {
+        double price = 0.0;
+        int stock = 0;
+        bool present = false;
+    };
+
+    struct Position
+    {
+        ProductSort sort = ProductSort::NEWEST;
+        bool reverse = false;
+        ProductId id = 0;
+        double price = 0.0;
+        int stock = 0;
+        std::string name;
+    };
+
+    ProductCatalog& catalog;
+    std::mutex mutex;
+    std::vector<Listed> listed; // by id: the values the sets currently place each product by
+    std::set<std::pair<double, ProductId>> byPrice;
+    std::set<std::pair<int, ProductId>> byStock;
+    std::set<std::pair<std::string, ProductId>> byName; // names never change once listed
+    std::vector<ProductId> changed;
+
+    // Caller holds the mutex
+    void refresh()
+    {
+        catalog.takeChanged(changed);
+        for (ProductId id : changed)
+        {
+            catalog.read(id, [this, id](const ProductRef& p)
+            {
+                if (static_cast<size_t>(id) >= listed.size()) listed.resize(static_cast<size_t>(id) + 1);
+                Listed& entry = listed[id];
+                double price = p.getPrice();
+                int stock = p.getStock();
+
+                if (!entry.present || entry.price != price)
+                {
+                    if (entry.present) byPrice.erase({ entry.price, id });
+                    byPrice.emplace(price, id);
+                    entry.price = price;
+                }
+                if (!entry.present || entry.stock != stock)
+                {
+                    if (entry.present) byStock.erase({ entry.stock, id });
+                    byStock.emplace(stock, id);
+                    entry.stock = stock;
+                }
+                if (!entry.present)
+                {
+                    byName.emplace(p.getName(), id);
+                    entry.present = true;
+                }
+            });
+        }
+    }
+
+    // Appends up to `limit` ids after `from` (or from the start); returns whether
+    // more follow. `last` is left pointing at the last entry taken, if any.
+    template <typename Key>
+    static bool collect(const std::set<std::pair<Key, ProductId>>& set, const std::pair<Key, ProductId>* from, bool reverse,
+                        size_t limit, std::vector<ProductId>& ids, const std::pair<Key, ProductId>*& last)
+    {
+        if (!reverse)
+        {
+            auto it = from ? set.upper_bound(*from) : set.begin();
+            for (; it != set.end() && ids.size() < limit; ++it)
+            {
+                ids.push_back(it->second);
+                last = &*it;
+            }
+            return it != set.end();
+        }
+
+        auto it = from ? set.lower_bound(*from) : set.end();
+        while (it != set.begin() && ids.size() < limit)
+        {
+            --it;
+            ids.push_back(it->second);
+            last = &*it;
+        }
+        return it != set.begin();
+    }
+
+    // Newest first walks ids downwards; reversed, oldest first walks them up
+    bool collectById(const ProductId* from, bool reverse, size_t limit, std::vector<ProductId>& ids, ProductId& last) const
+    {
+        const long step = reverse ? 1 : -1;
+        long id = from ? *from + step : (reverse ? 0 : static_cast<long>(listed.size()) - 1);
+        for (; id >= 0 && id < static_cast<long>(listed.size()); id += step)
+        {
+            if (!listed[id].present) continue;
+            if (ids.size() == limit) return true;
+            ids.push_back(static_cast<ProductId>(id));
+            last = static_cast<ProductId>(id);
+        }
+        return false;
+    }
+
+    static void appendHex(std::string& out, const void* data, size_t size)
+    {
+        static const char digits[] = "0123456789abcdef";
+        for (const unsigned char* c = static_cast<const unsigned char*>(data); size > 0; ++c, --size)
+        {
+            out += digits[*c >> 4];
+            out += digits[*c & 15];
+        }
+    }
+
+    // Writes the cursor into `cursor`, reusing its buffer
+    static void encode(const Position& position, std::string& cursor)
+    {
+        const char header[2] = { static_cast<char>(position.sort), static_cast<char>(position.reverse) };
+        cursor.clear();
+        appendHex(cursor, header, sizeof(header));
+        appendHex(cursor, &position.id, sizeof(position.id));
+        switch (position.sort)
+        {
+        case ProductSort::PRICE: appendHex(cursor, &position.price, sizeof(position.price)); break;
+        case ProductSort::STOCK: appendHex(cursor, &position.stock, sizeof(position.stock)); break;
+        case ProductSort::NAME: appendHex(cursor, position.name.data(), position.name.size()); break;
+        case ProductSort::NEWEST: break;
+        }
+    }
+
+    static bool decode(std::string_view cursor, Position& position)
+    {
+        auto nibble = [](char c) -> int
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            return -1;
+        };
+
+        if (cursor.size() % 2 != 0) return false;
+        std::string bytes;
+        for (size_t i = 0; i < cursor.size(); i += 2)
+        {
+            int high = nibble(cursor[i]), low = nibble(cursor[i + 1]);
+            if (high < 0 || low < 0) return false;
+            bytes += static_cast<char>(high << 4 | low);
+        }
+
+        const size_t header = 2 + sizeof(ProductId);
+        if (bytes.size() < header || bytes[0] < 0 || bytes[0] > static_cast<char>(ProductSort::STOCK) || (bytes[1] != 0 && bytes[1] != 1)) return false;
+        position.sort = static_cast<ProductSort>(bytes[0]);
+        position.reverse = bytes[1] == 1;
+        std::memcpy(&position.id, bytes.data() + 2, sizeof(position.id));
+
+        const size_t payload = bytes.size() - header;
+        switch (position.sort)
+        {
+        case ProductSort::PRICE:
+            if (payload != sizeof(position.price)) return false;
+            std::memcpy(&position.price, bytes.data() + header, sizeof(position.price));
+            return true;
+        case ProductSort::STOCK:
+            if (payload != sizeof(position.stock)) return false;
+            std::memcpy(&position.stock, bytes.data() + header, sizeof(position.stock));
+            return true;
+        case ProductSort::NAME:
+            position.name = bytes.substr(header);
+            return true;
+        case ProductSort::NEWEST:
+            return payload == 0;
+        }
+        return false;
+    }
+
+public:
+    explicit ProductIndex(ProductCatalog& catalog) : catalog(catalog) {}
+
+    ProductIndex(const ProductIndex&) = delete;
+    ProductIndex& operator=(const ProductIndex&) = delete;
+
+    // Fills `page` with up to `limit` products following `cursor` ("" for the
+    // first page). False if the cursor is malformed or from another sort order.
+    // A page reused from an earlier call has its products overwritten in
+    // place, so paging by id, price or stock allocates nothing once warm.
+    bool page(ProductSort sort, bool reverse, std::string_view cursor, size_t limit, ProductPage& page)
+    {
+        page.nextCursor.clear();
+        page.ids.clear();
+
+        Position from;
+        const bool resume = !cursor.empty();
+        if (resume && (!decode(cursor, from) || from.sort != sort || from.reverse != reverse))
+        {
+            page.products.clear();
+            return false;
+        }
+
+        std::vector<ProductId>& ids = page.ids;
+        Position last;
+        last.sort = sort;
+        last.reverse = reverse;
+        bool more = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            refresh();
+            switch (sort)
+            {
+            case ProductSort::PRICE:
+            {
+                std::pair<double, ProductId> start{ from.price, from.id };
+                const std::pair<double, ProductId>* end = nullptr;
+                more = collect(byPrice, resume ? &start : nullptr, reverse, limit, ids, end);
+                if (end) std::tie(last.price, last.id) = *end;
+                break;
+            }
+            case ProductSort::STOCK:
+            {
+                std::pair<int, ProductId> start{ from.stock, from.id };
+                const std::pair<int, ProductId>* end = nullptr;
+                more = collect(byStock, resume ? &start : nullptr, reverse, limit, ids, end);
+                if (end) std::tie(last.stock, last.id) = *end;
+                break;
+            }
+            case ProductSort::NAME:
+            {
+                std::pair<std::string, ProductId> start{ std::move(from.name), from.id };
+                const std::pair<std::string, ProductId>* end = nullptr;
+                more = collect(byName, resume ? &start : nullptr, reverse, limit, ids, end);
+                if (end) std::tie(last.name, last.id) = *end;
+                break;
+            }
+            case ProductSort::NEWEST:
+                more = collectById(resume ? &from.id : nullptr, reverse, limit, ids, last.id);
+                break;
+            }
+        }
+
+        size_t filled = 0;
+        for (ProductId id : ids)
+        {
+            catalog.read(id, [&page, &filled](const ProductRef& p)
+            {
+                if (filled < page.products.size()) page.products[filled].assign(p);
+                else page.products.emplace_back(p);
+                filled++;
+            });
+        }
+        page.products.erase(page.products.begin() + static_cast<long>(filled), page.products.end());
+        if (more) encode(last, page.nextCursor);
+        return true;
+    }
+
+    static bool parseSort(const std::string& text, ProductSort& sort)
+    {
+        if (text == "newest") sort = ProductSort::NEWEST;
+        else if (text == "price") sort = ProductSort::PRICE;
+        else if (text == "name") sort = ProductSort::NAME;
+        else if (text == "stock") sort = ProductSort::STOCK;
+        else return false;
+        return true;
+    }
+
+    static const char* sortName(ProductSort sort)
+    {
+        switch (sort)
+        {
+        case ProductSort::PRICE: return "price";
+        case ProductSort::NAME: return "name";
+        case ProductSort::STOCK: return "stock";
+        case ProductSort::NEWEST: break;
+        }
+        return "newest";
+    }
+};
@@ -0,0 +1,586 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include "Product.h"
+#include "Order.h"
+#include "Transaction.h"
+#include "Logger.h"
+#include "config.h"
+
+// Approximate sales analytics fed by the SALE transaction stream.
+// Every sketch here can be merged with another instance of the same shape,
+// so independent workers can each keep their own and fold them together later.
+
+inline uint64_t mixHash(uint64_t x)
+{
+    // splitmix64 finaliser
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t mixHash(const std::string& s)
+{
+    // FNV-1a, then mixed so the low bits are usable as well
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (unsigned char c : s)
+    {
+        h ^= c;
+        h *= 0x100000001B3ULL;
+    }
+    return mixHash(h);
+}
+
+class HyperLogLog
+{
+public:
+    static constexpr int PRECISION = 10;
+    static constexpr size_t REGISTERS = size_t(1) << PRECISION;
+    // While small, keep the exact hashes: cheaper than 1 KB of registers and exact
+    static constexpr size_t SPARSE_LIMIT = 64;
+
+private:
+    std::vector<uint64_t> sparse;   // sorted, distinct
+    std::vector<uint8_t> registers; // empty until promoted to dense
+
+    static uint8_t rankOf(uint64_t hash)
+    {
+        uint64_t rest = hash << PRECISION;
+        uint8_t rank = 1;
+        while (rank <= 64 - PRECISION && (rest & 0x8000000000000000ULL) == 0)
+        {
+            rest <<= 1;
+            ++rank;
+        }
+        return rank;
+    }
+
+    void addDense(uint64_t hash)
+    {
+        size_t index = static_cast<size_t>(hash >> (64 - PRECISION));
+        uint8_t rank = rankOf(hash);
+        if (rank > registers[index]) registers[index] = rank;
+    }
+
+    void promote()
+    {
+        registers.assign(REGISTERS, 0);
+        for (uint64_t h : sparse) addDense(h);
+        sparse.clear();
+        sparse.shrink_to_fit();
+    }
+
+public:
+    bool isSparse() const
+    {
+        return registers.empty();
+    }
+
+    void add(uint64_t hash)
+    {
+        if (!isSparse())
+        {
+            addDense(hash);
+            return;
+        }
+
+        auto it = std::lower_bound(sparse.begin(), sparse.end(), hash);
+        if (it != sparse.end() && *it == hash) return;
+        sparse.insert(it, hash);
+        if (sparse.size() > SPARSE_LIMIT) promote();
+    }
+
+    double estimate() const
+    {
+        if (isSparse()) return static_cast<double>(sparse.size());
+
+        const double m = static_cast<double>(REGISTERS);
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (uint8_t r : registers)
+        {
+            sum += std::ldexp(1.0, -r);
+            if (r == 0) ++zeros;
+        }
+
+        double alpha = 0.7213 / (1.0 + 1.079 / m);
+        double raw = alpha * m * m / sum;
+        if (raw <= 2.5 * m && zeros > 0)
+        {
+            return m * std::log(m / static_cast<double>(zeros)); // linear counting for small ranges
+        }
+        return raw;
+    }
+
+    void merge(const HyperLogLog& other)
+    {
+        if (other.isSparse())
+        {
+            for (uint64_t h : other.sparse) add(h);
+            return;
+        }
+
+        if (isSparse()) promote();
+        for (size_t i = 0; i < REGISTERS; ++i)
+        {
+            registers[i] = std::max(registers[i], other.registers[i]);
+        }
+    }
+
+    void writeToStream(std::ostream& os) const
+    {
+        uint8_t dense = isSparse() ? 0 : 1;
+        os.write(reinterpret_cast<const char*>(&dense), sizeof(dense));
+        if (dense)
+        {
+            os.write(reinterpret_cast<const char*>(registers.data()), REGISTERS);
+            return;
+        }
+
+        size_t count = sparse.size();
+        os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        os.write(reinterpret_cast<const char*>(sparse.data()), count * sizeof(uint64_t));
+    }
+
+    void readFromStream(std::istream& is)
+    {
+        uint8_t dense = 0;
+        is.read(reinterpret_cast<char*>(&dense), sizeof(dense));
+        sparse.clear();
+        registers.clear();
+        if (dense)
+        {
+            registers.resize(REGISTERS);
+            is.read(reinterpret_cast<char*>(registers.data()), REGISTERS);
+            return;
+        }
+
+        size_t count = 0;
+        is.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (count <= SPARSE_LIMIT)
+        {
+            sparse.resize(count);
+            is.read(reinterpret_cast<char*>(sparse.data()), count * sizeof(uint64_t));
+        }
+        else
+        {
+            is.setstate(std::ios::failbit);
+        }
+    }
+};
+
+class CountMinSketch
+{
+public:
+    static constexpr size_t WIDTH = 2048;
+    static constexpr size_t DEPTH = 4;
+
+private:
+    std::vector<uint32_t> counters;
+
+    static size_t column(uint64_t keyHash, size_t row)
+    {
+        return static_cast<size_t>(mixHash(keyHash + row * 0x9E3779B97F4A7C15ULL) % WIDTH);
+    }
+
+public:
+    CountMinSketch() : counters(WIDTH * DEPTH, 0) {}
+
+    void add(uint64_t keyHash, uint32_t count = 1)
+    {
+        for (size_t row = 0; row < DEPTH; ++row)
+        {
+            counters[row * WIDTH + column(keyHash, row)] += count;
+        }
+    }
+
+    uint32_t estimate(uint64_t keyHash) const
+    {
+        uint32_t best = UINT32_MAX;
+        for (size_t row = 0; row < DEPTH; ++row)
+        {
+            best = std::min(best, counters[row * WIDTH + column(keyHash, row)]);
+        }
+        return best;
+    }
+
+    void merge(const CountMinSketch& other)
+    {
+        for (size_t i = 0; i < counters.size(); ++i)
+        {
+            counters[i] += other.counters[i];
+        }
+    }
+
+    void writeToStream(std::ostream& os) const
+    {
+        os.write(reinterpret_cast<const char*>(counters.data()), counters.size() * sizeof(uint32_t));
+    }
+
+    void readFromStream(std::istream& is)
+    {
+        is.read(reinterpret_cast<char*>(counters.data()), counters.size() * sizeof(uint32_t));
+    }
+};
+
+// Count-Min sketch plus a small candidate set of the current top keys.
+template <typename Key>
+class HeavyHitters
+{
+private:
+    CountMinSketch sketch;
+    std::unordered_map<Key, uint32_t> candidates; // key -> last known estimate
+    size_t capacity;
+
+    static void writeKey(std::ostream& os, uint64_t key)
+    {
+        os.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    }
+
+    static void writeKey(std::ostream& os, const std::string& key)
+    {
+        size_t len = key.size();
+        os.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        os.write(key.c_str(), len);
+    }
+
+    static bool readKey(std::istream& is, uint64_t& key)
+    {
+        is.read(reinterpret_cast<char*>(&key), sizeof(key));
+        return is.good();
+    }
+
+    static bool readKey(std::istream& is, std::string& key)
+    {
+        size_t len = 0;
+        is.read(reinterpret_cast<char*>(&len), sizeof(len));
+        if (!is.good() || len >= 1000) return false;
+        key.resize(len);
+        is.read(&key[0], len);
+        return is.good();
+    }
+
+    void offer(const Key& key, uint32_t estimate)
+    {
+        auto it = candidates.find(key);
+        if (it != candidates.end())
+        {
+            it->second = estimate;
+            return;
+        }
+
+        if (candidates.size() < capacity)
+        {
+            candidates.emplace(key, estimate);
+            return;
+        }
+
+        auto weakest = std::min_element(candidates.begin(), candidates.end(),
+            [](const std::pair<const Key, uint32_t>& a, const std::pair<const Key, uint32_t>& b) { return a.second < b.second; });
+        if (estimate > weakest->second)
+        {
+            candidates.erase(weakest);
+            candidates.emplace(key, estimate);
+        }
+    }
+
+public:
+    explicit HeavyHitters(size_t capacity) : capacity(capacity) {}
+
+    void add(const Key& key, uint32_t count = 1)
+    {
+        uint64_t h = mixHash(key);
+        sketch.add(h, count);
+        offer(key, sketch.estimate(h));
+    }
+
+    uint32_t estimate(const Key& key) const
+    {
+        return sketch.estimate(mixHash(key));
+    }
+
+    void merge(const HeavyHitters& other)
+    {
+        sketch.merge(other.sketch);
+
+        std::vector<Key> keys;
+        for (const auto& c : candidates) keys.push_back(c.first);
+        for (const auto& c : other.candidates) keys.push_back(c.first);
+
+        candidates.clear();
+        for (const auto& key : keys)
+        {
+            offer(key, estimate(key));
+        }
+    }
+
+    std::vector<std::pair<Key, uint32_t>> top(size_t n) const
+    {
+        std::vector<std::pair<Key, uint32_t>> result;
+        for (const auto& c : candidates)
+        {
+            result.emplace_back(c.first, estimate(c.first));
+        }
+        std::sort(result.begin(), result.end(),
+            [](const std::pair<Key, uint32_t>& a, const std::pair<Key, uint32_t>& b) { return a.second > b.second; });
+        if (result.size() > n) result.resize(n);
+        return result;
+    }
+
+    void writeToStream(std::ostream& os) const
+    {
+        sketch.writeToStream(os);
+        size_t count = candidates.size();
+        os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& c : candidates)
+        {
+            writeKey(os, c.first);
+            os.write(reinterpret_cast<const char*>(&c.second), sizeof(c.second));
+        }
+    }
+
+    void readFromStream(std::istream& is)
+    {
+        sketch.readFromStream(is);
+        candidates.clear();
+
+        size_t count = 0;
+        is.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (count > capacity)
+        {
+            is.setstate(std::ios::failbit);
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Key key;
+            uint32_t estimate = 0;
+            if (!readKey(is, key)) return;
+            is.read(reinterpret_cast<char*>(&estimate), sizeof(estimate));
+            candidates.emplace(key, estimate);
+        }
+    }
+};
+
+class SalesAnalytics
+{
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr size_t TOP_K = 20;
+
+private:
+    std::unordered_map<ProductId, HyperLogLog> buyersByProduct;
+    HeavyHitters<uint64_t> productPairs; // (smaller id << 32) | larger id
+    HeavyHitters<std::string> categories;
+
+    // Highest IDs already absorbed; anything above these is replayed on startup
+    TransactionId lastTransactionId;
+    OrderId lastOrderId;
+
+    static uint64_t packPair(ProductId a, ProductId b)
+    {
+        if (a > b) std::swap(a, b);
+        return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+    }
+
+public:
+    SalesAnalytics() : productPairs(TOP_K), categories(TOP_K), lastTransactionId(0), lastOrderId(0) {}
+
+    void observeSale(const Transaction& sale, const std::string& category)
+    {
+        if (!sale.isSale()) return;
+        buyersByProduct[sale.getProductId()].add(mixHash(static_cast<uint64_t>(sale.getUserId())));
+        categories.add(category);
+        lastTransactionId = std::max(lastTransactionId, sale.getId());
+    }
+
+    void observeOrder(const Order& order)
+    {
+        const auto& items = order.getItems();
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            for (size_t j = i + 1; j < items.size(); ++j)
+            {
+                if (items[i].productId != items[j].productId)
+                {
+                    productPairs.add(packPair(items[i].productId, items[j].productId));
+                }
+            }
+        }
+        lastOrderId = std::max(lastOrderId, order.getId());
+    }
+
+    // Feed only the records newer than what the persisted sketches already cover
+    void catchUp(const std::vector<Transaction>& transactions, const std::vector<Order>& orders, const std::vector<Product>& products)
+    {
+        std::unordered_map<ProductId, StringId> categoryOf;
+        for (const auto& p : products)
+        {
+            categoryOf[p.getId()] = p.getCategoryId();
+        }
+
+        TransactionId transactionMark = lastTransactionId;
+        OrderId orderMark = lastOrderId;
+        size_t replayed = 0;
+
+        for (const auto& t : transactions)
+        {
+            if (t.isSale() && t.getId() > transactionMark)
+            {
+                auto it = categoryOf.find(t.getProductId());
+                observeSale(t, it != categoryOf.end() ? internedText(it->second) : "Misc");
+                ++replayed;
+            }
+        }
+
+        for (const auto& o : orders)
+        {
+            if (o.getId() > orderMark)
+            {
+                observeOrder(o);
+                ++replayed;
+            }
+        }
+
+        if (replayed > 0)
+        {
+            LOG_INFO("analytics", "caught up on %zu records", replayed);
+        }
+    }
+
+    void merge(const SalesAnalytics& other)
+    {
+        for (const auto& entry : other.buyersByProduct)
+        {
+            buyersByProduct[entry.first].merge(entry.second);
+        }
+        productPairs.merge(other.productPairs);
+        categories.merge(other.categories);
+        lastTransactionId = std::max(lastTransactionId, other.lastTransactionId);
+        lastOrderId = std::max(lastOrderId, other.lastOrderId);
+    }
+
+    double distinctBuyers(ProductId productId) const
+    {
+        auto it = buyersByProduct.find(productId);
+        return it != buyersByProduct.end() ? it->second.estimate() : 0.0;
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> topCategories(size_t n) const
+    {
+        return categories.top(n);
+    }
+
+    std::vector<std::pair<std::pair<ProductId, ProductId>, uint32_t>> topProductPairs(size_t n) const
+    {
+        std::vector<std::pair<std::pair<ProductId, ProductId>, uint32_t>> result;
+        for (const auto& entry : productPairs.top(n))
+        {
+            ProductId a = static_cast<ProductId>(entry.first >> 32);
+            ProductId b = static_cast<ProductId>(entry.first & 0xFFFFFFFFULL);
+            result.push_back({{a, b}, entry.second});
+        }
+        return result;
+    }
+
+    void writeToStream(std::ostream& os) const
+    {
+        uint32_t version = FORMAT_VERSION;
+        os.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        os.write(reinterpret_cast<const char*>(&lastTransactionId), sizeof(lastTransactionId));
+        os.write(reinterpret_cast<const char*>(&lastOrderId), sizeof(lastOrderId));
+
+        size_t count = buyersByProduct.size();
+        os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& entry : buyersByProduct)
+        {
+            os.write(reinterpret_cast<const char*>(&entry.first), sizeof(entry.first));
+            entry.second.writeToStream(os);
+        }
+
+        productPairs.writeToStream(os);
+        categories.writeToStream(os);
+    }
+
+    // Returns false if the stream is from another format version or is damaged
+    bool readFromStream(std::istream& is)
+    {
+        *this = SalesAnalytics();
+
+        uint32_t version = 0;
+        is.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if (!is.good() || version != FORMAT_VERSION) return false;
+
+        is.read(reinterpret_cast<char*>(&lastTransactionId), sizeof(lastTransactionId));
+        is.read(reinterpret_cast<char*>(&lastOrderId), sizeof(lastOrderId));
+
+        size_t count = 0;
+        is.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (count > 10000000) return false;
+        for (size_t i = 0; i < count && is.good(); ++i)
+        {
+            ProductId productId;
+            is.read(reinterpret_cast<char*>(&productId), sizeof(productId));
+            buyersByProduct[productId].readFromStream(is);
+        }
+
+        productPairs.readFromStream(is);
+        categories.readFromStream(is);
+
+        if (is.fail())
+        {
+            *this = SalesAnalytics();
+            return false;
+        }
+        return true;
+    }
+
+    void display(const std::vector<Product>& products) const
+    {
+        std::unordered_map<ProductId, std::string> nameOf;
+        std::vector<std::pair<double, ProductId>> reach;
+        for (const auto& p : products)
+        {
+            nameOf[p.getId()] = p.getName();
+        }
+        for (const auto& entry : buyersByProduct)
+        {
+            reach.push_back({entry.second.estimate(), entry.first});
+        }
+        std::sort(reach.begin(), reach.end(), [](const std::pair<double, ProductId>& a, const std::pair<double, ProductId>& b) { return a.first > b.first; });
+
+        auto label = [&nameOf](ProductId id)
+        {
+            auto it = nameOf.find(id);
+            return it != nameOf.end() ? it->second.substr(0, 20) : "#" + std::to_string(id);
+        };
+
+        std::cout << "\n--- Top products by unique customers (approx.) ---\n";
+        if (reach.empty()) std::cout << "No sales recorded yet.\n";
+        for (size_t i = 0; i < reach.size() && i < 10; ++i)
+        {
+            printf("%-20s | ~%.0f customers\n", label(reach[i].second).c_str(), reach[i].first);
+        }
+
+        std::cout << "\n--- Top categories by items sold (approx.) ---\n";
+        for (const auto& entry : topCategories(10))
+        {
+            printf("%-20s | ~%u sales\n", entry.first.substr(0, 20).c_str(), entry.second);
+        }
+
+        std::cout << "\n--- Products frequently bought together (approx.) ---\n";
+        for (const auto& entry : topProductPairs(10))
+        {
+            printf("%-20s + %-20s | ~%u orders\n", label(entry.first.first).c_str(), label(entry.first.second).c_str(), entry.second);
+        }
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <functional>
+#include <iostream>
+#include "Cart.h"
+#include "ExpenseTracker.h"
+#include "CustomerExpenseTracker.h"
+#include "config.h"
+
+// Per-user state for one client of ECommerceSystem. Any number of sessions
+// can run concurrently against the same system; a session itself is meant
+// to be driven by one thread at a time.
+class Session
+{
+public:
+    // Asked before destructive operations; returns true to go ahead
+    using Confirm = std::function<bool(const std::string& prompt)>;
+
+private:
+    UserId userId;
+    std::string username;
+    UserType userType;
+    Cart cart;
+    std::unique_ptr<ExpenseTracker> sellerTracker;
+    std::unique_ptr<CustomerExpenseTracker> customerTracker;
+    Confirm confirm;
+    OrderId lastOrderId = 0;
+
+public:
+    explicit Session(Confirm confirm = consoleConfirm) : userId(0), userType(UserType::CUSTOMER), confirm(std::move(confirm)) {}
+
+    static bool consoleConfirm(const std::string& prompt)
+    {
+        char answer;
+        std::cout << prompt << " (y/N): ";
+        std::cin >> answer;
+        std::cin.ignore();
+        return answer == 'y' || answer == 'Y';
+    }
+
+    static bool alwaysConfirm(const std::string&)
+    {
+        return true;
+    }
+
+    void begin(UserId id, const std::string& name, UserType type)
+    {
+        userId = id;
+        username = name;
+        userType = type;
+        cart = Cart(id);
+    }
+
+    void end()
+    {
+        userId = 0;
+        username.clear();
+        cart = Cart();
+        sellerTracker.reset();
+        customerTracker.reset();
+        lastOrderId = 0;
+    }
+
+    bool ask(const std::string& prompt) const
+    {
+        return confirm ? confirm(prompt) : false;
+    }
+
+    void setConfirm(Confirm newConfirm)
+    {
+        confirm = std::move(newConfirm);
+    }
+
+    bool isLoggedIn() const
+    {
+        return userId != 0;
+    }
+    UserId getUserId() const
+    {
+        return userId;
+    }
+    const std::string& getUsername() const
+    {
+        return username;
+    }
+    bool isCustomer() const
+    {
+        return isLoggedIn() && userType == UserType::CUSTOMER;
+    }
+    bool isSeller() const
+    {
+        return isLoggedIn() && userType == UserType::SELLER;
+    }
+    bool isAdmin() const
+    {
+        return isLoggedIn() && userType == UserType::ADMIN;
+    }
+
+    // Id of the most recent order placed through this session, 0 if none
+    OrderId getLastOrderId() const
+    {
+        return lastOrderId;
+    }
+    void setLastOrderId(OrderId orderId)
+    {
+        lastOrderId = orderId;
+    }
+
+    Cart& getCart()
+    {
+        return cart;
+    }
+    const Cart& getCart() const
+    {
+        return cart;
+    }
+
+    ExpenseTracker* getSellerTracker() const
+    {
+        return sellerTracker.get();
+    }
+    CustomerExpenseTracker* getCustomerTracker() const
+    {
+        return customerTracker.get();
+    }
+    void setSellerTracker(std::unique_ptr<ExpenseTracker> tracker)
+    {
+        sellerTracker = std::move(tracker);
+    }
+    void setCustomerTracker(std::unique_ptr<CustomerExpenseTracker> tracker)
+    {
+        customerTracker = std::move(tracker);
+    }
+};
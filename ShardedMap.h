@@ -0,0 +1,148 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Hash map split into independently locked shards. Readers of one shard take a
+// shared lock, writers an exclusive one, so operations on different keys rarely
+// contend. Values are only ever touched from inside the callbacks, while the
+// owning shard is locked.
+//
+// With a transparent Hash and KeyEqual (see StringKeyHash), read() and
+// contains() also take keys of another type, e.g. a std::string_view for a
+// std::string key, without building a Key.
+template <typename Key, typename Value, size_t ShardCount = 16, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class ShardedMap
+{
+private:
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, Value, Hash, KeyEqual> items;
+    };
+
+    std::array<Shard, ShardCount> shards;
+
+    template <typename K>
+    Shard& shardFor(const K& key)
+    {
+        return shards[Hash{}(key) % ShardCount];
+    }
+
+    template <typename K>
+    const Shard& shardFor(const K& key) const
+    {
+        return shards[Hash{}(key) % ShardCount];
+    }
+
+public:
+    // Returns false (and leaves the map untouched) if the key is already present
+    bool insert(const Key& key, Value value)
+    {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.items.emplace(key, std::move(value)).second;
+    }
+
+    template <typename K, typename F>
+    bool read(const K& key, F&& f) const
+    {
+        const Shard& shard = shardFor(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.items.find(key);
+        if (it == shard.items.end()) return false;
+        f(it->second);
+        return true;
+    }
+
+    template <typename F>
+    bool write(const Key& key, F&& f)
+    {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.items.find(key);
+        if (it == shard.items.end()) return false;
+        f(it->second);
+        return true;
+    }
+
+    bool erase(const Key& key)
+    {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.items.erase(key) > 0;
+    }
+
+    template <typename K>
+    bool contains(const K& key) const
+    {
+        return read(key, [](const Value&) {});
+    }
+
+    // Visits shard by shard; each shard is consistent, the whole map is not
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        for (const Shard& shard : shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto& entry : shard.items)
+            {
+                f(entry.first, entry.second);
+            }
+        }
+    }
+
+    // Copy of every value, ordered by key
+    std::vector<Value> sortedValues() const
+    {
+        std::vector<std::pair<Key, Value>> entries;
+        forEach([&entries](const Key& key, const Value& value) { entries.emplace_back(key, value); });
+        std::sort(entries.begin(), entries.end(), [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return a.first < b.first; });
+
+        std::vector<Value> result;
+        result.reserve(entries.size());
+        for (auto& entry : entries)
+        {
+            result.push_back(std::move(entry.second));
+        }
+        return result;
+    }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (const Shard& shard : shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            total += shard.items.size();
+        }
+        return total;
+    }
+
+    void clear()
+    {
+        for (Shard& shard : shards)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.items.clear();
+        }
+    }
+};
+
+// Hashes std::string keys and anything viewable as one alike; use with std::equal_to<>
+struct StringKeyHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view text) const
+    {
+        return std::hash<std::string_view>{}(text);
+    }
+};
@@ -0,0 +1,491 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include "ECommerceSystem.h"
+#include "HttpServer.h"
+#include "ShardedMap.h"
+#include "Json.h"
+#include "CoarseClock.h"
+
+// JSON endpoints over ECommerceSystem, meant to be plugged into HttpServer.
+//
+//   GET    /health
+//   GET    /products?sort=newest|price|name|stock&order=asc|desc&cursor=&limit=
+//   GET    /products/{id}
+//   GET    /search?q=
+//   POST   /register   username, password, type=customer|seller
+//   POST   /login      username, password  -> token
+//   POST   /logout
+//   GET    /cart       POST /cart/items (product_id, quantity)
+//   DELETE /cart       DELETE /cart/items/{id}
+//   GET    /orders     POST /orders (checks out the cart)
+//   GET    /reports/spending   GET /reports/seller   GET /stats
+//   GET    /metrics    Prometheus text format
+//
+// Parameters come from the query string or a form-encoded body. Everything
+// after /login needs "Authorization: Bearer <token>". Each user has one
+// Session, shared by every token they log in with, so all of them see the
+// same cart; requests for the same user are serialised, different users run
+// in parallel. A session left idle for SESSION_IDLE_SECONDS is logged out and
+// its tokens stop working; /logout ends only its own token, and the session
+// with the last one. Confirmation prompts are answered yes: the request
+// itself is the confirmation. /products pages with opaque cursors: pass next_cursor
+// from one response to get the page after it.
+class StoreApi
+{
+private:
+    struct ApiSession
+    {
+        std::mutex mutex;
+        Session session{ Session::alwaysConfirm };
+        size_t tokens = 0; // tokens still open on this session; guarded by mutex
+        std::atomic<int64_t> lastUsed{0}; // CoarseClock micros of the last request
+    };
+
+    static constexpr int DEFAULT_PAGE = 100;
+    static constexpr int MAX_PAGE = 1000;
+    static constexpr int64_t SESSION_IDLE_SECONDS = 30 * 60;
+    static constexpr int64_t SWEEP_SECONDS = 60; // least time between sweeps for idle sessions
+    static constexpr size_t MAX_TOKENS = 100000;
+
+    ECommerceSystem& system;
+    ShardedMap<std::string, std::shared_ptr<ApiSession>> sessions; // by token
+    ShardedMap<UserId, std::shared_ptr<ApiSession>> userSessions;
+    // Taken by login, logout and expiry, before any session's own lock, so a
+    // user's session is never ended while a login is joining it
+    std::mutex loginMutex;
+    int64_t lastSweep = 0; // guarded by loginMutex
+
+    static HttpResponse error(int status, const std::string& message)
+    {
+        JsonWriter json;
+        json.beginObject().field("error", message).endObject();
+        return HttpResponse::json(status, json.str());
+    }
+
+    static HttpResponse ok(const JsonWriter& json, int status = 200)
+    {
+        return HttpResponse::json(status, json.str());
+    }
+
+    static bool intParam(const HttpRequest& request, const std::string& name, int& value)
+    {
+        std::string text;
+        if (!request.param(name, text) || text.empty()) return false;
+        char* end = nullptr;
+        long parsed = std::strtol(text.c_str(), &end, 10);
+        if (*end != '\0') return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    // Id from the last path segment after `prefix`, e.g. /products/42
+    static bool pathId(const std::string& path, const std::string& prefix, int& id)
+    {
+        if (path.size() <= prefix.size() || path.compare(0, prefix.size(), prefix) != 0) return false;
+        const char* start = path.c_str() + prefix.size();
+        char* end = nullptr;
+        long parsed = std::strtol(start, &end, 10);
+        if (end == start || *end != '\0') return false;
+        id = static_cast<int>(parsed);
+        return true;
+    }
+
+    static std::string newToken()
+    {
+        thread_local std::mt19937_64 rng(std::random_device{}());
+        char buf[33];
+        std::snprintf(buf, sizeof(buf), "%016llx%016llx", static_cast<unsigned long long>(rng()), static_cast<unsigned long long>(rng()));
+        return buf;
+    }
+
+    static const char* roleName(const Session& session)
+    {
+        return session.isAdmin() ? "admin" : session.isSeller() ? "seller" : "customer";
+    }
+
+    static void writeProduct(JsonWriter& json, const ProductRef& p)
+    {
+        json.beginObject()
+            .field("id", p.getId())
+            .field("name", p.getName())
+            .field("price", p.getPrice())
+            .field("category", p.getCategory())
+            .field("stock", p.getStock())
+            .field("held", p.getHeld())
+            .field("seller_id", p.getSellerId())
+            .endObject();
+    }
+
+    static void writeOrder(JsonWriter& json, const Order& order)
+    {
+        json.beginObject()
+            .field("id", order.getId())
+            .field("timestamp", order.getTimestamp())
+            .field("status", orderStatusName(order.getStatus()))
+            .field("total", order.getTotal());
+        json.key("items").beginArray();
+        for (const CartItem& item : order.getItems())
+        {
+            json.beginObject().field("product_id", item.productId).field("quantity", item.quantity).endObject();
+        }
+        json.endArray().endObject();
+    }
+
+    std::shared_ptr<ApiSession> sessionFor(const HttpRequest& request)
+    {
+        static const std::string scheme = "Bearer ";
+        std::string authorization = request.header("authorization");
+        if (authorization.compare(0, scheme.size(), scheme) != 0) return nullptr;
+
+        std::shared_ptr<ApiSession> slot;
+        sessions.read(authorization.substr(scheme.size()), [&slot](const std::shared_ptr<ApiSession>& s) { slot = s; });
+        return slot;
+    }
+
+    static bool idle(const ApiSession& slot, int64_t now)
+    {
+        return now - slot.lastUsed.load(std::memory_order_relaxed) > SESSION_IDLE_SECONDS * 1000000;
+    }
+
+    // Closes `token`, and the session with its last token. The caller holds
+    // loginMutex and the session's lock.
+    void closeToken(const std::string& token, ApiSession& slot)
+    {
+        if (!sessions.erase(token)) return;
+        if (--slot.tokens > 0) return;
+        userSessions.erase(slot.session.getUserId());
+        system.logout(slot.session);
+    }
+
+    // Logs out the sessions nobody has used for SESSION_IDLE_SECONDS. The
+    // caller holds loginMutex.
+    void expireIdleSessions(int64_t now)
+    {
+        lastSweep = now;
+        std::vector<std::pair<std::string, std::shared_ptr<ApiSession>>> expired;
+        sessions.forEach([&expired, now](const std::string& token, const std::shared_ptr<ApiSession>& slot)
+        {
+            if (idle(*slot, now)) expired.emplace_back(token, slot);
+        });
+        for (auto& entry : expired)
+        {
+            std::lock_guard<std::mutex> lock(entry.second->mutex);
+            if (idle(*entry.second, now)) closeToken(entry.first, *entry.second);
+        }
+    }
+
+    HttpResponse listProducts(const HttpRequest& request)
+    {
+        int limit = DEFAULT_PAGE;
+        intParam(request, "limit", limit);
+        if (limit <= 0 || limit > MAX_PAGE) return error(400, "limit must be 1.." + std::to_string(MAX_PAGE));
+
+        std::string sortText = "newest", order, cursor;
+        request.param("sort", sortText);
+        request.param("order", order);
+        request.param("cursor", cursor);
+        ProductSort sort;
+        if (!ProductIndex::parseSort(sortText, sort)) return error(400, "sort must be newest, price, name or stock");
+        if (!order.empty() && order != "asc" && order != "desc") return error(400, "order must be asc or desc");
+        // Newest is already descending by age; asc/desc flip the default direction of each sort
+        bool reverse = sort == ProductSort::NEWEST ? order == "asc" : order == "desc";
+
+        ProductPage page;
+        if (!system.getProductPage(sort, reverse, cursor, static_cast<size_t>(limit), page)) return error(400, "invalid cursor for this sort and order");
+
+        JsonWriter json;
+        json.beginObject().key("products").beginArray();
+        for (const Product& p : page.products) writeProduct(json, p);
+        json.endArray().field("total", system.getStoreCounts().products).key("next_cursor");
+        if (page.nextCursor.empty()) json.null();
+        else json.value(page.nextCursor);
+        json.endObject();
+        return ok(json);
+    }
+
+    HttpResponse getProduct(ProductId productId)
+    {
+        JsonWriter json;
+        if (!system.readProduct(productId, [&json](const ProductRef& p) { writeProduct(json, p); }))
+        {
+            return error(404, "no such product");
+        }
+        return ok(json);
+    }
+
+    HttpResponse search(const HttpRequest& request)
+    {
+        std::string query;
+        if (!request.param("q", query) || query.empty()) return error(400, "q is required");
+
+        JsonWriter json;
+        json.beginObject().key("products").beginArray();
+        for (const Product& p : system.findProducts(query)) writeProduct(json, p);
+        json.endArray().endObject();
+        return ok(json);
+    }
+
+    HttpResponse registerUser(const HttpRequest& request)
+    {
+        std::string username, password, type = "customer";
+        request.param("type", type);
+        if (!request.param("username", username) || !request.param("password", password)) return error(400, "username and password are required");
+        if (type != "customer" && type != "seller") return error(400, "type must be customer or seller");
+
+        if (!system.registerUser(username, password, type == "seller" ? UserType::SELLER : UserType::CUSTOMER))
+        {
+            return error(409, "registration failed; the username may be taken");
+        }
+        JsonWriter json;
+        json.beginObject().field("registered", username).endObject();
+        return ok(json, 201);
+    }
+
+    HttpResponse login(const HttpRequest& request)
+    {
+        std::string username, password;
+        if (!request.param("username", username) || !request.param("password", password)) return error(400, "username and password are required");
+
+        UserType type = UserType::CUSTOMER;
+        const UserId userId = system.authenticate(username, password, type);
+        if (userId == 0) return error(401, "invalid username or password");
+
+        std::lock_guard<std::mutex> guard(loginMutex);
+        const int64_t now = CoarseClock::nowMicros();
+        if (now - lastSweep > SWEEP_SECONDS * 1000000 || sessions.size() >= MAX_TOKENS) expireIdleSessions(now);
+        if (sessions.size() >= MAX_TOKENS) return error(503, "too many open sessions; try again later");
+
+        // A user logged in elsewhere shares that session, and so its cart
+        std::shared_ptr<ApiSession> slot;
+        userSessions.read(userId, [&slot](const std::shared_ptr<ApiSession>& s) { slot = s; });
+        if (!slot)
+        {
+            slot = std::make_shared<ApiSession>();
+            if (!system.login(slot->session, username, password)) return error(401, "invalid username or password");
+            userSessions.insert(userId, slot);
+        }
+
+        std::string token = newToken();
+        {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            while (!sessions.insert(token, slot)) token = newToken();
+            ++slot->tokens;
+            slot->lastUsed.store(now, std::memory_order_relaxed);
+        }
+        JsonWriter json;
+        json.beginObject().field("token", token).field("user_id", slot->session.getUserId()).field("role", roleName(slot->session)).endObject();
+        return ok(json);
+    }
+
+    HttpResponse viewCart(const Session& session)
+    {
+        JsonWriter json;
+        json.beginObject().key("items").beginArray();
+        double total = 0.0;
+        for (const CartItem& item : session.getCart().getItems())
+        {
+            system.readProduct(item.productId, [&](const ProductRef& p)
+            {
+                double subtotal = p.getPrice() * item.quantity;
+                total += subtotal;
+                json.beginObject()
+                    .field("product_id", item.productId)
+                    .field("name", p.getName())
+                    .field("price", p.getPrice())
+                    .field("quantity", item.quantity)
+                    .field("subtotal", subtotal)
+                    .endObject();
+            });
+        }
+        json.endArray().field("total", total).endObject();
+        return ok(json);
+    }
+
+    HttpResponse placeOrder(Session& session)
+    {
+        if (!system.placeOrder(session)) return error(409, "checkout failed; the cart may be empty or out of stock");
+
+        OrderId orderId = session.getLastOrderId();
+        JsonWriter json;
+        system.readOrder(orderId, [&json](const Order& order) { writeOrder(json, order); });
+        return ok(json, 201);
+    }
+
+    HttpResponse orderHistory(const Session& session)
+    {
+        JsonWriter json;
+        json.beginObject().key("orders").beginArray();
+        for (const Order& order : system.getOrderHistory(session)) writeOrder(json, order);
+        json.endArray().endObject();
+        return ok(json);
+    }
+
+    HttpResponse spendingReport(const Session& session)
+    {
+        const CustomerExpenseTracker* tracker = session.getCustomerTracker();
+        if (!session.isCustomer() || !tracker) return error(403, "only customers have a spending report");
+
+        JsonWriter json;
+        json.beginObject()
+            .field("total_spent", tracker->getTotalSpent())
+            .field("total_refunded", tracker->getTotalRefunded())
+            .field("net_spent", tracker->getNetSpent());
+        json.key("monthly").beginObject();
+        for (const auto& month : tracker->getMonthlySummary()) json.field(month.first, month.second);
+        json.endObject().endObject();
+        return ok(json);
+    }
+
+    HttpResponse sellerReport(const Session& session)
+    {
+        const ExpenseTracker* tracker = session.getSellerTracker();
+        if (!session.isSeller() || !tracker) return error(403, "only sellers have a financial report");
+
+        JsonWriter json;
+        json.beginObject()
+            .field("revenue", tracker->getTotalRevenue())
+            .field("expenses", tracker->getTotalExpenses())
+            .field("refunds", tracker->getTotalRefunds())
+            .field("net_profit", tracker->getNetProfit());
+        json.key("daily").beginObject();
+        for (const auto& day : tracker->getDailySummary()) json.field(day.first, day.second);
+        json.endObject().endObject();
+        return ok(json);
+    }
+
+    HttpResponse stats(const Session& session)
+    {
+        if (!session.isAdmin()) return error(403, "only administrators can view statistics");
+
+        ECommerceSystem::StoreCounts counts = system.getStoreCounts();
+        ECommerceSystem::CheckoutStats checkout = system.getCheckoutStats();
+        JsonWriter json;
+        json.beginObject()
+            .field("users", counts.users)
+            .field("products", counts.products)
+            .field("orders", counts.orders)
+            .field("transactions", counts.transactions)
+            .field("cart_holds", counts.cartHolds);
+        json.key("checkout").beginObject()
+            .field("attempts", checkout.attempts)
+            .field("committed", checkout.committed)
+            .field("conflicts", checkout.conflicts)
+            .field("retries", checkout.retries)
+            .field("abandoned", checkout.abandoned)
+            .endObject();
+        std::array<size_t, ORDER_STATUS_COUNT> byStatus = system.getOrderStatusCounts();
+        json.key("orders_by_status").beginObject();
+        for (size_t i = 0; i < ORDER_STATUS_COUNT; ++i) json.field(orderStatusName(static_cast<OrderStatus>(i)), byStatus[i]);
+        json.endObject();
+        json.endObject();
+        return ok(json);
+    }
+
+    HttpResponse logout(const std::string& token, ApiSession& slot)
+    {
+        std::lock_guard<std::mutex> guard(loginMutex);
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        closeToken(token, slot);
+        JsonWriter json;
+        json.beginObject().field("logged_out", true).endObject();
+        return ok(json);
+    }
+
+    // Endpoints that need a logged-in session; the caller holds its lock
+    HttpResponse handleSession(const HttpRequest& request, Session& session)
+    {
+        const std::string& method = request.method;
+        const std::string& path = request.path;
+        int id = 0;
+        if (path == "/cart" && method == "GET") return viewCart(session);
+        if (path == "/cart" && method == "DELETE")
+        {
+            system.clearCart(session);
+            return viewCart(session);
+        }
+        if (path == "/cart/items" && method == "POST")
+        {
+            int productId = 0, quantity = 0;
+            if (!intParam(request, "product_id", productId) || !intParam(request, "quantity", quantity)) return error(400, "product_id and quantity are required");
+            if (!system.addToCart(session, productId, quantity)) return error(409, "could not add to cart; check the product and available stock");
+            return viewCart(session);
+        }
+        if (pathId(path, "/cart/items/", id) && method == "DELETE")
+        {
+            int before = session.getCart().getItemCount();
+            system.removeFromCart(session, id);
+            if (session.getCart().getItemCount() == before) return error(404, "item not in cart");
+            return viewCart(session);
+        }
+        if (path == "/orders" && method == "GET") return orderHistory(session);
+        if (path == "/orders" && method == "POST") return placeOrder(session);
+        if (path == "/reports/spending" && method == "GET") return spendingReport(session);
+        if (path == "/reports/seller" && method == "GET") return sellerReport(session);
+        if (path == "/stats" && method == "GET") return stats(session);
+        if (path == "/metrics" && method == "GET")
+        {
+            if (!session.isAdmin()) return error(403, "only administrators can view metrics");
+            HttpResponse response;
+            response.contentType = "text/plain; version=0.0.4";
+            response.body = Metrics::instance().prometheus();
+            return response;
+        }
+        return error(404, "no such endpoint");
+    }
+
+public:
+    explicit StoreApi(ECommerceSystem& system) : system(system) {}
+
+    HttpResponse handle(const HttpRequest& request)
+    {
+        const std::string& method = request.method;
+        const std::string& path = request.path;
+        int id = 0;
+
+        if (method == "GET")
+        {
+            if (path == "/health")
+            {
+                JsonWriter json;
+                json.beginObject().field("status", "ok").endObject();
+                return ok(json);
+            }
+            if (path == "/products") return listProducts(request);
+            if (pathId(path, "/products/", id)) return getProduct(id);
+            if (path == "/search") return search(request);
+        }
+        if (method == "POST" && path == "/register") return registerUser(request);
+        if (method == "POST" && path == "/login") return login(request);
+
+        std::shared_ptr<ApiSession> slot = sessionFor(request);
+        if (!slot) return error(401, "log in first and send Authorization: Bearer <token>");
+        const std::string token = request.header("authorization").substr(7);
+        if (method == "POST" && path == "/logout") return logout(token, *slot);
+
+        const int64_t now = CoarseClock::nowMicros();
+        if (idle(*slot, now))
+        {
+            std::lock_guard<std::mutex> guard(loginMutex);
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            if (idle(*slot, now)) closeToken(token, *slot);
+        }
+
+        std::lock_guard<std::mutex> lock(slot->mutex);
+        if (!slot->session.isLoggedIn()) return error(401, "session has ended");
+        slot->lastUsed.store(now, std::memory_order_relaxed);
+        return handleSession(request, slot->session);
+    }
+
+    // Logged-in users, each with one session however many tokens they hold
+    size_t activeSessions() const
+    {
+        return userSessions.size();
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include "config.h"
+
+// Process-wide dictionary of the strings many records share: categories,
+// the names sales refer to, expense descriptions. Each distinct string is stored once
+// and named by a 4-byte StringId; 0 is the empty string. Ids stay valid for
+// the life of the process but differ between runs, so files carry their own
+// dictionaries (see StringDictionaryWriter).
+//
+// Looking up an id takes no lock and the returned reference never moves.
+// Interning locks one of SHARDS shards, picked by the string's hash, so
+// parallel imports rarely wait on each other. Strings are never removed.
+class StringInterner
+{
+public:
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t CHUNK_SIZE = 4096; // strings per chunk
+    static constexpr size_t MAX_CHUNKS = 4096; // per shard
+
+private:
+    struct Chunk
+    {
+        std::array<std::string, CHUNK_SIZE> strings;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string_view, StringId> ids; // views into the chunks
+        std::array<std::atomic<Chunk*>, MAX_CHUNKS> chunks{};
+        uint32_t count = 0;
+    };
+
+    std::array<Shard, SHARDS> shards;
+
+    // Id 0 is the first slot of shard 0, kept empty
+    StringInterner()
+    {
+        shards[0].chunks[0].store(new Chunk(), std::memory_order_release);
+        shards[0].count = 1;
+    }
+
+    ~StringInterner()
+    {
+        for (Shard& shard : shards)
+        {
+            for (auto& chunk : shard.chunks) delete chunk.load();
+        }
+    }
+
+public:
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    static StringInterner& instance()
+    {
+        static StringInterner interner;
+        return interner;
+    }
+
+    StringId intern(std::string_view text)
+    {
+        if (text.empty()) return 0;
+        const size_t shardIndex = std::hash<std::string_view>{}(text) % SHARDS;
+        Shard& shard = shards[shardIndex];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.ids.find(text);
+        if (it != shard.ids.end()) return it->second;
+
+        const uint32_t index = shard.count;
+        if (index / CHUNK_SIZE >= MAX_CHUNKS) throw std::length_error("string interner is full");
+        Chunk* chunk = shard.chunks[index / CHUNK_SIZE].load(std::memory_order_relaxed);
+        if (!chunk)
+        {
+            chunk = new Chunk();
+            shard.chunks[index / CHUNK_SIZE].store(chunk, std::memory_order_release);
+        }
+        std::string& stored = chunk->strings[index % CHUNK_SIZE];
+        stored.assign(text);
+        shard.count++;
+        const StringId id = static_cast<StringId>(index * SHARDS + shardIndex);
+        shard.ids.emplace(std::string_view(stored), id);
+        return id;
+    }
+
+    // `id` must come from intern()
+    const std::string& text(StringId id) const
+    {
+        const Shard& shard = shards[id % SHARDS];
+        const uint32_t index = id / SHARDS;
+        const Chunk* chunk = shard.chunks[index / CHUNK_SIZE].load(std::memory_order_acquire);
+        return chunk->strings[index % CHUNK_SIZE];
+    }
+};
+
+inline StringId intern(std::string_view text)
+{
+    return StringInterner::instance().intern(text);
+}
+
+inline const std::string& internedText(StringId id)
+{
+    return StringInterner::instance().text(id);
+}
+
+// The strings a file refers to, written once ahead of its records, which
+// then store a position in this table instead of the text
+class StringDictionaryWriter
+{
+private:
+    static constexpr uint32_t ABSENT = UINT32_MAX;
+
+    std::vector<uint32_t> positions; // by StringId; ids are dense, so no hashing
+    std::vector<StringId> strings;
+
+public:
+    void add(StringId id)
+    {
+        if (id >= positions.size()) positions.resize(std::max<size_t>(id + 1, positions.size() * 2), ABSENT);
+        if (positions[id] != ABSENT) return;
+        positions[id] = static_cast<uint32_t>(strings.size());
+        strings.push_back(id);
+    }
+
+    // `id` must have been added
+    uint32_t positionOf(StringId id) const
+    {
+        return positions[id];
+    }
+
+    void writeTo(std::ostream& os) const
+    {
+        uint32_t count = static_cast<uint32_t>(strings.size());
+        os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (StringId id : strings)
+        {
+            const std::string& text = internedText(id);
+            uint32_t len = static_cast<uint32_t>(text.size());
+            os.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            os.write(text.data(), len);
+        }
+    }
+};
+
+// Reads a table written by StringDictionaryWriter, interning every string
+class StringDictionaryReader
+{
+private:
+    static constexpr uint32_t MAX_LENGTH = 1 << 20;
+
+    std::vector<StringId> ids;
+
+public:
+    // False if the table is cut short or malformed
+    bool readFrom(std::istream& is)
+    {
+        ids.clear();
+        uint32_t count = 0;
+        if (!is.read(reinterpret_cast<char*>(&count), sizeof(count))) return false;
+        std::string text;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t len = 0;
+            if (!is.read(reinterpret_cast<char*>(&len), sizeof(len)) || len > MAX_LENGTH) return false;
+            text.resize(len);
+            if (len > 0 && !is.read(&text[0], len)) return false;
+            ids.push_back(intern(text));
+        }
+        return true;
+    }
+
+    // The empty string for a position past the table
+    StringId idAt(uint32_t position) const
+    {
+        return position < ids.size() ? ids[position] : 0;
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+// Hierarchical timing wheel: four levels of 64 slots each. Scheduling and
+// expiring an entry are O(1) amortised regardless of how many are pending;
+// an entry is moved down a level at most three times before it fires.
+// Time is measured in abstract ticks chosen by the owner.
+template <typename T>
+class TimingWheel
+{
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr uint64_t SLOTS = uint64_t(1) << SLOT_BITS;
+
+private:
+    struct Entry
+    {
+        uint64_t expiry;
+        T payload;
+    };
+
+    std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> levels;
+    std::vector<Entry> overflow; // further out than the top level reaches
+    uint64_t now;
+    size_t pending;
+
+    static uint64_t span(int level)
+    {
+        return uint64_t(1) << (SLOT_BITS * (level + 1));
+    }
+
+    void place(Entry&& entry)
+    {
+        uint64_t delta = entry.expiry - now;
+        for (int level = 0; level < LEVELS; ++level)
+        {
+            if (delta < span(level))
+            {
+                size_t slot = static_cast<size_t>((entry.expiry >> (SLOT_BITS * level)) & (SLOTS - 1));
+                levels[level][slot].push_back(std::move(entry));
+                return;
+            }
+        }
+        overflow.push_back(std::move(entry));
+    }
+
+    template <typename F>
+    void redistribute(std::vector<Entry>& bucket, F& onExpire)
+    {
+        std::vector<Entry> entries;
+        entries.swap(bucket);
+        for (Entry& entry : entries)
+        {
+            if (entry.expiry <= now)
+            {
+                --pending;
+                onExpire(entry.payload);
+            }
+            else
+            {
+                place(std::move(entry));
+            }
+        }
+    }
+
+public:
+    explicit TimingWheel(uint64_t start = 0) : now(start), pending(0) {}
+
+    uint64_t currentTick() const
+    {
+        return now;
+    }
+
+    size_t size() const
+    {
+        return pending;
+    }
+
+    // Entries due at or before the current tick fire on the next advance
+    void schedule(uint64_t expiry, T payload)
+    {
+        if (expiry <= now) expiry = now + 1;
+        ++pending;
+        place({ expiry, std::move(payload) });
+    }
+
+    // Moves time forward to `target`, calling onExpire(payload) for every due entry
+    template <typename F>
+    void advance(uint64_t target, F&& onExpire)
+    {
+        while (now < target && pending > 0)
+        {
+            ++now;
+            // Cascade higher levels whose slot boundary has just been reached
+            int level = 1;
+            for (; level < LEVELS; ++level)
+            {
+                if ((now & (span(level - 1) - 1)) != 0) break;
+                size_t slot = static_cast<size_t>((now >> (SLOT_BITS * level)) & (SLOTS - 1));
+                redistribute(levels[level][slot], onExpire);
+            }
+            if (level == LEVELS)
+            {
+                redistribute(overflow, onExpire);
+            }
+            redistribute(levels[0][static_cast<size_t>(now & (SLOTS - 1))], onExpire);
+        }
+        if (now < target) now = target;
+    }
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include <array>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+
+// Set to 0 (-DECOMMERCE_TRACING=0) to compile the spans out entirely
+#ifndef ECOMMERCE_TRACING
+#define ECOMMERCE_TRACING 1
+#endif
+
+// Records timed spans per thread while started, and writes them as Chrome
+// trace-event JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Each thread appends to a ring buffer of its own, so a span costs two clock
+// reads and three relaxed stores; when stopped it costs one relaxed load.
+// A full ring overwrites its oldest spans. Rings outlive their threads and
+// are reused by the next thread to start tracing. Span names must be string
+// literals: only the pointer is kept.
+class Tracer
+{
+public:
+    static constexpr size_t MAX_THREADS = 256;
+    static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event
+    {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> startNs{0};
+        std::atomic<uint64_t> durationNs{0};
+    };
+
+    struct Ring
+    {
+        std::atomic<uint64_t> written{0};
+        std::array<Event, EVENTS_PER_THREAD> events;
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<Ring*> ring{nullptr};
+        std::atomic<bool> claimed{false};
+    };
+
+    // Past MAX_THREADS a thread records nothing
+    struct ThreadState
+    {
+        Ring* ring = nullptr;
+        Slot* owned = nullptr;
+        bool full = false;
+
+        ~ThreadState()
+        {
+            if (owned) owned->claimed.store(false);
+        }
+    };
+
+    static inline std::atomic<bool> running{false};
+    std::array<Slot, MAX_THREADS> slots;
+    const Clock::time_point origin = Clock::now();
+
+    Ring* threadRing()
+    {
+        thread_local ThreadState state;
+        if (!state.ring && !state.full)
+        {
+            for (Slot& slot : slots)
+            {
+                bool expected = false;
+                if (!slot.claimed.compare_exchange_strong(expected, true)) continue;
+                state.owned = &slot;
+                Ring* ring = slot.ring.load(std::memory_order_acquire);
+                if (!ring)
+                {
+                    ring = new Ring();
+                    slot.ring.store(ring, std::memory_order_release);
+                }
+                state.ring = ring;
+                break;
+            }
+            state.full = !state.ring;
+        }
+        return state.ring;
+    }
+
+    static void appendEvent(std::string& out, const char* name, size_t thread, uint64_t startNs, uint64_t durationNs)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"ecommerce\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu}",
+                      name, thread, static_cast<unsigned long long>(startNs / 1000), static_cast<unsigned long long>(startNs % 1000),
+                      static_cast<unsigned long long>(durationNs / 1000), static_cast<unsigned long long>(durationNs % 1000));
+        out += line;
+    }
+
+    Tracer() = default;
+
+    ~Tracer()
+    {
+        for (Slot& slot : slots) delete slot.ring.load();
+    }
+
+public:
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static Tracer& instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    static bool isRunning()
+    {
+        return running.load(std::memory_order_relaxed);
+    }
+
+    // Drops whatever an earlier run recorded and starts recording
+    void start()
+    {
+        for (Slot& slot : slots)
+        {
+            if (Ring* ring = slot.ring.load(std::memory_order_acquire)) ring->written.store(0, std::memory_order_relaxed);
+        }
+        running.store(true);
+    }
+
+    void stop()
+    {
+        running.store(false);
+    }
+
+    // Nanoseconds since the tracer was created
+    uint64_t now() const
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count());
+    }
+
+    void record(const char* name, uint64_t startNs, uint64_t durationNs)
+    {
+        Ring* ring = threadRing();
+        if (!ring) return;
+        uint64_t index = ring->written.load(std::memory_order_relaxed);
+        Event& event = ring->events[index % EVENTS_PER_THREAD];
+        event.name.store(name, std::memory_order_relaxed);
+        event.startNs.store(startNs, std::memory_order_relaxed);
+        event.durationNs.store(durationNs, std::memory_order_relaxed);
+        ring->written.store(index + 1, std::memory_order_release);
+    }
+
+    // Spans still in every ring, as a trace-event JSON document. Best taken
+    // after stop(): a ring that wraps while being read may give a mixed-up span.
+    std::string chromeTrace() const
+    {
+        std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        for (size_t t = 0; t < slots.size(); ++t)
+        {
+            const Ring* ring = slots[t].ring.load(std::memory_order_acquire);
+            if (!ring) continue;
+            uint64_t written = ring->written.load(std::memory_order_acquire);
+            uint64_t begin = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+            for (uint64_t i = begin; i < written; ++i)
+            {
+                const Event& event = ring->events[i % EVENTS_PER_THREAD];
+                const char* name = event.name.load(std::memory_order_relaxed);
+                if (!name) continue;
+                if (!first) out += ',';
+                first = false;
+                appendEvent(out, name, t + 1, event.startNs.load(std::memory_order_relaxed), event.durationNs.load(std::memory_order_relaxed));
+            }
+        }
+        out += "]}\n";
+        return out;
+    }
+
+    bool writeChromeTrace(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << chromeTrace();
+        return static_cast<bool>(file);
+    }
+};
+
+// Records the enclosing scope as one span if tracing was running when it began
+class TraceSpan
+{
+private:
+    const char* name;
+    uint64_t start;
+
+public:
+    explicit TraceSpan(const char* name) : name(Tracer::isRunning() ? name : nullptr), start(this->name ? Tracer::instance().now() : 0) {}
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan()
+    {
+        if (!name) return;
+        Tracer& tracer = Tracer::instance();
+        tracer.record(name, start, tracer.now() - start);
+    }
+};
+
+#define TRACE_SPAN_JOIN(a, b) a##b
+#define TRACE_SPAN_NAME(line) TRACE_SPAN_JOIN(traceSpan, line)
+
+// Traces the rest of the enclosing scope under a string-literal name
+#if ECOMMERCE_TRACING
+#define TRACE_SPAN(name) TraceSpan TRACE_SPAN_NAME(__LINE__)(name)
+#else
+#define TRACE_SPAN(name) ((void)0)
+#endif
@@ -1,9 +1,18 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <ctime>
 #include <iostream>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
 #include "config.h"
+#include "CoarseClock.h"
+#include "StringInterner.h"
+
+// How a transaction's description is kept: the store's own descriptions are
+// rebuilt from what they refer to when asked for, anything else is interned text
+enum class DescriptionKind : uint8_t { TEXT, PURCHASE, REFUND };
 
 class Transaction {
 private:
@@ -12,24 +21,37 @@ private:
     ProductId productId;
     double amount;
     TransactionType type;
-    std::string description;
-    char timestamp[DATE_STR_LEN];
+    DescriptionKind kind;
+    StringId text; // PURCHASE: the product's name when sold; TEXT: the description
+    OrderId orderId; // REFUND: the refunded order
+    int64_t timestamp; // microseconds since the Unix epoch
+
+    Transaction(TransactionId id, UserId userId, ProductId productId, double amount, TransactionType type, DescriptionKind kind, StringId text, OrderId orderId, int64_t timestamp) : id(id), userId(userId), productId(productId), amount(amount), type(type), kind(kind), text(text), orderId(orderId), timestamp(timestamp) {}
 
 public:
-    Transaction() : id(0), userId(0), productId(-1), amount(0.0), type(TransactionType::SALE) 
+    Transaction() : id(0), userId(0), productId(-1), amount(0.0), type(TransactionType::SALE), kind(DescriptionKind::TEXT), text(0), orderId(0), timestamp(0) {}
+
+    // Stamped from the cached clock: no system call per record
+    Transaction(TransactionId id, UserId userId, ProductId productId, double amount, TransactionType type, std::string_view description) : Transaction(id, userId, productId, amount, type, description, CoarseClock::nowMicros()) {}
+
+    // Same, with a given time (epoch microseconds), e.g. one for a whole batch or the one read from disk
+    Transaction(TransactionId id, UserId userId, ProductId productId, double amount, TransactionType type, std::string_view description, int64_t timestamp) : Transaction(id, userId, productId, amount, type, DescriptionKind::TEXT, intern(description), 0, timestamp) {}
+
+    // A sale of `productId`, described as "Purchase: <name>"
+    static Transaction purchase(TransactionId id, UserId userId, ProductId productId, double amount, StringId productName, int64_t timestamp = CoarseClock::nowMicros()) 
     {
-        std::strncpy(timestamp, "1970-01-01 00:00:00", DATE_STR_LEN);
+        return Transaction(id, userId, productId, amount, TransactionType::SALE, DescriptionKind::PURCHASE, productName, 0, timestamp);
     }
 
-    Transaction(TransactionId id, UserId userId, ProductId productId, double amount, TransactionType type, const std::string& description) : id(id), userId(userId), productId(productId), amount(amount), type(type), description(description) 
+    // A refund of a whole order, described as "Refund for Order #<id>"
+    static Transaction refund(TransactionId id, UserId userId, double amount, OrderId orderId, int64_t timestamp = CoarseClock::nowMicros()) 
     {
-        updateTimestamp();
+        return Transaction(id, userId, -1, amount, TransactionType::REFUND, DescriptionKind::REFUND, 0, orderId, timestamp);
     }
 
     void updateTimestamp() 
     {
-        std::time_t now = std::time(nullptr);
-        std::strftime(timestamp, DATE_STR_LEN, "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+        timestamp = CoarseClock::nowMicros();
     }
 
     TransactionId getId() const 
@@ -52,11 +74,40 @@ public:
     { 
         return type; 
     }
+    // Built on each call for purchases and refunds; a report that reuses one
+    // string for every row allocates only while the string grows
+    void appendDescription(std::string& out) const 
+    { 
+        switch (kind) 
+        {
+            case DescriptionKind::PURCHASE: 
+                out += "Purchase: ";
+                out += internedText(text);
+                return;
+            case DescriptionKind::REFUND: 
+            {
+                char number[24];
+                std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(orderId));
+                out += "Refund for Order #";
+                out += number;
+                return;
+            }
+            case DescriptionKind::TEXT: break;
+        }
+        out += internedText(text); 
+    }
     std::string getDescription() const 
     { 
+        std::string description;
+        appendDescription(description);
         return description; 
     }
-    const char* getTimestamp() const 
+    // Local "YYYY-MM-DD HH:MM:SS", formatted on each call
+    std::string getTimestamp() const 
+    { 
+        return formatTimestamp(timestamp); 
+    }
+    int64_t getTimestampMicros() const 
     { 
         return timestamp; 
     }
@@ -74,7 +125,12 @@ public:
         return type == TransactionType::EXPENSE; 
     }
 
-    void writeToStream(std::ostream& os) const 
+    void addStrings(StringDictionaryWriter& dictionary) const 
+    {
+        dictionary.add(text);
+    }
+
+    void writeToStream(std::ostream& os, const StringDictionaryWriter& dictionary) const 
     {
         os.write(reinterpret_cast<const char*>(&id), sizeof(id));
         os.write(reinterpret_cast<const char*>(&userId), sizeof(userId));
@@ -84,47 +140,119 @@ public:
         int typeInt = static_cast<int>(type);
         os.write(reinterpret_cast<const char*>(&typeInt), sizeof(typeInt));
         
-        size_t descLen = description.size();
-        os.write(reinterpret_cast<const char*>(&descLen), sizeof(descLen));
-        os.write(description.c_str(), descLen);
+        uint8_t kindValue = static_cast<uint8_t>(kind);
+        uint32_t position = dictionary.positionOf(text);
+        os.write(reinterpret_cast<const char*>(&kindValue), sizeof(kindValue));
+        os.write(reinterpret_cast<const char*>(&position), sizeof(position));
+        os.write(reinterpret_cast<const char*>(&orderId), sizeof(orderId));
         
-        os.write(timestamp, DATE_STR_LEN);
+        os.write(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
     }
 
-    static Transaction readFromStream(std::istream& is) 
+    // Keeps the recorded time. Format 1 stored it as local time text (records
+    // in one hour share the conversion), format 2 as epoch micros; both wrote
+    // the description out in full. Format 3 refers to `dictionary`.
+    static Transaction readFromStream(std::istream& is, int format, const StringDictionaryReader& dictionary) 
     {
         TransactionId id; UserId userId; ProductId productId; double amount; int typeInt;
-        size_t descLen; char timestamp[DATE_STR_LEN];
+        int64_t timestamp = 0;
 
         is.read(reinterpret_cast<char*>(&id), sizeof(id));
         is.read(reinterpret_cast<char*>(&userId), sizeof(userId));
         is.read(reinterpret_cast<char*>(&productId), sizeof(productId));
         is.read(reinterpret_cast<char*>(&amount), sizeof(amount));
         is.read(reinterpret_cast<char*>(&typeInt), sizeof(typeInt));
+        const TransactionType type = static_cast<TransactionType>(typeInt);
+
+        if (format >= 3) 
+        {
+            uint8_t kindValue = 0; uint32_t position = 0; OrderId orderId = 0;
+            is.read(reinterpret_cast<char*>(&kindValue), sizeof(kindValue));
+            is.read(reinterpret_cast<char*>(&position), sizeof(position));
+            is.read(reinterpret_cast<char*>(&orderId), sizeof(orderId));
+            is.read(reinterpret_cast<char*>(&timestamp), sizeof(timestamp));
+            if (kindValue > static_cast<uint8_t>(DescriptionKind::REFUND)) 
+            {
+                is.setstate(std::ios::failbit);
+                return Transaction();
+            }
+            return Transaction(id, userId, productId, amount, type, static_cast<DescriptionKind>(kindValue), dictionary.idAt(position), orderId, timestamp);
+        }
+
+        size_t descLen;
         is.read(reinterpret_cast<char*>(&descLen), sizeof(descLen));
-        
         if (descLen > 0 && descLen < 10000) 
         {
             std::string description(descLen, '\0');
             is.read(&description[0], descLen);
-            is.read(timestamp, DATE_STR_LEN);
-            return Transaction(id, userId, productId, amount, static_cast<TransactionType>(typeInt), description);
+            if (format == 1) 
+            {
+                char text[DATE_STR_LEN];
+                is.read(text, DATE_STR_LEN);
+                text[DATE_STR_LEN - 1] = '\0';
+                timestamp = legacyTimestamp(text);
+            }
+            else 
+            {
+                is.read(reinterpret_cast<char*>(&timestamp), sizeof(timestamp));
+            }
+            return fromDescription(id, userId, productId, amount, type, description, timestamp);
         }
         
         return Transaction(); // Return default on error
     }
 
-    void display() const 
+    // Recognises the descriptions the store itself used to write out in full
+    static Transaction fromDescription(TransactionId id, UserId userId, ProductId productId, double amount, TransactionType type, const std::string& description, int64_t timestamp) 
+    {
+        static const std::string purchasePrefix = "Purchase: ";
+        static const std::string refundPrefix = "Refund for Order #";
+        if (type == TransactionType::SALE && description.compare(0, purchasePrefix.size(), purchasePrefix) == 0) 
+        {
+            return Transaction(id, userId, productId, amount, type, DescriptionKind::PURCHASE, intern(description.substr(purchasePrefix.size())), 0, timestamp);
+        }
+        if (type == TransactionType::REFUND && description.compare(0, refundPrefix.size(), refundPrefix) == 0) 
+        {
+            const std::string number = description.substr(refundPrefix.size());
+            OrderId orderId = static_cast<OrderId>(std::atol(number.c_str()));
+            if (std::to_string(orderId) == number) 
+            {
+                return Transaction(id, userId, productId, amount, type, DescriptionKind::REFUND, 0, orderId, timestamp);
+            }
+        }
+        return Transaction(id, userId, productId, amount, type, description, timestamp);
+    }
+
+    static int64_t legacyTimestamp(const char* text) 
+    {
+        thread_local char lastHour[14] = {};
+        thread_local int64_t lastHourMicros = 0;
+        int minute = 0, second = 0;
+        if (std::strlen(text) != DATE_STR_LEN - 1 || std::sscanf(text + 14, "%d:%d", &minute, &second) != 2) return 0;
+        if (std::memcmp(lastHour, text, 13) != 0) 
+        {
+            char hour[DATE_STR_LEN];
+            std::snprintf(hour, sizeof(hour), "%.13s:00:00", text);
+            if (!parseLocalTimestamp(hour, lastHourMicros)) return 0;
+            std::memcpy(lastHour, text, 13);
+        }
+        return lastHourMicros + (static_cast<int64_t>(minute) * 60 + second) * 1000000;
+    }
+
+    static const char* typeName(TransactionType type) 
     {
-        std::string typeStr;
         switch (type) 
         {
-            case TransactionType::SALE: typeStr = "SALE"; break;
-            case TransactionType::REFUND: typeStr = "REFUND"; break;
-            case TransactionType::EXPENSE: typeStr = "EXPENSE"; break;
-            case TransactionType::DEPOSIT: typeStr = "DEPOSIT"; break;
+            case TransactionType::SALE: return "SALE";
+            case TransactionType::REFUND: return "REFUND";
+            case TransactionType::EXPENSE: return "EXPENSE";
+            case TransactionType::DEPOSIT: return "DEPOSIT";
         }
-        
-        std::cout << "[" << timestamp << "] " << typeStr << " | User: " << userId << " | Amount: $" << amount << " | " << description << "\n";
+        return "UNKNOWN";
+    }
+
+    void display() const 
+    {
+        std::cout << "[" << getTimestamp() << "] " << typeName(type) << " | User: " << userId << " | Amount: $" << amount << " | " << getDescription() << "\n";
     }
 };
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <iterator>
+#include "Transaction.h"
+#include "config.h"
+
+// Append-only transaction history, sharded by user so that concurrent
+// checkouts by different customers append to different shards and a
+// user's trackers only have to scan that user's shard.
+class TransactionLog
+{
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::vector<Transaction> items;
+    };
+
+    std::array<Shard, SHARD_COUNT> shards;
+
+    Shard& shardFor(UserId userId)
+    {
+        return shards[static_cast<size_t>(userId) % SHARD_COUNT];
+    }
+
+    const Shard& shardFor(UserId userId) const
+    {
+        return shards[static_cast<size_t>(userId) % SHARD_COUNT];
+    }
+
+public:
+    void load(const std::vector<Transaction>& transactions)
+    {
+        for (Shard& shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.items.clear();
+        }
+        for (const auto& t : transactions)
+        {
+            append(t);
+        }
+    }
+
+    void append(const Transaction& transaction)
+    {
+        Shard& shard = shardFor(transaction.getUserId());
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.items.push_back(transaction);
+    }
+
+    // Groups the batch by shard so each shard is locked once
+    void appendBatch(std::vector<Transaction>&& batch)
+    {
+        std::array<std::vector<Transaction>, SHARD_COUNT> buckets;
+        for (auto& t : batch)
+        {
+            buckets[static_cast<size_t>(t.getUserId()) % SHARD_COUNT].push_back(std::move(t));
+        }
+        for (size_t i = 0; i < SHARD_COUNT; ++i)
+        {
+            if (buckets[i].empty()) continue;
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            shards[i].items.insert(shards[i].items.end(), std::make_move_iterator(buckets[i].begin()), std::make_move_iterator(buckets[i].end()));
+        }
+    }
+
+    std::vector<Transaction> forUser(UserId userId) const
+    {
+        std::vector<Transaction> result;
+        const Shard& shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& t : shard.items)
+        {
+            if (t.getUserId() == userId) result.push_back(t);
+        }
+        return result;
+    }
+
+    // Copy of the whole history, ordered by transaction id
+    std::vector<Transaction> snapshot() const
+    {
+        std::vector<Transaction> result;
+        for (const Shard& shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            result.insert(result.end(), shard.items.begin(), shard.items.end());
+        }
+        std::sort(result.begin(), result.end(), [](const Transaction& a, const Transaction& b) { return a.getId() < b.getId(); });
+        return result;
+    }
+
+    // Hands the history to `f` shard by shard, in copies of at most
+    // `batchSize` transactions, so a full pass never holds more than one batch
+    template <typename F>
+    void forEachBatch(size_t batchSize, F&& f) const
+    {
+        std::vector<Transaction> batch;
+        for (const Shard& shard : shards)
+        {
+            for (size_t start = 0; ; start += batchSize)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    if (start >= shard.items.size()) break;
+                    size_t end = std::min(shard.items.size(), start + batchSize);
+                    batch.assign(shard.items.begin() + start, shard.items.begin() + end);
+                }
+                f(batch);
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (const Shard& shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.items.size();
+        }
+        return total;
+    }
+};
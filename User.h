@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
-#include <vector>
+#include <string_view>
+#include <memory_resource>
 #include <iostream>
 #include "config.h"
 
@@ -8,31 +9,40 @@ class User
 {
 private:
     UserId id;
-    std::string username;
-    std::string passwordHash;
+    std::pmr::string username;
+    std::pmr::string passwordHash;
     UserType type;
-    std::vector<OrderId> orderHistory;
 
 public:
     User() : id(0), username("guest"), type(UserType::CUSTOMER) {}
+
+    // Keeps the strings in `arena`, see Arena. Copies go back to the heap.
+    explicit User(std::pmr::memory_resource* arena) : id(0), username("guest", arena), passwordHash(arena), type(UserType::CUSTOMER) {}
     
-    User(UserId id, const std::string& username, const std::string& password, UserType type) : id(id), username(username), type(type) 
+    User(UserId id, std::string_view username, std::string_view password, UserType type) : id(id), username(username), passwordHash(hashPassword(password)), type(type) {}
+
+    // Compares character by character, so nothing is allocated
+    bool authenticate(std::string_view password) const 
     {
-        passwordHash = hashPassword(password);
+        if (password.size() != passwordHash.size()) return false;
+        for (size_t i = 0; i < password.size(); ++i) 
+        {
+            if (hashChar(password[i]) != passwordHash[i]) return false;
+        }
+        return true;
     }
 
-    bool authenticate(const std::string& password) const 
+    static char hashChar(char c) 
     {
-        return passwordHash == hashPassword(password);
+        return static_cast<char>(c ^ 'K');
     }
 
-    static std::string hashPassword(const std::string& plain) 
+    static std::string hashPassword(std::string_view plain) 
     {
-        std::string hashed = plain;
-        char key = 'K';
+        std::string hashed(plain);
         for (char& c : hashed) 
         {
-            c ^= key;
+            c = hashChar(c);
         }
         return hashed;
     }
@@ -41,7 +51,7 @@ public:
     { 
         return id; 
     }
-    std::string getUsername() const 
+    std::string_view getUsername() const 
     { 
         return username; 
     }
@@ -49,10 +59,6 @@ public:
     { 
         return type; 
     }
-    const std::vector<OrderId>& getOrderHistory() const 
-    { 
-        return orderHistory; 
-    }
 
     bool isCustomer() const 
     { 
@@ -67,11 +73,6 @@ public:
         return type == UserType::ADMIN; 
     }
 
-    void addOrder(OrderId orderId) 
-    {
-        orderHistory.push_back(orderId);
-    }
-
     void writeToStream(std::ostream& os) const 
     {
         os.write(reinterpret_cast<const char*>(&id), sizeof(id));
@@ -86,16 +87,11 @@ public:
         
         int typeInt = static_cast<int>(type);
         os.write(reinterpret_cast<const char*>(&typeInt), sizeof(typeInt));
-        
-        size_t orderCount = orderHistory.size();
-        os.write(reinterpret_cast<const char*>(&orderCount), sizeof(orderCount));
-        for (OrderId oid : orderHistory) 
-        {
-            os.write(reinterpret_cast<const char*>(&oid), sizeof(oid));
-        }
     }
 
-    void readFromStream(std::istream& is) 
+    // Format 1 records end with the user's order ids, which are skipped: the
+    // orders themselves say whose they are
+    void readFromStream(std::istream& is, int format) 
     {
         is.read(reinterpret_cast<char*>(&id), sizeof(id));
         
@@ -118,14 +114,13 @@ public:
         is.read(reinterpret_cast<char*>(&typeInt), sizeof(typeInt));
         type = static_cast<UserType>(typeInt);
         
-        size_t orderCount;
-        is.read(reinterpret_cast<char*>(&orderCount), sizeof(orderCount));
-        if (orderCount < 10000) 
+        if (format == 1)
         {
-            orderHistory.resize(orderCount);
-            for (size_t i = 0; i < orderCount; ++i) 
+            size_t orderCount;
+            is.read(reinterpret_cast<char*>(&orderCount), sizeof(orderCount));
+            if (orderCount < 10000) 
             {
-                is.read(reinterpret_cast<char*>(&orderHistory[i]), sizeof(OrderId));
+                is.ignore(static_cast<std::streamsize>(orderCount * sizeof(OrderId)));
             }
         }
     }
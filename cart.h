@@ -4,6 +4,9 @@
 #include <iostream>
 #include <algorithm>
 #include "Product.h"
+#include "ProductCatalog.h"
+#include "Tracing.h"
+#include "Logger.h"
 #include "config.h"
 
 class Cart 
@@ -15,19 +18,21 @@ private:
 public:
     explicit Cart(UserId userId = -1) : userId(userId) {}
 
-    bool addItem(ProductId productId, int quantity, const std::vector<Product>& products) 
+    // `heldForCart` is how many units of the product are already held for this
+    // cart (see CartHolds); they are out of stock but still ours to buy.
+    bool addItem(ProductId productId, int quantity, const ProductCatalog& products, int heldForCart = 0) 
     {
-        auto productIt = std::find_if(products.begin(), products.end(), [productId](const Product& p) { return p.getId() == productId; });
-        
-        if (productIt == products.end()) 
+        int stock = 0;
+        if (!products.read(productId, [&stock](const ProductRef& p) { stock = p.getStock(); })) 
         {
             std::cout << "Product not found!\n";
             return false;
         }
+        stock += heldForCart;
 
-        if (quantity <= 0 || quantity > productIt->getStock()) 
+        if (quantity <= 0 || quantity > stock) 
         {
-            std::cout << "Invalid quantity! Available stock: " << productIt->getStock() << "\n";
+            std::cout << "Invalid quantity! Available stock: " << stock << "\n";
             return false;
         }
 
@@ -35,15 +40,20 @@ public:
 
         if (itemIt != items.end()) 
         {
-            if (itemIt->quantity + quantity > productIt->getStock()) 
+            if (itemIt->quantity + quantity > stock) 
             {
-                std::cout << "Cannot add " << quantity << " more. Available stock: " << productIt->getStock() - itemIt->quantity << "\n";
+                std::cout << "Cannot add " << quantity << " more. Available stock: " << stock - itemIt->quantity << "\n";
                 return false;
             }
             itemIt->quantity += quantity;
         } 
         else 
         {
+            if (items.size() >= static_cast<size_t>(MAX_CART_ITEMS)) 
+            {
+                std::cout << "Your cart already holds " << MAX_CART_ITEMS << " different products, the most an order can have.\n";
+                return false;
+            }
             items.push_back({productId, quantity});
         }
 
@@ -66,7 +76,7 @@ public:
     void clear() 
     { 
         items.clear(); 
-        std::cout << "Cart cleared successfully.\n";
+        LOG_DEBUG("cart", "cart of user %d cleared", userId);
     }
     
     int getItemCount() const 
@@ -82,37 +92,18 @@ public:
         return items.empty(); 
     }
 
-    double calculateTotal(const std::vector<Product>& products) const 
+    double calculateTotal(const ProductCatalog& products) const 
     {
+        TRACE_SPAN("Cart::calculateTotal");
         double total = 0.0;
         for (const auto& item : items) 
         {
-            auto productIt = std::find_if(products.begin(), products.end(), [item](const Product& p) { return p.getId() == item.productId; });
-            
-            if (productIt != products.end()) 
-            {
-                total += productIt->getPrice() * item.quantity;
-            }
+            products.read(item.productId, [&total, &item](const ProductRef& p) { total += p.getPrice() * item.quantity; });
         }
         return total;
     }
 
-    bool validateStock(const std::vector<Product>& products) const 
-    {
-        for (const auto& item : items) 
-        {
-            // Use explicit iterator type instead of auto
-            std::vector<Product>::const_iterator productIt = std::find_if(products.begin(), products.end(), [item](const Product& p) { return p.getId() == item.productId; });
-            if (productIt == products.end() || item.quantity > productIt->getStock()) 
-            {
-                std::cout << "Stock validation failed for product ID: " << item.productId << "\n";
-                return false;
-            }
-        }
-        return true;
-    }
-
-    void display(const std::vector<Product>& products) const 
+    void display(const ProductCatalog& products) const 
     {
         if (items.empty()) 
         {
@@ -126,13 +117,13 @@ public:
         
         for (const auto& item : items) 
         {
-            std::vector<Product>::const_iterator productIt = std::find_if(products.begin(), products.end(), [item](const Product& p) { return p.getId() == item.productId; });
-            if (productIt != products.end()) 
+            std::string name;
+            double price = 0.0;
+            if (products.read(item.productId, [&name, &price](const ProductRef& p) { name = p.getName(); price = p.getPrice(); })) 
             {
-                double subtotal = productIt->getPrice() * item.quantity;
-                std::string name = productIt->getName();
+                double subtotal = price * item.quantity;
                 if (name.length() > 20) name = name.substr(0, 17) + "...";
-                printf("%-10d | %-20s | $%-7.2f | %-8d | $%-7.2f\n", item.productId, name.c_str(), productIt->getPrice(), item.quantity, subtotal);
+                printf("%-10d | %-20s | $%-7.2f | %-8d | $%-7.2f\n", item.productId, name.c_str(), price, item.quantity, subtotal);
             }
         }
         
@@ -141,12 +132,13 @@ public:
     }
 
     void saveToFile() const {
+        TRACE_SPAN("Cart::saveToFile");
         if (userId == -1) return;
         
         std::string filename = std::string(CART_FILE_PREFIX) + std::to_string(userId) + ".dat";
         std::ofstream ofs(filename, std::ios::binary);
         if (!ofs) {
-            std::cerr << "Warning: Could not save cart to " << filename << "\n";
+            LOG_WARN("cart", "could not save cart to %s", filename.c_str());
             return;
         }
 
@@ -157,10 +149,11 @@ public:
             ofs.write(reinterpret_cast<const char*>(&item.quantity), sizeof(item.quantity));
         }
         
-        std::cout << "Cart saved successfully.\n";
+        LOG_DEBUG("cart", "saved %zu items to %s", items.size(), filename.c_str());
     }
 
     void loadFromFile() {
+        TRACE_SPAN("Cart::loadFromFile");
         if (userId == -1) return;
         
         std::string filename = std::string(CART_FILE_PREFIX) + std::to_string(userId) + ".dat";
@@ -172,21 +165,25 @@ public:
         size_t count;
         ifs.read(reinterpret_cast<char*>(&count), sizeof(count));
         if (ifs.fail()) {
-            std::cerr << "Warning: Cart file corrupted: " << filename << "\n";
+            LOG_WARN("cart", "cart file corrupted: %s", filename.c_str());
             return;
         }
+        if (count > static_cast<size_t>(MAX_CART_ITEMS)) {
+            LOG_WARN("cart", "%s has %zu items, keeping the first %d", filename.c_str(), count, MAX_CART_ITEMS);
+            count = MAX_CART_ITEMS;
+        }
         
         items.resize(count);
         for (size_t i = 0; i < count; ++i) {
             ifs.read(reinterpret_cast<char*>(&items[i].productId), sizeof(items[i].productId));
             ifs.read(reinterpret_cast<char*>(&items[i].quantity), sizeof(items[i].quantity));
             if (ifs.fail()) {
-                std::cerr << "Warning: Cart file read error for item " << i << "\n";
+                LOG_WARN("cart", "read error at item %zu of %s, keeping the items before it", i, filename.c_str());
                 items.resize(i); // Keep partial data
                 break;
             }
         }
         
-        std::cout << "Cart loaded (" << items.size() << " items).\n";
+        LOG_DEBUG("cart", "loaded %zu items from %s", items.size(), filename.c_str());
     }
 };
\ No newline at end of file
@@ -1,21 +1,34 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <cctype>
+#include <cstddef>
+#include <ctime>
+#include <cstdio>
+#include <cstdint>
 
 using UserId = int;
 using ProductId = int;
 using OrderId = int;
 using TransactionId = int;
+using StringId = uint32_t; // see StringInterner
 
 constexpr const char* PRODUCT_FILE = "data/products.dat";
 constexpr const char* USER_FILE = "data/users.dat";
 constexpr const char* ORDER_FILE = "data/orders.dat";
 constexpr const char* TRANSACTION_FILE = "data/transactions.dat";
 constexpr const char* CART_FILE_PREFIX = "data/cart_";
+constexpr const char* ANALYTICS_FILE = "data/analytics.dat";
 
 constexpr int MAX_PRODUCTS = 1000;
 constexpr int MAX_USERS = 500;
 constexpr int MAX_CART_ITEMS = 50;
 constexpr int DATE_STR_LEN = 20;
+constexpr int BROWSE_PAGE_SIZE = 20;
+constexpr size_t COLUMNAR_ROW_GROUP_ROWS = 64 * 1024; // rows per row group of a columnar export
+constexpr size_t MAX_IMPORT_ERRORS = 1000; // per-row errors kept by a bulk import; the rest are only counted
+constexpr int CART_HOLD_SECONDS = 15 * 60; // how long a cart line keeps its stock; 0 disables holds
+constexpr int CLOCK_TICK_MS = 1; // resolution of the cached clock that stamps transactions
 
 enum class UserType { CUSTOMER, SELLER, ADMIN };
 enum class TransactionType { SALE, REFUND, EXPENSE, DEPOSIT };
@@ -24,4 +37,126 @@ struct CartItem
 {
     ProductId productId;
     int quantity;
-};
\ No newline at end of file
+};
+
+// Whether `text` contains `needle`, comparing letters without regard to case
+inline bool containsIgnoreCase(std::string_view text, std::string_view needle)
+{
+    auto lower = [](char c) { return std::tolower(static_cast<unsigned char>(c)); };
+    for (size_t start = 0; start + needle.size() <= text.size(); ++start)
+    {
+        size_t i = 0;
+        while (i < needle.size() && lower(text[start + i]) == lower(needle[i])) ++i;
+        if (i == needle.size()) return true;
+    }
+    return false;
+}
+
+// std::localtime shares one static buffer; use the reentrant variant instead
+inline std::tm localTime(std::time_t t)
+{
+    std::tm result{};
+#ifdef _WIN32
+    localtime_s(&result, &t);
+#else
+    localtime_r(&t, &result);
+#endif
+    return result;
+}
+
+// Seconds from 1970-01-01 00:00:00 to the given date and time (proleptic
+// Gregorian, no time zone)
+inline int64_t civilSeconds(int year, int month, int day, int hour, int minute, int second)
+{
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+    return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// Seconds since 1970-01-01 00:00:00 for a "YYYY-MM-DD HH:MM:SS" wall-clock
+// time, taken as is (no time zone); false if the text is not in that form
+inline bool wallClockSeconds(const char* text, int64_t& seconds)
+{
+    int year, month, day, hour, minute, second;
+    if (std::sscanf(text, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6) return false;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+    seconds = civilSeconds(year, month, day, hour, minute, second);
+    return true;
+}
+
+// The local hour holding an instant. Zone offsets only change on hour
+// boundaries, so every instant in [start, start + 3600) shares its date and
+// hour; each thread keeps the last one and only calls localtime on a new hour.
+struct LocalHour
+{
+    int64_t start = INT64_MIN; // epoch seconds
+    int64_t wallClockStart = 0; // the same instant as local wall-clock seconds
+    char prefix[24] = {}; // "YYYY-MM-DD HH:"
+};
+
+inline const LocalHour& localHour(int64_t epochSeconds)
+{
+    thread_local LocalHour hour;
+    if (epochSeconds < hour.start || epochSeconds >= hour.start + 3600)
+    {
+        std::tm local = localTime(static_cast<std::time_t>(epochSeconds));
+        hour.start = epochSeconds - local.tm_min * 60 - local.tm_sec;
+        hour.wallClockStart = civilSeconds(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour, 0, 0);
+        std::strftime(hour.prefix, sizeof(hour.prefix), "%Y-%m-%d %H:", &local);
+    }
+    return hour;
+}
+
+// Local "YYYY-MM-DD HH:MM:SS" for microseconds since the Unix epoch, written
+// over `text` so a caller formatting many can reuse one buffer
+inline void formatTimestamp(int64_t epochMicros, std::string& text)
+{
+    int64_t seconds = epochMicros >= 0 ? epochMicros / 1000000 : (epochMicros - 999999) / 1000000;
+    const LocalHour& hour = localHour(seconds);
+    int64_t inHour = seconds - hour.start;
+    text.assign(hour.prefix);
+    text += static_cast<char>('0' + inHour / 600);
+    text += static_cast<char>('0' + inHour / 60 % 10);
+    text += ':';
+    text += static_cast<char>('0' + inHour % 60 / 10);
+    text += static_cast<char>('0' + inHour % 10);
+}
+
+inline std::string formatTimestamp(int64_t epochMicros)
+{
+    std::string text;
+    formatTimestamp(epochMicros, text);
+    return text;
+}
+
+// Local wall-clock seconds (see wallClockSeconds) of an epoch instant
+inline int64_t wallClockSeconds(int64_t epochMicros)
+{
+    int64_t seconds = epochMicros >= 0 ? epochMicros / 1000000 : (epochMicros - 999999) / 1000000;
+    const LocalHour& hour = localHour(seconds);
+    return hour.wallClockStart + (seconds - hour.start);
+}
+
+// Epoch microseconds of a local "YYYY-MM-DD HH:MM:SS"; false if the text is not in that form
+inline bool parseLocalTimestamp(const char* text, int64_t& epochMicros)
+{
+    int year, month, day, hour, minute, second;
+    if (std::sscanf(text, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6) return false;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+    std::tm local{};
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_sec = second;
+    local.tm_isdst = -1;
+    std::time_t seconds = std::mktime(&local);
+    if (seconds == static_cast<std::time_t>(-1)) return false;
+    epochMicros = static_cast<int64_t>(seconds) * 1000000;
+    return true;
+}